@@ -474,6 +474,7 @@ class OKULAR_EXPORT AnnotationObjectRect : public ObjectRect
 class OKULAR_EXPORT SourceRefObjectRect : public ObjectRect
 {
     friend class ObjectRect;
+    friend class ObjectRectIndex;
 
     public:
         /**
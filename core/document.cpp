@@ -25,9 +25,11 @@
 // qt/kde/system includes
 #include <QtCore/QtAlgorithms>
 #include <QtCore/QDir>
+#include <QtCore/QElapsedTimer>
 #include <QtCore/QFile>
 #include <QtCore/QFileInfo>
 #include <QtCore/QMap>
+#include <QtCore/QRunnable>
 #include <QtCore/QTextStream>
 #include <QtCore/QTimer>
 #include <QtGui/QApplication>
@@ -48,6 +50,7 @@
 #include <kmimetypetrader.h>
 #include <kprocess.h>
 #include <krun.h>
+#include <ksavefile.h>
 #include <kshell.h>
 #include <kstandarddirs.h>
 #include <ktemporaryfile.h>
@@ -63,6 +66,7 @@
 #include "bookmarkmanager.h"
 #include "chooseenginedialog_p.h"
 #include "debug_p.h"
+#include "documentinfojournal_p.h"
 #include "generator_p.h"
 #include "interfaces/configinterface.h"
 #include "interfaces/guiinterface.h"
@@ -73,11 +77,14 @@
 #include "page.h"
 #include "page_p.h"
 #include "pagecontroller_p.h"
+#include "pixmapdiskcache_p.h"
 #include "scripter.h"
 #include "settings_core.h"
 #include "sourcereference.h"
 #include "sourcereference_p.h"
 #include "texteditors_p.h"
+#include "textextractionjob_p.h"
+#include "textsearchindex_p.h"
 #include "tile.h"
 #include "tilesmanager_p.h"
 #include "utils_p.h"
@@ -92,16 +99,6 @@
 
 using namespace Okular;
 
-struct AllocatedPixmap
-{
-    // owner of the page
-    DocumentObserver *observer;
-    int page;
-    qulonglong memory;
-    // public constructor: initialize data
-    AllocatedPixmap( DocumentObserver *o, int p, qulonglong m ) : observer( o ), page( p ), memory( m ) {}
-};
-
 struct ArchiveData
 {
     ArchiveData()
@@ -127,6 +124,10 @@ struct RunningSearch
     bool cachedNoDialogs : 1;
     bool isCurrentlySearching : 1;
     QColor cachedColor;
+
+    // the only pages that may match, when the search index could tell
+    bool useCandidatePages : 1;
+    QVector< int > candidatePages;
 };
 
 #define foreachObserver( cmd ) {\
@@ -295,25 +296,29 @@ qulonglong DocumentPrivate::calculateMemoryToFree()
     qulonglong clipValue = 0;
     qulonglong memoryToFree = 0;
 
+    // the profiles apply to the pixmaps of all the open documents together
+    PixmapMemoryBudget *budget = PixmapMemoryBudget::self();
+    const qulonglong allocatedMemory = budget ? budget->totalMemory() : m_allocatedPixmapsTotalMemory;
+
     switch ( SettingsCore::memoryLevel() )
     {
         case SettingsCore::EnumMemoryLevel::Low:
-            memoryToFree = m_allocatedPixmapsTotalMemory;
+            memoryToFree = allocatedMemory;
             break;
 
         case SettingsCore::EnumMemoryLevel::Normal:
         {
             qulonglong thirdTotalMemory = getTotalMemory() / 3;
             qulonglong freeMemory = getFreeMemory();
-            if (m_allocatedPixmapsTotalMemory > thirdTotalMemory) memoryToFree = m_allocatedPixmapsTotalMemory - thirdTotalMemory;
-            if (m_allocatedPixmapsTotalMemory > freeMemory) clipValue = (m_allocatedPixmapsTotalMemory - freeMemory) / 2;
+            if (allocatedMemory > thirdTotalMemory) memoryToFree = allocatedMemory - thirdTotalMemory;
+            if (allocatedMemory > freeMemory) clipValue = (allocatedMemory - freeMemory) / 2;
         }
         break;
 
         case SettingsCore::EnumMemoryLevel::Aggressive:
         {
             qulonglong freeMemory = getFreeMemory();
-            if (m_allocatedPixmapsTotalMemory > freeMemory) clipValue = (m_allocatedPixmapsTotalMemory - freeMemory) / 2;
+            if (allocatedMemory > freeMemory) clipValue = (allocatedMemory - freeMemory) / 2;
         }
         break;
         case SettingsCore::EnumMemoryLevel::Greedy:
@@ -321,7 +326,7 @@ qulonglong DocumentPrivate::calculateMemoryToFree()
             qulonglong freeSwap;
             qulonglong freeMemory = getFreeMemory( &freeSwap );
             const qulonglong memoryLimit = qMin( qMax( freeMemory, getTotalMemory()/2 ), freeMemory+freeSwap );
-            if (m_allocatedPixmapsTotalMemory > memoryLimit) clipValue = (m_allocatedPixmapsTotalMemory - memoryLimit) / 2;
+            if (allocatedMemory > memoryLimit) clipValue = (allocatedMemory - memoryLimit) / 2;
         }
         break;
     }
@@ -339,7 +344,19 @@ void DocumentPrivate::cleanupPixmapMemory()
 
 void DocumentPrivate::cleanupPixmapMemory( qulonglong memoryToFree )
 {
-    if ( memoryToFree > 0 )
+    // [MEM] the documents that were not used lately give their pixmaps first
+    PixmapMemoryBudget *budget = PixmapMemoryBudget::self();
+    if ( budget )
+        memoryToFree = budget->reclaim( this, memoryToFree );
+
+    evictPixmaps( memoryToFree );
+}
+
+qulonglong DocumentPrivate::evictPixmaps( qulonglong memoryToFree )
+{
+    const qulonglong allocatedMemory = m_allocatedPixmapsTotalMemory;
+
+    if ( memoryToFree > 0 && !m_allocatedPixmaps.isEmpty() )
     {
         const int currentViewportPage = (*m_viewportIterator).pageNumber;
 
@@ -409,49 +426,351 @@ void DocumentPrivate::cleanupPixmapMemory( qulonglong memoryToFree )
                 pixmapsToKeep.append( p );
         }
 
-        m_allocatedPixmaps += pixmapsToKeep;
+        foreach ( AllocatedPixmap * p, pixmapsToKeep )
+            m_allocatedPixmaps.insert( p );
         //p--rintf("freeMemory A:[%d -%d = %d] \n", m_allocatedPixmaps.count() + pagesFreed, pagesFreed, m_allocatedPixmaps.count() );
     }
+
+    return allocatedMemory - m_allocatedPixmapsTotalMemory;
 }
 
-/* Returns the next pixmap to evict from cache, or NULL if no suitable pixmap
- * if found. If unloadableOnly is set, only unloadable pixmaps are returned. If
- * thenRemoveIt is set, the pixmap is removed from m_allocatedPixmaps before
- * returning it
+void DocumentPrivate::pixmapMemoryChanged( DocumentObserver *observer, int page, qlonglong memoryDiff )
+{
+    // the pixmaps not accounted anymore (e.g. being evicted) are left alone
+    AllocatedPixmap *p = m_allocatedPixmaps.take( observer, page );
+    if ( !p )
+        return;
+
+    if ( memoryDiff < 0 && (qulonglong)-memoryDiff > p->memory )
+        memoryDiff = -(qlonglong)p->memory;
+    p->memory += memoryDiff;
+    m_allocatedPixmapsTotalMemory += memoryDiff;
+    m_allocatedPixmaps.insert( p );
+}
+
+// the rendered data of a page kept while the document is reloaded
+class Okular::ReloadedPage
+{
+    public:
+        ReloadedPage()
+            : text( 0 )
+        {
+        }
+
+        ~ReloadedPage()
+        {
+            qDeleteAll( pixmaps );
+            delete text;
+        }
+
+        double width;
+        double height;
+        Rotation rotation;
+        QMap< DocumentObserver *, QPixmap * > pixmaps;
+        TextPage *text;
+        NormalizedRect boundingBox;
+        bool boundingBoxKnown;
+};
+
+void DocumentPrivate::keepReloadedPages()
+{
+    clearReloadedPages();
+
+    // the pages the user changed do not look like in the file anymore
+    foreach ( Page *page, m_pagesVector )
+    {
+        const QByteArray fingerprint = m_generator->metaData( QLatin1String( "PageFingerprint" ), page->number() ).toByteArray();
+        if ( fingerprint.isEmpty() || m_modifiedPages.contains( page->number() ) || m_reloadedPages.contains( fingerprint ) )
+            continue;
+
+        ReloadedPage *kept = new ReloadedPage;
+        kept->width = page->width();
+        kept->height = page->height();
+        kept->rotation = page->rotation();
+        kept->boundingBox = page->boundingBox();
+        kept->boundingBoxKnown = page->isBoundingBoxKnown();
+
+        // the pixmaps still being rotated are left to the page
+        QMap< DocumentObserver*, PagePrivate::PixmapObject >::iterator it = page->d->m_pixmaps.begin();
+        while ( it != page->d->m_pixmaps.end() )
+        {
+            if ( it.value().m_rotation == page->rotation() )
+            {
+                kept->pixmaps.insert( it.key(), it.value().m_pixmap );
+                it = page->d->m_pixmaps.erase( it );
+            }
+            else
+                ++it;
+        }
+
+        kept->text = page->d->m_text;
+        page->d->m_text = 0;
+
+        m_reloadedPages.insert( fingerprint, kept );
+    }
+
+    m_reloadedPagesUrl = m_url;
+    m_reloadedPagesGenerator = m_generatorName;
+}
+
+void DocumentPrivate::restoreReloadedPages()
+{
+    if ( m_reloadedPages.isEmpty() || m_url != m_reloadedPagesUrl || m_generatorName != m_reloadedPagesGenerator )
+    {
+        clearReloadedPages();
+        return;
+    }
+
+    foreach ( Page *page, m_pagesVector )
+    {
+        const QByteArray fingerprint = m_generator->metaData( QLatin1String( "PageFingerprint" ), page->number() ).toByteArray();
+        ReloadedPage *kept = fingerprint.isEmpty() ? 0 : m_reloadedPages.take( fingerprint );
+        if ( !kept )
+            continue;
+
+        if ( kept->rotation == page->rotation() && kept->width == page->width() && kept->height == page->height() )
+        {
+            QMap< DocumentObserver *, QPixmap * >::iterator it = kept->pixmaps.begin(), itEnd = kept->pixmaps.end();
+            for ( ; it != itEnd; ++it )
+            {
+                if ( !m_observers.contains( it.key() ) || page->d->m_pixmaps.contains( it.key() ) )
+                    continue;
+
+                PagePrivate::PixmapObject object;
+                object.m_pixmap = it.value();
+                object.m_rotation = kept->rotation;
+                page->d->m_pixmaps.insert( it.key(), object );
+
+                // [MEM] account the pixmap as if it was just rendered
+                const qulonglong memoryBytes = 4 * (qulonglong)it.value()->width() * it.value()->height();
+                m_allocatedPixmaps.insert( new AllocatedPixmap( it.key(), page->number(), memoryBytes ) );
+                m_allocatedPixmapsTotalMemory += memoryBytes;
+                it.value() = 0;
+            }
+
+            if ( kept->text && !page->hasTextPage() )
+            {
+                page->setTextPage( kept->text );
+                kept->text = 0;
+                textGenerationDone( page );
+            }
+
+            if ( kept->boundingBoxKnown && !page->isBoundingBoxKnown() )
+                page->setBoundingBox( kept->boundingBox );
+        }
+        delete kept;
+    }
+
+    clearReloadedPages();
+}
+
+void DocumentPrivate::clearReloadedPages()
+{
+    qDeleteAll( m_reloadedPages );
+    m_reloadedPages.clear();
+    m_reloadedPagesUrl = KUrl();
+    m_reloadedPagesGenerator.clear();
+}
+
+/* Returns the next pixmap to evict from cache according to the eviction
+ * policy, or NULL if no suitable pixmap if found. If unloadableOnly is set,
+ * only unloadable pixmaps are returned. If thenRemoveIt is set, the pixmap is
+ * removed from m_allocatedPixmaps before returning it
  */
 AllocatedPixmap * DocumentPrivate::searchLowestPriorityPixmap( bool unloadableOnly, bool thenRemoveIt, DocumentObserver *observer )
 {
-    QLinkedList< AllocatedPixmap * >::iterator pIt = m_allocatedPixmaps.begin();
-    QLinkedList< AllocatedPixmap * >::iterator pEnd = m_allocatedPixmaps.end();
-    QLinkedList< AllocatedPixmap * >::iterator farthestPixmap = pEnd;
     const int currentViewportPage = (*m_viewportIterator).pageNumber;
 
-    /* Find the pixmap that is farthest from the current viewport */
-    int maxDistance = -1;
-    while ( pIt != pEnd )
+    if ( thenRemoveIt )
+        return m_allocatedPixmaps.takeVictim( currentViewportPage, unloadableOnly, observer );
+    return m_allocatedPixmaps.victim( currentViewportPage, unloadableOnly, observer );
+}
+
+void DocumentPrivate::updatePixmapEvictionPolicy()
+{
+    switch ( SettingsCore::pixmapEvictionPolicy() )
     {
-        const AllocatedPixmap * p = *pIt;
-        // Filter by observer
-        if ( observer == 0 || p->observer == observer )
+        case SettingsCore::EnumPixmapEvictionPolicy::Distance:
+            m_allocatedPixmaps.setPolicy( PixmapEvictionIndex::Distance );
+            break;
+        case SettingsCore::EnumPixmapEvictionPolicy::LeastRecentlyUsed:
+            m_allocatedPixmaps.setPolicy( PixmapEvictionIndex::LeastRecentlyUsed );
+            break;
+        case SettingsCore::EnumPixmapEvictionPolicy::Adaptive:
+            m_allocatedPixmaps.setPolicy( PixmapEvictionIndex::Adaptive );
+            break;
+    }
+}
+
+void DocumentPrivate::updateDiskCacheSettings()
+{
+    PixmapDiskCache *cache = PixmapDiskCache::self();
+    if ( !cache )
+        return;
+
+    cache->setEnabled( SettingsCore::diskCache() );
+    cache->setMaximumSize( (qulonglong)SettingsCore::diskCacheSize() * 1024 * 1024 );
+}
+
+QByteArray DocumentPrivate::diskCacheKey( PixmapRequest *request ) const
+{
+    if ( m_diskCacheFingerprint.isEmpty() || !m_generator->hasFeature( Generator::CachedRendering ) )
+        return QByteArray();
+
+    PixmapDiskCache *cache = PixmapDiskCache::self();
+    if ( !cache || !cache->isEnabled() )
+        return QByteArray();
+
+    // only whole pages that still look like in the document file
+    if ( request->isTile() || request->isPreview() || request->d->mForce || m_modifiedPages.contains( request->pageNumber() ) )
+        return QByteArray();
+
+    const Page *page = request->page();
+    if ( !page->formFields().isEmpty() )
+        return QByteArray();
+    foreach ( const Annotation *annotation, page->annotations() )
+    {
+        if ( !( annotation->flags() & Annotation::External ) )
+            return QByteArray();
+    }
+
+    const QString renderSettings = m_generatorName
+        + QLatin1Char( ':' ) + documentMetaData( QLatin1String( "PaperColor" ), true ).value< QColor >().name()
+        + QLatin1Char( ':' ) + QString::number( documentMetaData( QLatin1String( "TextAntialias" ), QVariant() ).toBool() )
+        + QLatin1Char( ':' ) + QString::number( documentMetaData( QLatin1String( "GraphicsAntialias" ), QVariant() ).toBool() )
+        + QLatin1Char( ':' ) + QString::number( documentMetaData( QLatin1String( "TextHinting" ), QVariant() ).toBool() )
+        + QLatin1Char( ':' ) + m_generator->metaData( QLatin1String( "RenderSettings" ), QVariant() ).toString();
+
+    return PixmapDiskCache::key( m_diskCacheFingerprint, request->pageNumber(), request->width(), request->height(), renderSettings );
+}
+
+void DocumentPrivate::loadTextSearchIndex()
+{
+    if ( m_textSearchIndex || !SettingsCore::searchIndex() || m_pagesVector.isEmpty() )
+        return;
+
+    const QString fileName = textSearchIndexFileName();
+    if ( fileName.isEmpty() )
+        return;
+
+    TextSearchIndex *index = new TextSearchIndex;
+    if ( index->load( fileName, m_pagesVector.count(), QFileInfo( m_docFileName ).lastModified() ) )
+        m_textSearchIndex = index;
+    else
+        delete index;
+}
+
+void DocumentPrivate::startTextIndexing()
+{
+    if ( m_textSearchIndex || m_textIndexingThread || !SettingsCore::searchIndex() || m_pagesVector.isEmpty() )
+        return;
+
+    // the text pages are extracted in a thread, so only for the generators
+    // already doing that
+    if ( !m_generator->hasFeature( Generator::TextExtraction ) || !m_generator->hasFeature( Generator::Threaded ) )
+        return;
+
+    m_textIndexingThread = new TextIndexingThread( m_generator, m_pagesVector );
+    QObject::connect( m_textIndexingThread, SIGNAL(finished()), m_parent, SLOT(_o_textIndexingFinished()) );
+    m_textIndexingThread->start( QThread::LowestPriority );
+}
+
+QString DocumentPrivate::textSearchIndexFileName() const
+{
+    // next to the document data file
+    if ( !m_xmlFileName.endsWith( QLatin1String( ".xml" ) ) )
+        return QString();
+    return m_xmlFileName.left( m_xmlFileName.length() - 4 ) + QLatin1String( ".index" );
+}
+
+QVector< int > DocumentPrivate::searchCandidatePages( const QStringList &texts, bool matchAll ) const
+{
+    QVector< int > result;
+    bool first = true;
+    foreach ( const QString &text, texts )
+    {
+        const QVector< int > pages = m_textSearchIndex->candidatePages( text );
+        if ( first )
+        {
+            result = pages;
+            first = false;
+            continue;
+        }
+
+        // both lists are sorted
+        QVector< int > merged;
+        QVector< int >::const_iterator a = result.constBegin(), aEnd = result.constEnd();
+        QVector< int >::const_iterator b = pages.constBegin(), bEnd = pages.constEnd();
+        while ( a != aEnd || b != bEnd )
         {
-            const int distance = qAbs( p->page - currentViewportPage );
-            if ( maxDistance < distance && ( !unloadableOnly || p->observer->canUnloadPixmap( p->page ) ) )
+            if ( b == bEnd || ( a != aEnd && *a < *b ) )
             {
-                maxDistance = distance;
-                farthestPixmap = pIt;
+                if ( !matchAll )
+                    merged.append( *a );
+                ++a;
+            }
+            else if ( a == aEnd || *b < *a )
+            {
+                if ( !matchAll )
+                    merged.append( *b );
+                ++b;
+            }
+            else
+            {
+                merged.append( *a );
+                ++a;
+                ++b;
             }
         }
-        ++pIt;
+        result = merged;
     }
+    return result;
+}
 
-    /* No pixmap to remove */
-    if ( farthestPixmap == pEnd )
-        return 0;
+void DocumentPrivate::startSearchTextExtraction( const QVector< int > &pageNumbers )
+{
+    delete m_searchTextExtraction;
+    m_searchTextExtraction = 0;
 
-    AllocatedPixmap * selectedPixmap = *farthestPixmap;
-    if ( thenRemoveIt )
-        m_allocatedPixmaps.erase( farthestPixmap );
-    return selectedPixmap;
+    QVector< Page * > pages;
+    foreach ( int pageNumber, pageNumbers )
+    {
+        Page *page = m_pagesVector.at( pageNumber );
+        if ( !page->hasTextPage() )
+            pages.append( page );
+    }
+    if ( pages.count() < 2 )
+        return;
+
+    m_searchTextExtraction = new TextExtractionJob( m_generator, pages );
+    m_searchTextExtraction->start();
+}
+
+void DocumentPrivate::requestSearchTextPage( Page *page )
+{
+    TextPage *textPage = m_searchTextExtraction ? m_searchTextExtraction->takeTextPage( page ) : 0;
+    if ( !textPage )
+    {
+        m_parent->requestTextPage( page->number() );
+        return;
+    }
+
+    page->setTextPage( textPage );
+    textGenerationDone( page );
+}
+
+void DocumentPrivate::_o_textIndexingFinished()
+{
+    if ( !m_textIndexingThread || !m_textIndexingThread->isFinished() )
+        return;
+
+    m_textSearchIndex = m_textIndexingThread->takeIndex();
+    m_textIndexingThread->deleteLater();
+    m_textIndexingThread = 0;
+
+    const QString fileName = textSearchIndexFileName();
+    if ( m_textSearchIndex && !fileName.isEmpty() )
+        m_textSearchIndex->save( fileName, QFileInfo( m_docFileName ).lastModified() );
 }
 
 qulonglong DocumentPrivate::getTotalMemory()
@@ -609,19 +928,38 @@ void DocumentPrivate::loadDocumentInfo()
 
 void DocumentPrivate::loadDocumentInfo( const QString &fileName )
 {
-    QFile infoFile( fileName );
-    if ( !infoFile.exists() || !infoFile.open( QIODevice::ReadOnly ) )
-        return;
-
     // Load DOM from XML file
     QDomDocument doc( "documentInfo" );
-    if ( !doc.setContent( &infoFile ) )
+    bool loaded = false;
+    QFile infoFile( fileName );
+    if ( infoFile.exists() && infoFile.open( QIODevice::ReadOnly ) )
     {
-        kDebug(OkularDebug) << "Can't load XML pair! Check for broken xml.";
+        if ( doc.setContent( &infoFile ) )
+        {
+            loaded = true;
+        }
+        else
+        {
+            // the journal may still hold the latest changes
+            kDebug(OkularDebug) << "Can't load XML pair! Check for broken xml.";
+            doc = QDomDocument( "documentInfo" );
+        }
         infoFile.close();
-        return;
     }
-    infoFile.close();
+
+    // apply the changes journaled since the file was written, the journal
+    // left by a compaction that did not complete first
+    if ( fileName == m_xmlFileName )
+    {
+        const QString journal = journalFileName();
+        if ( !journal.isEmpty() )
+        {
+            loaded = DocumentInfoJournal::replay( journal + QLatin1String( ".old" ), doc ) || loaded;
+            loaded = DocumentInfoJournal::replay( journal, doc ) || loaded;
+        }
+    }
+    if ( !loaded )
+        return;
 
     QDomElement root = doc.documentElement();
     if ( root.tagName() != "documentInfo" )
@@ -651,6 +989,9 @@ void DocumentPrivate::loadDocumentInfo( const QString &fileName )
                     // pass the domElement to the right page, to read config data from
                     if ( ok && pageNumber >= 0 && pageNumber < (int)m_pagesVector.count() )
                         m_pagesVector[ pageNumber ]->d->restoreLocalContents( pageElement );
+                    // or keep it until the page is loaded
+                    else if ( ok && pageNumber >= 0 && m_generator && m_generator->hasFeature( Generator::IncrementalLoading ) )
+                        m_pendingPageInfo.insert( pageNumber, pageElement );
                 }
                 pageNode = pageNode.nextSibling();
             }
@@ -1000,6 +1341,9 @@ bool DocumentPrivate::savePageDocumentInfo( KTemporaryFile *infoFile, int what )
         QVector< Page * >::const_iterator pIt = m_pagesVector.constBegin(), pEnd = m_pagesVector.constEnd();
         for ( ; pIt != pEnd; ++pIt )
             (*pIt)->d->saveLocalContents( pageList, doc, PageItems( what ) );
+        // the pages not loaded yet keep what they were loaded with
+        foreach ( const QDomElement &pageInfo, m_pendingPageInfo )
+            pageList.appendChild( doc.importNode( pageInfo, true ) );
 
         // 3. Save DOM to XML file
         QString xml = doc.toString();
@@ -1195,101 +1539,303 @@ void DocumentPrivate::performSetAnnotationContents( const QString & newContents,
     performModifyPageAnnotation( pageNumber,  annot, appearanceChanged );
 }
 
-void DocumentPrivate::saveDocumentInfo() const
+// the journal is compacted into the document info file once it is bigger
+// than both this and the file
+static const qint64 MinimumJournalSizeToCompact = 64 * 1024;
+
+static bool writeDocumentInfo( const QString &fileName, const QDomDocument &doc )
 {
-    if ( m_xmlFileName.isEmpty() )
-        return;
+    KSaveFile infoFile( fileName );
+    if ( !infoFile.open( QIODevice::WriteOnly ) )
+        return false;
 
-    QFile infoFile( m_xmlFileName );
-    if (infoFile.open( QIODevice::WriteOnly | QIODevice::Truncate) )
+    QTextStream os( &infoFile );
+    os.setCodec( "UTF-8" );
+    os << doc.toString();
+    os.flush();
+    return infoFile.finalize();
+}
+
+static PageItems documentInfoPageItems( bool annotationsNeedSaveAs )
+{
+    PageItems saveWhat = AllPageItems;
+    if ( annotationsNeedSaveAs )
     {
-        // 1. Create DOM
-        QDomDocument doc( "documentInfo" );
-        QDomProcessingInstruction xmlPi = doc.createProcessingInstruction(
-                QString::fromLatin1( "xml" ), QString::fromLatin1( "version=\"1.0\" encoding=\"utf-8\"" ) );
-        doc.appendChild( xmlPi );
-        QDomElement root = doc.createElement( "documentInfo" );
-        root.setAttribute( "url", m_url.pathOrUrl() );
-        doc.appendChild( root );
+        /* In this case, if the user makes a modification, he's requested to
+         * save to a new document. Therefore, if there are existing local
+         * annotations, we save them back unmodified in the original
+         * document's metadata, so that it appears that it was not changed */
+        saveWhat |= OriginalAnnotationPageItems;
+    }
+    return saveWhat;
+}
 
-        // 2.1. Save page attributes (bookmark state, annotations, ... ) to DOM
-        QDomElement pageList = doc.createElement( "pageList" );
-        root.appendChild( pageList );
-        PageItems saveWhat = AllPageItems;
-        if ( m_annotationsNeedSaveAs )
+namespace Okular {
+
+class DocumentInfoWriter : public QRunnable
+{
+    public:
+        DocumentInfoWriter( const QString &fileName, const QDomDocument &doc, const QString &oldJournalFileName )
+            : m_fileName( fileName ), m_doc( doc ), m_oldJournalFileName( oldJournalFileName )
         {
-            /* In this case, if the user makes a modification, he's requested to
-             * save to a new document. Therefore, if there are existing local
-             * annotations, we save them back unmodified in the original
-             * document's metadata, so that it appears that it was not changed */
-            saveWhat |= OriginalAnnotationPageItems;
         }
-        // <page list><page number='x'>.... </page> save pages that hold data
-        QVector< Page * >::const_iterator pIt = m_pagesVector.constBegin(), pEnd = m_pagesVector.constEnd();
-        for ( ; pIt != pEnd; ++pIt )
-            (*pIt)->d->saveLocalContents( pageList, doc, saveWhat );
 
-        // 2.2. Save document info (current viewport, history, ... ) to DOM
-        QDomElement generalInfo = doc.createElement( "generalInfo" );
-        root.appendChild( generalInfo );
-        // create rotation node
-        if ( m_rotation != Rotation0 )
+        void run()
         {
-            QDomElement rotationNode = doc.createElement( "rotation" );
-            generalInfo.appendChild( rotationNode );
-            rotationNode.appendChild( doc.createTextNode( QString::number( (int)m_rotation ) ) );
+            // the old journal is only needed until its changes are in the file
+            if ( writeDocumentInfo( m_fileName, m_doc ) )
+                QFile::remove( m_oldJournalFileName );
         }
-        // <general info><history> ... </history> save history up to OKULAR_HISTORY_SAVEDSTEPS viewports
-        QLinkedList< DocumentViewport >::const_iterator backIterator = m_viewportIterator;
-        if ( backIterator != m_viewportHistory.constEnd() )
+
+    private:
+        QString m_fileName;
+        QDomDocument m_doc;
+        QString m_oldJournalFileName;
+};
+
+}
+
+QDomDocument DocumentPrivate::documentInfo() const
+{
+    // 1. Create DOM
+    QDomDocument doc( "documentInfo" );
+    QDomProcessingInstruction xmlPi = doc.createProcessingInstruction(
+            QString::fromLatin1( "xml" ), QString::fromLatin1( "version=\"1.0\" encoding=\"utf-8\"" ) );
+    doc.appendChild( xmlPi );
+    QDomElement root = doc.createElement( "documentInfo" );
+    root.setAttribute( "url", m_url.pathOrUrl() );
+    doc.appendChild( root );
+
+    // 2.1. Save page attributes (bookmark state, annotations, ... ) to DOM
+    QDomElement pageList = doc.createElement( "pageList" );
+    root.appendChild( pageList );
+    // <page list><page number='x'>.... </page> save pages that hold data
+    const PageItems saveWhat = documentInfoPageItems( m_annotationsNeedSaveAs );
+    QVector< Page * >::const_iterator pIt = m_pagesVector.constBegin(), pEnd = m_pagesVector.constEnd();
+    for ( ; pIt != pEnd; ++pIt )
+        (*pIt)->d->saveLocalContents( pageList, doc, saveWhat );
+    // the pages not loaded yet keep what they were loaded with
+    foreach ( const QDomElement &pageInfo, m_pendingPageInfo )
+        pageList.appendChild( doc.importNode( pageInfo, true ) );
+
+    // 2.2. Save document info (current viewport, history, ... ) to DOM
+    QDomElement generalInfo = doc.createElement( "generalInfo" );
+    root.appendChild( generalInfo );
+    saveGeneralInfo( generalInfo, doc );
+
+    return doc;
+}
+
+void DocumentPrivate::saveGeneralInfo( QDomElement &generalInfo, QDomDocument &doc ) const
+{
+    // create rotation node
+    if ( m_rotation != Rotation0 )
+    {
+        QDomElement rotationNode = doc.createElement( "rotation" );
+        generalInfo.appendChild( rotationNode );
+        rotationNode.appendChild( doc.createTextNode( QString::number( (int)m_rotation ) ) );
+    }
+    // <general info><history> ... </history> save history up to OKULAR_HISTORY_SAVEDSTEPS viewports
+    QLinkedList< DocumentViewport >::const_iterator backIterator = m_viewportIterator;
+    if ( backIterator != m_viewportHistory.constEnd() )
+    {
+        // go back up to OKULAR_HISTORY_SAVEDSTEPS steps from the current viewportIterator
+        int backSteps = OKULAR_HISTORY_SAVEDSTEPS;
+        while ( backSteps-- && backIterator != m_viewportHistory.constBegin() )
+            --backIterator;
+
+        // create history root node
+        QDomElement historyNode = doc.createElement( "history" );
+        generalInfo.appendChild( historyNode );
+
+        // add old[backIterator] and present[viewportIterator] items
+        QLinkedList< DocumentViewport >::const_iterator endIt = m_viewportIterator;
+        ++endIt;
+        while ( backIterator != endIt )
         {
-            // go back up to OKULAR_HISTORY_SAVEDSTEPS steps from the current viewportIterator
-            int backSteps = OKULAR_HISTORY_SAVEDSTEPS;
-            while ( backSteps-- && backIterator != m_viewportHistory.constBegin() )
-                --backIterator;
-
-            // create history root node
-            QDomElement historyNode = doc.createElement( "history" );
-            generalInfo.appendChild( historyNode );
-
-            // add old[backIterator] and present[viewportIterator] items
-            QLinkedList< DocumentViewport >::const_iterator endIt = m_viewportIterator;
-            ++endIt;
-            while ( backIterator != endIt )
-            {
-                QString name = (backIterator == m_viewportIterator) ? "current" : "oldPage";
-                QDomElement historyEntry = doc.createElement( name );
-                historyEntry.setAttribute( "viewport", (*backIterator).toString() );
-                historyNode.appendChild( historyEntry );
-                ++backIterator;
-            }
+            QString name = (backIterator == m_viewportIterator) ? "current" : "oldPage";
+            QDomElement historyEntry = doc.createElement( name );
+            historyEntry.setAttribute( "viewport", (*backIterator).toString() );
+            historyNode.appendChild( historyEntry );
+            ++backIterator;
         }
-        // create views root node
-        QDomElement viewsNode = doc.createElement( "views" );
-        generalInfo.appendChild( viewsNode );
-        Q_FOREACH ( View * view, m_views )
+    }
+    // create views root node
+    QDomElement viewsNode = doc.createElement( "views" );
+    generalInfo.appendChild( viewsNode );
+    Q_FOREACH ( View * view, m_views )
+    {
+        QDomElement viewEntry = doc.createElement( "view" );
+        viewEntry.setAttribute( "name", view->name() );
+        viewsNode.appendChild( viewEntry );
+        saveViewsInfo( view, viewEntry );
+    }
+}
+
+void DocumentPrivate::saveDocumentInfo() const
+{
+    if ( m_xmlFileName.isEmpty() )
+        return;
+
+    // everything journaled is in the file now
+    if ( writeDocumentInfo( m_xmlFileName, documentInfo() ) )
+    {
+        const QString journal = journalFileName();
+        QFile::remove( journal + QLatin1String( ".old" ) );
+        QFile::remove( journal );
+    }
+}
+
+QString DocumentPrivate::journalFileName() const
+{
+    // next to the document data file
+    if ( !m_xmlFileName.endsWith( QLatin1String( ".xml" ) ) )
+        return QString();
+    return m_xmlFileName.left( m_xmlFileName.length() - 4 ) + QLatin1String( ".journal" );
+}
+
+void DocumentPrivate::journalPage( int page )
+{
+    if ( !m_journalTimer )
+        return;
+
+    m_journalPages.insert( page );
+    if ( !m_journalTimer->isActive() )
+        m_journalTimer->start();
+}
+
+void DocumentPrivate::journalGeneralInfo()
+{
+    if ( !m_journalTimer )
+        return;
+
+    m_journalGeneralInfo = true;
+    if ( !m_journalTimer->isActive() )
+        m_journalTimer->start();
+}
+
+void DocumentPrivate::journalViewport()
+{
+    if ( !m_journalTimer )
+        return;
+
+    // the viewport changes on every scroll step: only the last one is
+    // written, along with the next changes or when the document is closed
+    m_journalGeneralInfo = true;
+}
+
+void DocumentPrivate::_o_flushDocumentInfoJournal()
+{
+    if ( m_journalTimer )
+        m_journalTimer->stop();
+
+    const QString fileName = journalFileName();
+    if ( fileName.isEmpty() || ( m_journalPages.isEmpty() && !m_journalGeneralInfo ) )
+        return;
+
+    QDomDocument doc;
+    QByteArray records;
+    const PageItems saveWhat = documentInfoPageItems( m_annotationsNeedSaveAs );
+    foreach ( int page, m_journalPages )
+    {
+        if ( page < 0 || page >= m_pagesVector.count() )
+            continue;
+
+        // an empty page element drops what was saved for the page
+        QDomElement parent = doc.createElement( "pageList" );
+        m_pagesVector[ page ]->d->saveLocalContents( parent, doc, saveWhat );
+        QDomElement pageElement = parent.firstChildElement( "page" );
+        if ( pageElement.isNull() )
         {
-            QDomElement viewEntry = doc.createElement( "view" );
-            viewEntry.setAttribute( "name", view->name() );
-            viewsNode.appendChild( viewEntry );
-            saveViewsInfo( view, viewEntry );
+            pageElement = doc.createElement( "page" );
+            pageElement.setAttribute( "number", page );
         }
+        records += DocumentInfoJournal::record( pageElement );
+    }
+    if ( m_journalGeneralInfo )
+    {
+        QDomElement generalInfo = doc.createElement( "generalInfo" );
+        saveGeneralInfo( generalInfo, doc );
+        records += DocumentInfoJournal::record( generalInfo );
+    }
+    m_journalPages.clear();
+    m_journalGeneralInfo = false;
 
-        // 3. Save DOM to XML file
-        QString xml = doc.toString();
-        QTextStream os( &infoFile );
-        os.setCodec( "UTF-8" );
-        os << xml;
+    if ( !DocumentInfoJournal::append( fileName, records ) )
+        kWarning(OkularDebug) << "Could not write the document info journal" << fileName;
+}
+
+void DocumentPrivate::_o_compactDocumentInfo()
+{
+    _o_flushDocumentInfoJournal();
+
+    const QString fileName = journalFileName();
+    if ( fileName.isEmpty() || m_documentInfoWriter.activeThreadCount() > 0 )
+        return;
+
+    const qint64 journalSize = QFileInfo( fileName ).size();
+    if ( journalSize < MinimumJournalSizeToCompact || journalSize < QFileInfo( m_xmlFileName ).size() )
+        return;
+
+    // the changes made from now on go to a new journal; if the old one is
+    // still there, a previous compaction failed, and it is kept as is: the
+    // records of the journal replayed again over the new file do no harm
+    const QString oldFileName = fileName + QLatin1String( ".old" );
+    if ( !QFile::exists( oldFileName ) )
+        QFile::rename( fileName, oldFileName );
+
+    m_documentInfoWriter.start( new DocumentInfoWriter( m_xmlFileName, documentInfo(), oldFileName ) );
+}
+
+void DocumentPrivate::slotTimedMemoryCheck()
+{
+    // [MEM] clean memory (for 'free mem dependant' profiles only)
+    if ( SettingsCore::memoryLevel() != SettingsCore::EnumMemoryLevel::Low &&
+         m_allocatedPixmapsTotalMemory > 1024*1024 )
+        cleanupPixmapMemory();
+}
+
+// the previews of the progressive requests are this much smaller on each side
+static const int ProgressivePreviewScale = 4;
+// pages smaller than this (in pixels) are rendered quickly enough anyway
+static const long ProgressiveMinimumArea = 512L * 512L;
+
+PixmapRequest *DocumentPrivate::previewRequest( PixmapRequest *request ) const
+{
+    // only when the observer has nothing to show for the page yet, and the
+    // full rendering is done in a thread once the preview is shown
+    if ( !request->progressive() || request->isTile() || !request->asynchronous()
+         || !m_generator->hasFeature( Generator::Threaded ) || !m_generator->hasFeature( Generator::ProgressiveRendering ) )
+        return 0;
+
+    if ( (long)request->width() * (long)request->height() < ProgressiveMinimumArea )
+        return 0;
+
+    if ( request->page()->hasPixmap( request->observer() )
+         || ( request->observer() == m_tiledObserver && request->page()->d->tilesManager() ) )
+        return 0;
+
+    // a page in the disk cache is read quicker than its preview is rendered;
+    // the key is made like when the request is sent, for the rotated size
+    PixmapDiskCache *cache = PixmapDiskCache::self();
+    if ( cache && cache->isEnabled() )
+    {
+        const bool swapped = (int)m_rotation % 2;
+        if ( swapped )
+            request->d->swap();
+        const QByteArray key = diskCacheKey( request );
+        if ( swapped )
+            request->d->swap();
+        if ( !key.isEmpty() && cache->contains( key ) )
+            return 0;
     }
-    infoFile.close();
-}
 
-void DocumentPrivate::slotTimedMemoryCheck()
-{
-    // [MEM] clean memory (for 'free mem dependant' profiles only)
-    if ( SettingsCore::memoryLevel() != SettingsCore::EnumMemoryLevel::Low &&
-         m_allocatedPixmapsTotalMemory > 1024*1024 )
-        cleanupPixmapMemory();
+    PixmapRequest *preview = new PixmapRequest( request->observer(), request->pageNumber(),
+        request->width() / ProgressivePreviewScale, request->height() / ProgressivePreviewScale,
+        request->priority(), PixmapRequest::Asynchronous );
+    preview->d->mPage = request->page();
+    preview->d->mPreview = true;
+    return preview;
 }
 
 void DocumentPrivate::sendGeneratorPixmapRequest()
@@ -1301,7 +1847,9 @@ void DocumentPrivate::sendGeneratorPixmapRequest()
     const qulonglong memoryToFree = calculateMemoryToFree();
     const int currentViewportPage = (*m_viewportIterator).pageNumber;
     int maxDistance = INT_MAX; // Default: No maximum
-    if ( memoryToFree )
+    PixmapMemoryBudget *budget = PixmapMemoryBudget::self();
+    // no need to skip preloading if the documents used before can make room
+    if ( memoryToFree && ( !budget || budget->reclaimableMemory( this ) < memoryToFree ) )
     {
         AllocatedPixmap *pixmapToReplace = searchLowestPriorityPixmap( true );
         if ( pixmapToReplace )
@@ -1310,42 +1858,49 @@ void DocumentPrivate::sendGeneratorPixmapRequest()
 
     // find a request
     PixmapRequest * request = 0;
+    QSet< PixmapRequest * > waitingRequests;
     m_pixmapRequestsMutex.lock();
-    while ( !m_pixmapRequestsStack.isEmpty() && !request )
+    while ( !request )
     {
-        PixmapRequest * r = m_pixmapRequestsStack.last();
-        if (!r)
-        {
-            m_pixmapRequestsStack.pop_back();
-            continue;
-        }
+        PixmapRequest * r = m_pixmapRequestsQueue.top( waitingRequests );
+        if ( !r )
+            break;
 
         QRect requestRect = r->isTile() ? r->normalizedRect().geometry( r->width(), r->height() ) : QRect( 0, 0, r->width(), r->height() );
         TilesManager *tilesManager = ( r->observer() == m_tiledObserver ) ? r->page()->d->tilesManager() : 0;
 
+        // With several render threads the same page may still be rendering for
+        // this observer: leave it queued, requestDone() will send it, and
+        // look for another request for the other threads
+        if ( isPixmapRequestExecuting( r->observer(), r->pageNumber() ) )
+        {
+            waitingRequests.insert( r );
+        }
         // If it's a preload but the generator is not threaded no point in trying to preload
-        if ( r->preload() && !m_generator->hasFeature( Generator::Threaded ) )
+        else if ( r->preload() && !m_generator->hasFeature( Generator::Threaded ) )
         {
-            m_pixmapRequestsStack.pop_back();
+            m_pixmapRequestsQueue.remove( r );
             delete r;
         }
         // request only if page isn't already present and request has valid id
         // request only if page isn't already present and request has valid id
         else if ( ( !r->d->mForce && r->page()->hasPixmap( r->observer(), r->width(), r->height(), r->normalizedRect() ) ) || !m_observers.contains(r->observer()) )
         {
-            m_pixmapRequestsStack.pop_back();
+            // the observer still wants the pixmap it has: count it as used
+            m_allocatedPixmaps.touch( r->observer(), r->pageNumber() );
+            m_pixmapRequestsQueue.remove( r );
             delete r;
         }
         else if ( !r->d->mForce && r->preload() && qAbs( r->pageNumber() - currentViewportPage ) >= maxDistance )
         {
-            m_pixmapRequestsStack.pop_back();
+            m_pixmapRequestsQueue.remove( r );
             //kDebug() << "Ignoring request that doesn't fit in cache";
             delete r;
         }
         // Ignore requests for pixmaps that are already being generated
         else if ( tilesManager && tilesManager->isRequesting( r->normalizedRect(), r->width(), r->height() ) )
         {
-            m_pixmapRequestsStack.pop_back();
+            m_pixmapRequestsQueue.remove( r );
             delete r;
         }
         // If the requested area is above 8000000 pixels, switch on the tile manager
@@ -1400,7 +1955,7 @@ void DocumentPrivate::sendGeneratorPixmapRequest()
                 // preload requests issued by PageView if the requested page is
                 // not visible and the user has just switched from a non-tiled
                 // zoom level to a tiled one
-                m_pixmapRequestsStack.pop_back();
+                m_pixmapRequestsQueue.remove( r );
                 delete r;
             }
         }
@@ -1418,7 +1973,7 @@ void DocumentPrivate::sendGeneratorPixmapRequest()
         }
         else if ( (long)requestRect.width() * (long)requestRect.height() > 20000000L )
         {
-            m_pixmapRequestsStack.pop_back();
+            m_pixmapRequestsQueue.remove( r );
             if ( !m_warnedOutOfMemory )
             {
                 kWarning(OkularDebug).nospace() << "Running out of memory on page " << r->pageNumber()
@@ -1457,7 +2012,13 @@ void DocumentPrivate::sendGeneratorPixmapRequest()
     {
         QRect requestRect = !request->isTile() ? QRect(0, 0, request->width(), request->height() ) : request->normalizedRect().geometry( request->width(), request->height() );
         kDebug(OkularDebug).nospace() << "sending request observer=" << request->observer() << " " <<requestRect.width() << "x" << requestRect.height() << "@" << request->pageNumber() << " async == " << request->asynchronous() << " isTile == " << request->isTile();
-        m_pixmapRequestsStack.removeAll ( request );
+
+        // [PROGRESSIVE] render a preview first, the request itself stays
+        // queued until the preview is done, and is then sent as usual
+        if ( PixmapRequest *preview = previewRequest( request ) )
+            request = preview;
+        else
+            m_pixmapRequestsQueue.dispatch( request );
 
         if ( tm )
             tm->setRequest( request->normalizedRect(), request->width(), request->height() );
@@ -1469,12 +2030,27 @@ void DocumentPrivate::sendGeneratorPixmapRequest()
             request->setNormalizedRect( TilesManager::fromRotatedRect(
                         request->normalizedRect(), m_rotation ) );
 
+        // the generator will look for the rendered page in the disk cache first
+        request->d->mDiskCacheKey = diskCacheKey( request );
+
         // we always have to unlock _before_ the generatePixmap() because
         // a sync generation would end with requestDone() -> deadlock, and
         // we can not really know if the generator can do async requests
         m_executingPixmapRequests.push_back( request );
         m_pixmapRequestsMutex.unlock();
+        const bool threaded = request->asynchronous() && m_generator->hasFeature( Generator::Threaded );
         m_generator->generatePixmap( request );
+
+        // a generator with several render threads may accept more requests
+        // right away, keep feeding it until it is busy
+        if ( threaded && m_generator->canGeneratePixmap() )
+        {
+            m_pixmapRequestsMutex.lock();
+            const bool hasPixmaps = !m_pixmapRequestsQueue.isEmpty();
+            m_pixmapRequestsMutex.unlock();
+            if ( hasPixmaps )
+                sendGeneratorPixmapRequest();
+        }
     }
     else
     {
@@ -1484,6 +2060,27 @@ void DocumentPrivate::sendGeneratorPixmapRequest()
     }
 }
 
+bool DocumentPrivate::isPixmapRequestExecuting( DocumentObserver *observer, int pageNumber ) const
+{
+    // NOTE: m_pixmapRequestsMutex must be locked by the caller
+    foreach ( PixmapRequest *executing, m_executingPixmapRequests )
+    {
+        if ( executing->observer() == observer && executing->pageNumber() == pageNumber )
+            return true;
+    }
+    return false;
+}
+
+void DocumentPrivate::abortPixmapRequests( DocumentObserver *observer, const QSet< int > &keptPages )
+{
+    // NOTE: m_pixmapRequestsMutex must be locked by the caller
+    foreach ( PixmapRequest *executing, m_executingPixmapRequests )
+    {
+        if ( ( !observer || executing->observer() == observer ) && !keptPages.contains( executing->pageNumber() ) )
+            executing->d->mShouldAbortRender = 1;
+    }
+}
+
 void DocumentPrivate::rotationFinished( int page, Okular::Page *okularPage )
 {
     Okular::Page *wantedPage = m_pagesVector.value( page, 0 );
@@ -1541,7 +2138,6 @@ void DocumentPrivate::slotGeneratorConfigChanged( const QString& )
         }
 
         // [MEM] remove allocation descriptors
-        qDeleteAll( m_allocatedPixmaps );
         m_allocatedPixmaps.clear();
         m_allocatedPixmapsTotalMemory = 0;
 
@@ -1561,6 +2157,8 @@ void DocumentPrivate::refreshPixmaps( int pageNumber )
     if ( !page )
         return;
 
+    m_modifiedPages.insert( pageNumber );
+
     QLinkedList< Okular::PixmapRequest * > requestedPixmaps;
     QMap< DocumentObserver*, PagePrivate::PixmapObject >::ConstIterator it = page->d->m_pixmaps.constBegin(), itEnd = page->d->m_pixmaps.constEnd();
     for ( ; it != itEnd; ++it )
@@ -1608,8 +2206,158 @@ void DocumentPrivate::refreshPixmaps( int pageNumber )
         m_parent->requestPixmaps( requestedPixmaps, Okular::Document::NoOption );
 }
 
+void DocumentPrivate::loadPageMetadata( Page *page )
+{
+    if ( !m_generator )
+        return;
+
+    m_generator->loadPageMetadata( page );
+
+    // same check as when opening the document, for the annotations of the
+    // generator that were not loaded then
+    if ( !m_annotationsNeedSaveAs && !m_archiveData && canAddAnnotationsNatively() &&
+         !page->m_annotations.isEmpty() )
+        m_annotationsNeedSaveAs = true;
+
+    // the page can be loaded while an observer walks the pages, so tell
+    // them about it later
+    if ( m_pagesWithLoadedMetadata.isEmpty() )
+        QTimer::singleShot( 0, m_parent, SLOT(_o_pagesMetadataLoaded()) );
+    m_pagesWithLoadedMetadata.append( page->number() );
+}
+
+void DocumentPrivate::_o_pagesMetadataLoaded()
+{
+    const QList< int > pages = m_pagesWithLoadedMetadata;
+    m_pagesWithLoadedMetadata.clear();
+    foreach ( int page, pages )
+    {
+        if ( page < m_pagesVector.count() )
+            foreachObserverD( notifyPageChanged( page, DocumentObserver::Annotations | DocumentObserver::Metadata ) );
+    }
+}
+
+void DocumentPrivate::_o_loadPagesMetadata()
+{
+    if ( !m_generator )
+        return;
+
+    // load the metadata a few pages at a time, then give the event loop a
+    // chance; don't wait for the page being rendered, try again later
+    QElapsedTimer time;
+    time.start();
+    while ( m_nextMetadataPage < m_pagesVector.count() && time.elapsed() < 20 )
+    {
+        Page *page = m_pagesVector.at( m_nextMetadataPage );
+        if ( !page->isMetadataLoaded() )
+        {
+            if ( !m_generator->userMutex()->tryLock() )
+            {
+                m_loadMetadataTimer->start( 20 );
+                return;
+            }
+            m_generator->userMutex()->unlock();
+            page->d->loadMetadata();
+        }
+        ++m_nextMetadataPage;
+    }
+
+    if ( m_nextMetadataPage < m_pagesVector.count() )
+        m_loadMetadataTimer->start( 0 );
+}
+
+void DocumentPrivate::_o_loadMorePages()
+{
+    loadMorePages( false );
+}
+
+void DocumentPrivate::loadMorePages( bool allPages )
+{
+    if ( !m_generator )
+        return;
+
+    // load pages for a short while, then give the event loop a chance
+    const int oldCount = m_pagesVector.count();
+    bool morePages = true;
+    QElapsedTimer time;
+    time.start();
+    while ( morePages && ( allPages || time.elapsed() < 50 ) )
+    {
+        const int count = m_pagesVector.count();
+        morePages = m_generator->loadMorePages( m_pagesVector );
+        // the generator could not load pages now (e.g. it is busy rendering)
+        if ( m_pagesVector.count() == count )
+        {
+            if ( !allPages )
+                break;
+            // wait for the page being rendered
+            m_generator->userMutex()->lock();
+            m_generator->userMutex()->unlock();
+        }
+    }
+
+    QList< int > restoredPages;
+    for ( int i = oldCount; i < m_pagesVector.count(); ++i )
+    {
+        Page *page = m_pagesVector.at( i );
+        page->d->m_doc = this;
+        if ( m_rotation != Rotation0 )
+            page->d->rotateAt( m_rotation );
+        // the page size chosen for the whole document
+        if ( !m_pageSize.isNull() )
+            page->d->changeSize( m_pageSize );
+
+        // same check as when opening the document
+        if ( !m_annotationsNeedSaveAs && !m_archiveData && canAddAnnotationsNatively() &&
+             page->isMetadataLoaded() && !page->m_annotations.isEmpty() )
+            m_annotationsNeedSaveAs = true;
+
+        const QDomElement pageInfo = m_pendingPageInfo.take( i );
+        if ( !pageInfo.isNull() )
+        {
+            page->d->restoreLocalContents( pageInfo );
+            restoredPages.append( i );
+        }
+    }
+
+    if ( m_pagesVector.count() > oldCount )
+    {
+        if ( m_loadAllPagesMetadata && !m_loadMetadataTimer->isActive() )
+            m_loadMetadataTimer->start( 0 );
+
+        foreachObserverD( notifySetup( m_pagesVector, DocumentObserver::PagesAppended ) );
+        foreach ( int page, restoredPages )
+            foreachObserverD( notifyPageChanged( page, DocumentObserver::Annotations ) );
+
+        if ( m_pendingViewport.isValid() && m_pendingViewport.pageNumber < m_pagesVector.count() )
+        {
+            const DocumentViewport viewport = m_pendingViewport;
+            m_pendingViewport = DocumentViewport();
+            if ( (*m_viewportIterator).pageNumber == m_pendingViewportFallbackPage )
+                m_parent->setViewport( viewport );
+        }
+    }
+
+    if ( morePages )
+    {
+        m_loadMorePagesTimer->start( m_pagesVector.count() > oldCount ? 0 : 20 );
+    }
+    else
+    {
+        m_loadMorePagesTimer->stop();
+        kDebug(OkularDebug) << "Loaded all the" << m_pagesVector.count() << "pages";
+        m_pendingPageInfo.clear();
+        m_pendingViewport = DocumentViewport();
+
+        loadTextSearchIndex();
+    }
+}
+
 void DocumentPrivate::_o_configChanged()
 {
+    updatePixmapEvictionPolicy();
+    updateDiskCacheSettings();
+
     // free text pages if needed
     calculateMaxTextPages();
     while (m_allocatedTextPagesFifo.count() > m_maxAllocatedTextPages)
@@ -1765,9 +2513,18 @@ void DocumentPrivate::doContinueAllDocumentSearch(void *pagesToNotifySet, void *
         foreach(const MatchesVector &mv, *pageMatches) qDeleteAll(mv);
         delete pageMatches;
         delete pagesToNotify;
+        delete m_searchTextExtraction;
+        m_searchTextExtraction = 0;
         return;
     }
 
+    // the search index tells which is the next page that may match
+    if ( search->useCandidatePages )
+    {
+        QVector< int >::const_iterator nextPage = qLowerBound( search->candidatePages.constBegin(), search->candidatePages.constEnd(), currentPage );
+        currentPage = nextPage != search->candidatePages.constEnd() ? *nextPage : m_pagesVector.count();
+    }
+
     if (currentPage < m_pagesVector.count())
     {
         // get page (from the first to the last)
@@ -1776,7 +2533,7 @@ void DocumentPrivate::doContinueAllDocumentSearch(void *pagesToNotifySet, void *
 
         // request search page if needed
         if ( !page->hasTextPage() )
-            m_parent->requestTextPage( pageNumber );
+            requestSearchTextPage( page );
 
         // loop on a page adding highlights for all found items
         RegularAreaRect * lastMatch = 0;
@@ -1831,6 +2588,8 @@ void DocumentPrivate::doContinueAllDocumentSearch(void *pagesToNotifySet, void *
 
         delete pageMatches;
         delete pagesToNotify;
+        delete m_searchTextExtraction;
+        m_searchTextExtraction = 0;
     }
 }
 
@@ -1858,6 +2617,8 @@ void DocumentPrivate::doContinueGooglesDocumentSearch(void *pagesToNotifySet, vo
         }
         delete pageMatches;
         delete pagesToNotify;
+        delete m_searchTextExtraction;
+        m_searchTextExtraction = 0;
         return;
     }
 
@@ -1866,6 +2627,13 @@ void DocumentPrivate::doContinueGooglesDocumentSearch(void *pagesToNotifySet, vo
     int baseHue, baseSat, baseVal;
     color.getHsv( &baseHue, &baseSat, &baseVal );
 
+    // the search index tells which is the next page that may match
+    if ( search->useCandidatePages )
+    {
+        QVector< int >::const_iterator nextPage = qLowerBound( search->candidatePages.constBegin(), search->candidatePages.constEnd(), currentPage );
+        currentPage = nextPage != search->candidatePages.constEnd() ? *nextPage : m_pagesVector.count();
+    }
+
     if (currentPage < m_pagesVector.count())
     {
         // get page (from the first to the last)
@@ -1874,7 +2642,7 @@ void DocumentPrivate::doContinueGooglesDocumentSearch(void *pagesToNotifySet, vo
 
         // request search page if needed
         if ( !page->hasTextPage() )
-            m_parent->requestTextPage( pageNumber );
+            requestSearchTextPage( page );
 
         // loop on a page adding highlights for all found items
         bool allMatched = wordCount > 0,
@@ -1952,6 +2720,8 @@ void DocumentPrivate::doContinueGooglesDocumentSearch(void *pagesToNotifySet, vo
 
         delete pageMatches;
         delete pagesToNotify;
+        delete m_searchTextExtraction;
+        m_searchTextExtraction = 0;
     }
 }
 
@@ -2047,6 +2817,9 @@ Document::Document( QWidget *widget )
     d->m_undoStack = new QUndoStack(this);
     d->m_tiledObserver = 0;
 
+    if ( PixmapMemoryBudget::self() )
+        PixmapMemoryBudget::self()->registerDocument( d );
+
     connect( SettingsCore::self(), SIGNAL(configChanged()), this, SLOT(_o_configChanged()) );
     connect( d->m_undoStack, SIGNAL( canUndoChanged(bool) ), this, SIGNAL( canUndoChanged(bool)));
     connect( d->m_undoStack, SIGNAL( canRedoChanged(bool) ), this, SIGNAL( canRedoChanged(bool) ) );
@@ -2069,12 +2842,17 @@ Document::~Document()
     // delete the bookmark manager
     delete d->m_bookmarkManager;
 
+    d->clearReloadedPages();
+
     // delete the loaded generators
     QHash< QString, GeneratorInfo >::const_iterator it = d->m_loadedGenerators.constBegin(), itEnd = d->m_loadedGenerators.constEnd();
     for ( ; it != itEnd; ++it )
         d->unloadGenerator( it.value() );
     d->m_loadedGenerators.clear();
 
+    if ( PixmapMemoryBudget::self() )
+        PixmapMemoryBudget::self()->unregisterDocument( d );
+
     // delete the private structure
     delete d;
 }
@@ -2240,7 +3018,8 @@ bool Document::openDocument( const QString & docFile, const KUrl& url, const KMi
     foreach ( Page * p, d->m_pagesVector )
     {
         p->d->m_doc = d;
-        if ( !p->annotations().empty() )
+        // the pages with lazily loaded metadata are checked when loaded
+        if ( p->isMetadataLoaded() && !p->m_annotations.empty() )
             containsExternalAnnotations = true;
     }
 
@@ -2257,12 +3036,17 @@ bool Document::openDocument( const QString & docFile, const KUrl& url, const KMi
     else
     {
         d->loadDocumentInfo();
-        d->m_annotationsNeedSaveAs = ( d->canAddAnnotationsNatively() && containsExternalAnnotations );
+        // restoring the local annotations may have loaded more pages
+        d->m_annotationsNeedSaveAs = ( d->canAddAnnotationsNatively() && ( containsExternalAnnotations || d->m_annotationsNeedSaveAs ) );
     }
 
     d->m_showWarningLimitedAnnotSupport = true;
     d->m_bookmarkManager->setUrl( d->m_url );
 
+    // the pages that did not change since the document was closed for
+    // reloading get back what was rendered for them
+    d->restoreReloadedPages();
+
     // 3. setup observers inernal lists and data
     foreachObserver( notifySetup( d->m_pagesVector, DocumentObserver::DocumentChanged ) );
 
@@ -2272,17 +3056,32 @@ bool Document::openDocument( const QString & docFile, const KUrl& url, const KMi
     {
         (*d->m_viewportIterator) = DocumentViewport();
         if ( loadedViewport.pageNumber >= (int)d->m_pagesVector.size() )
+        {
+            // the page may be loaded later
+            if ( d->m_generator->hasFeature( Generator::IncrementalLoading ) )
+            {
+                d->m_pendingViewport = loadedViewport;
+                d->m_pendingViewportFallbackPage = d->m_pagesVector.size() - 1;
+            }
             loadedViewport.pageNumber = d->m_pagesVector.size() - 1;
+        }
     }
     else
         loadedViewport.pageNumber = 0;
     setViewport( loadedViewport );
 
-    // start bookmark saver timer
+    // start the document info journal and its compaction timer
+    if ( !d->m_journalTimer )
+    {
+        d->m_journalTimer = new QTimer( this );
+        d->m_journalTimer->setSingleShot( true );
+        d->m_journalTimer->setInterval( 2000 );
+        connect( d->m_journalTimer, SIGNAL(timeout()), this, SLOT(_o_flushDocumentInfoJournal()) );
+    }
     if ( !d->m_saveBookmarksTimer )
     {
         d->m_saveBookmarksTimer = new QTimer( this );
-        connect( d->m_saveBookmarksTimer, SIGNAL(timeout()), this, SLOT(saveDocumentInfo()) );
+        connect( d->m_saveBookmarksTimer, SIGNAL(timeout()), this, SLOT(_o_compactDocumentInfo()) );
     }
     d->m_saveBookmarksTimer->start( 5 * 60 * 1000 );
 
@@ -2297,14 +3096,41 @@ bool Document::openDocument( const QString & docFile, const KUrl& url, const KMi
     const DocumentViewport nextViewport = d->nextDocumentViewport();
     if ( nextViewport.isValid() )
     {
-        setViewport( nextViewport );
+        if ( nextViewport.pageNumber >= (int)d->m_pagesVector.size() && d->m_generator->hasFeature( Generator::IncrementalLoading ) )
+        {
+            d->m_pendingViewport = nextViewport;
+            d->m_pendingViewportFallbackPage = (*d->m_viewportIterator).pageNumber;
+        }
+        else
+        {
+            setViewport( nextViewport );
+        }
         d->m_nextDocumentViewport = DocumentViewport();
         d->m_nextDocumentDestination = QString();
     }
 
+    // 5. load the pages the generator did not load yet
+    if ( d->m_generator->hasFeature( Generator::IncrementalLoading ) )
+    {
+        if ( !d->m_loadMorePagesTimer )
+        {
+            d->m_loadMorePagesTimer = new QTimer( this );
+            d->m_loadMorePagesTimer->setSingleShot( true );
+            connect( d->m_loadMorePagesTimer, SIGNAL(timeout()), this, SLOT(_o_loadMorePages()) );
+        }
+        d->m_loadMorePagesTimer->start( 0 );
+    }
+    else
+    {
+        d->loadTextSearchIndex();
+    }
+
     AudioPlayer::instance()->d->m_currentDocument = isstdin ? KUrl() : d->m_url;
     d->m_docSize = document_size;
 
+    if ( !isstdin && d->m_generator->hasFeature( Generator::CachedRendering ) )
+        d->m_diskCacheFingerprint = PixmapDiskCache::fileFingerprint( docFile );
+
     const QStringList docScripts = d->m_generator->metaData( "DocumentScripts", "JavaScript" ).toStringList();
     if ( !docScripts.isEmpty() )
     {
@@ -2342,13 +3168,17 @@ void Document::closeDocument()
     delete d->m_scripter;
     d->m_scripter = 0;
 
+    // stop loading the pages
+    if ( d->m_loadMorePagesTimer )
+        d->m_loadMorePagesTimer->stop();
+    if ( d->m_loadMetadataTimer )
+        d->m_loadMetadataTimer->stop();
+
      // remove requests left in queue
     d->m_pixmapRequestsMutex.lock();
-    QLinkedList< PixmapRequest * >::const_iterator sIt = d->m_pixmapRequestsStack.constBegin();
-    QLinkedList< PixmapRequest * >::const_iterator sEnd = d->m_pixmapRequestsStack.constEnd();
-    for ( ; sIt != sEnd; ++sIt )
-        delete *sIt;
-    d->m_pixmapRequestsStack.clear();
+    qDeleteAll( d->m_pixmapRequestsQueue.takeAll() );
+    d->m_pixmapRequestsQueue.resetStatistics();
+    d->abortPixmapRequests( 0 );
     d->m_pixmapRequestsMutex.unlock();
 
     QEventLoop loop;
@@ -2375,13 +3205,45 @@ void Document::closeDocument()
         d->m_fontThread = 0;
     }
 
+    if ( d->m_textIndexingThread )
+    {
+        disconnect( d->m_textIndexingThread, 0, this, 0 );
+        d->m_textIndexingThread->stopIndexing();
+        d->m_textIndexingThread->wait();
+        delete d->m_textIndexingThread;
+        d->m_textIndexingThread = 0;
+    }
+    delete d->m_textSearchIndex;
+    d->m_textSearchIndex = 0;
+    delete d->m_searchTextExtraction;
+    d->m_searchTextExtraction = 0;
+
     // stop any audio playback
     AudioPlayer::instance()->stopPlaybacks();
 
+    // keep what was rendered for the pages that will not change, now that
+    // nothing is rendering anymore
+    if ( d->m_keepPagesOnClose )
+    {
+        d->keepReloadedPages();
+        d->m_keepPagesOnClose = false;
+    }
+    else
+    {
+        d->clearReloadedPages();
+    }
+
     // close the current document and save document info if a document is still opened
+    d->m_documentInfoWriter.waitForDone();
     if ( d->m_generator && d->m_pagesVector.size() > 0 )
     {
-        d->saveDocumentInfo();
+        // the last changes go to the journal, only a big journal is
+        // compacted into the document info file
+        d->journalGeneralInfo();
+        d->_o_flushDocumentInfoJournal();
+        const qint64 journalSize = QFileInfo( d->journalFileName() ).size();
+        if ( journalSize >= MinimumJournalSizeToCompact && journalSize >= QFileInfo( d->m_xmlFileName ).size() )
+            d->saveDocumentInfo();
         d->m_generator->closeDocument();
     }
 
@@ -2390,6 +3252,10 @@ void Document::closeDocument()
         d->m_memCheckTimer->stop();
     if ( d->m_saveBookmarksTimer )
         d->m_saveBookmarksTimer->stop();
+    if ( d->m_journalTimer )
+        d->m_journalTimer->stop();
+    d->m_journalPages.clear();
+    d->m_journalGeneralInfo = false;
 
     if ( d->m_generator )
     {
@@ -2431,7 +3297,6 @@ void Document::closeDocument()
     d->m_pagesVector.clear();
 
     // clear 'memory allocation' descriptors
-    qDeleteAll( d->m_allocatedPixmaps );
     d->m_allocatedPixmaps.clear();
 
     // clear 'running searches' descriptors
@@ -2456,6 +3321,14 @@ void Document::closeDocument()
     d->m_viewportIterator = d->m_viewportHistory.begin();
     d->m_allocatedPixmapsTotalMemory = 0;
     d->m_allocatedTextPagesFifo.clear();
+    d->m_hibernated = false;
+    d->m_pagesWithLoadedMetadata.clear();
+    d->m_nextMetadataPage = 0;
+    d->m_loadAllPagesMetadata = false;
+    d->m_pendingPageInfo.clear();
+    d->m_diskCacheFingerprint.clear();
+    d->m_modifiedPages.clear();
+    d->m_pendingViewport = DocumentViewport();
     d->m_pageSize = PageSize();
     d->m_pageSizes.clear();
 
@@ -2491,19 +3364,15 @@ void Document::removeObserver( DocumentObserver * pObserver )
             (*it)->deletePixmap( pObserver );
 
         // [MEM] free observer's allocation descriptors
-        QLinkedList< AllocatedPixmap * >::iterator aIt = d->m_allocatedPixmaps.begin();
-        QLinkedList< AllocatedPixmap * >::iterator aEnd = d->m_allocatedPixmaps.end();
-        while ( aIt != aEnd )
-        {
-            AllocatedPixmap * p = *aIt;
-            if ( p->observer == pObserver )
-            {
-                aIt = d->m_allocatedPixmaps.erase( aIt );
-                delete p;
-            }
-            else
-                ++aIt;
-        }
+        const QList< AllocatedPixmap * > observerPixmaps = d->m_allocatedPixmaps.takeAll( pObserver );
+        foreach ( AllocatedPixmap * p, observerPixmaps )
+            d->m_allocatedPixmapsTotalMemory -= p->memory;
+        qDeleteAll( observerPixmaps );
+
+        // its pixmaps still rendering are not needed any more
+        d->m_pixmapRequestsMutex.lock();
+        d->abortPixmapRequests( pObserver );
+        d->m_pixmapRequestsMutex.unlock();
 
         // delete observer entry from the map
         d->m_observers.remove( pObserver );
@@ -2529,7 +3398,6 @@ void Document::reparseConfig()
         }
 
         // [MEM] remove allocation descriptors
-        qDeleteAll( d->m_allocatedPixmaps );
         d->m_allocatedPixmaps.clear();
         d->m_allocatedPixmapsTotalMemory = 0;
 
@@ -2554,6 +3422,47 @@ bool Document::isOpened() const
     return d->m_generator;
 }
 
+void Document::hibernate()
+{
+    if ( !d->m_generator || d->m_hibernated )
+        return;
+
+    // drop the pending requests, the ones being executed will end normally
+    d->m_pixmapRequestsMutex.lock();
+    qDeleteAll( d->m_pixmapRequestsQueue.takeAll() );
+    d->m_pixmapRequestsMutex.unlock();
+
+    // [MEM] free the pixmaps and the tiles of all the observers
+    QVector< Page * >::const_iterator pIt = d->m_pagesVector.constBegin(), pEnd = d->m_pagesVector.constEnd();
+    for ( ; pIt != pEnd; ++pIt )
+        (*pIt)->deletePixmaps();
+    d->m_allocatedPixmaps.clear();
+    d->m_allocatedPixmapsTotalMemory = 0;
+
+    // [MEM] free the text pages
+    foreach ( int page, d->m_allocatedTextPagesFifo )
+        d->m_pagesVector.at( page )->setTextPage( 0 ); // deletes the textpage
+    d->m_allocatedTextPagesFifo.clear();
+
+    d->m_hibernated = true;
+}
+
+void Document::setKeepPagesOnClose( bool keep )
+{
+    d->m_keepPagesOnClose = keep;
+}
+
+void Document::wakeUp()
+{
+    if ( !d->m_hibernated )
+        return;
+
+    d->m_hibernated = false;
+
+    // the observers ask again for the pixmaps they need
+    foreachObserver( notifyContentsCleared( DocumentObserver::Pixmap ) );
+}
+
 bool Document::canConfigurePrinter( ) const
 {
     if ( d->m_generator )
@@ -2672,11 +3581,27 @@ const QVector< VisiblePageRect * > & Document::visiblePageRects() const
 
 void Document::setVisiblePageRects( const QVector< VisiblePageRect * > & visiblePageRects, DocumentObserver *excludeObserver )
 {
+    QSet< int > previouslyVisiblePages;
     QVector< VisiblePageRect * >::const_iterator vIt = d->m_pageRects.constBegin();
     QVector< VisiblePageRect * >::const_iterator vEnd = d->m_pageRects.constEnd();
     for ( ; vIt != vEnd; ++vIt )
+    {
+        previouslyVisiblePages.insert( (*vIt)->pageNumber );
         delete *vIt;
+    }
     d->m_pageRects = visiblePageRects;
+    for ( vIt = d->m_pageRects.constBegin(), vEnd = d->m_pageRects.constEnd(); vIt != vEnd; ++vIt )
+    {
+        // the pages being shown need their annotations and forms
+        Page *page = d->m_pagesVector.value( (*vIt)->pageNumber );
+        if ( page )
+            page->d->loadMetadata();
+
+        // [MEM] a page coming into view uses the pixmap it has, which is not
+        // requested again: count it as an access for the eviction policy
+        if ( excludeObserver && !previouslyVisiblePages.contains( (*vIt)->pageNumber ) )
+            d->m_allocatedPixmaps.touch( excludeObserver, (*vIt)->pageNumber );
+    }
     // notify change to all other (different from id) observers
     foreach(DocumentObserver *o, d->m_observers)
         if ( o != excludeObserver )
@@ -2693,6 +3618,27 @@ uint Document::pages() const
     return d->m_pagesVector.size();
 }
 
+void Document::loadAllPages()
+{
+    if ( d->m_loadMorePagesTimer && d->m_loadMorePagesTimer->isActive() )
+        d->loadMorePages( true );
+}
+
+void Document::loadPagesMetadata()
+{
+    if ( !d->m_generator || d->m_loadAllPagesMetadata )
+        return;
+
+    d->m_loadAllPagesMetadata = true;
+    if ( !d->m_loadMetadataTimer )
+    {
+        d->m_loadMetadataTimer = new QTimer( this );
+        d->m_loadMetadataTimer->setSingleShot( true );
+        connect( d->m_loadMetadataTimer, SIGNAL(timeout()), this, SLOT(_o_loadPagesMetadata()) );
+    }
+    d->m_loadMetadataTimer->start( 0 );
+}
+
 KUrl Document::currentDocument() const
 {
     return d->m_url;
@@ -2784,6 +3730,19 @@ bool Document::historyAtEnd() const
 
 QVariant Document::metaData( const QString & key, const QVariant & option ) const
 {
+    if ( key == QLatin1String( "PixmapRequestQueueStatistics" ) )
+    {
+        QMutexLocker locker( &d->m_pixmapRequestsMutex );
+        QVariantMap statistics;
+        statistics.insert( "QueuedRequests", d->m_pixmapRequestsQueue.count() );
+        statistics.insert( "ExecutingRequests", d->m_executingPixmapRequests.count() );
+        statistics.insert( "MaximumQueuedRequests", d->m_pixmapRequestsQueue.maximumCount() );
+        statistics.insert( "DispatchedRequests", d->m_pixmapRequestsQueue.dispatchedCount() );
+        statistics.insert( "AverageWaitTime", d->m_pixmapRequestsQueue.averageWaitTime() );
+        statistics.insert( "MaximumWaitTime", d->m_pixmapRequestsQueue.maximumWaitTime() );
+        return statistics;
+    }
+
     return d->m_generator ? d->m_generator->metaData( key, option ) : QVariant();
 }
 
@@ -2842,32 +3801,40 @@ void Document::requestPixmaps( const QLinkedList< PixmapRequest * > & requests,
         return;
     }
 
-    // 1. [CLEAN STACK] remove previous requests of requesterID
+    // [MEM] a document that wants pixmaps is in use, keep its ones last
+    if ( PixmapMemoryBudget::self() )
+        PixmapMemoryBudget::self()->touch( d );
+
+    // the annotations are painted along with the pixmaps of the pages being
+    // shown; the generator may have to wait for a render to load them, so
+    // don't hold the queue meanwhile
+    QLinkedList< PixmapRequest * >::const_iterator mIt = requests.constBegin(), mEnd = requests.constEnd();
+    for ( ; mIt != mEnd; ++mIt )
+    {
+        Page *page = d->m_pagesVector.value( (*mIt)->pageNumber() );
+        if ( page && !(*mIt)->preload() )
+            page->d->loadMetadata();
+    }
+
+    // 1. [CLEAN QUEUE] remove previous requests of requesterID
     // FIXME This assumes all requests come from the same observer, that is true atm but not enforced anywhere
+    // (previous requests for the requested pages are replaced when queueing)
     DocumentObserver *requesterObserver = requests.first()->observer();
-    QSet< int > requestedPages;
+    d->m_pixmapRequestsMutex.lock();
+    if ( reqOptions & RemoveAllPrevious )
     {
+        qDeleteAll( d->m_pixmapRequestsQueue.takeAll( requesterObserver ) );
+
+        // the renders still running for pages not wanted any more are
+        // stopped, if the generator can
+        QSet< int > requestedPages;
         QLinkedList< PixmapRequest * >::const_iterator rIt = requests.constBegin(), rEnd = requests.constEnd();
         for ( ; rIt != rEnd; ++rIt )
             requestedPages.insert( (*rIt)->pageNumber() );
-    }
-    const bool removeAllPrevious = reqOptions & RemoveAllPrevious;
-    d->m_pixmapRequestsMutex.lock();
-    QLinkedList< PixmapRequest * >::iterator sIt = d->m_pixmapRequestsStack.begin(), sEnd = d->m_pixmapRequestsStack.end();
-    while ( sIt != sEnd )
-    {
-        if ( (*sIt)->observer() == requesterObserver
-             && ( removeAllPrevious || requestedPages.contains( (*sIt)->pageNumber() ) ) )
-        {
-            // delete request and remove it from stack
-            delete *sIt;
-            sIt = d->m_pixmapRequestsStack.erase( sIt );
-        }
-        else
-            ++sIt;
+        d->abortPixmapRequests( requesterObserver, requestedPages );
     }
 
-    // 2. [ADD TO STACK] add requests to stack
+    // 2. [ADD TO QUEUE] add requests to the queue
     QLinkedList< PixmapRequest * >::const_iterator rIt = requests.constBegin(), rEnd = requests.constEnd();
     for ( ; rIt != rEnd; ++rIt )
     {
@@ -2910,19 +3877,8 @@ void Document::requestPixmaps( const QLinkedList< PixmapRequest * > & requests,
         if ( !request->asynchronous() )
             request->d->mPriority = 0;
 
-        // add request to the 'stack' at the right place
-        if ( !request->priority() )
-            // add priority zero requests to the top of the stack
-            d->m_pixmapRequestsStack.append( request );
-        else
-        {
-            // insert in stack sorted by priority
-            sIt = d->m_pixmapRequestsStack.begin();
-            sEnd = d->m_pixmapRequestsStack.end();
-            while ( sIt != sEnd && (*sIt)->priority() > request->priority() )
-                ++sIt;
-            d->m_pixmapRequestsStack.insert( sIt, request );
-        }
+        // add request to the queue, replacing a previous one for the same page
+        delete d->m_pixmapRequestsQueue.enqueue( request );
     }
     d->m_pixmapRequestsMutex.unlock();
 
@@ -2949,6 +3905,9 @@ void DocumentPrivate::notifyAnnotationChanges( int page )
 {
     int flags = DocumentObserver::Annotations;
 
+    m_modifiedPages.insert( page );
+    journalPage( page );
+
     if ( m_annotationsNeedSaveAs )
         flags |= DocumentObserver::NeedSaveAs;
 
@@ -3173,10 +4132,19 @@ void Document::setViewport( const DocumentViewport & viewport, DocumentObserver
     }
     if ( viewport.pageNumber >= int(d->m_pagesVector.count()) )
     {
+        // go there once the generator has loaded the page
+        if ( d->m_loadMorePagesTimer && d->m_loadMorePagesTimer->isActive() )
+        {
+            d->m_pendingViewport = viewport;
+            d->m_pendingViewportFallbackPage = (*d->m_viewportIterator).pageNumber;
+        }
         //kDebug(OkularDebug) << "viewport out of document:" << viewport.toString();
         return;
     }
 
+    if ( PixmapMemoryBudget::self() )
+        PixmapMemoryBudget::self()->touch( d );
+
     // if already broadcasted, don't redo it
     DocumentViewport & oldViewport = *d->m_viewportIterator;
     // disabled by enrico on 2005-03-18 (less debug output)
@@ -3205,6 +4173,7 @@ void Document::setViewport( const DocumentViewport & viewport, DocumentObserver
     }
 
     const int currentViewportPage = (*d->m_viewportIterator).pageNumber;
+    d->journalViewport();
 
     const bool currentPageChanged = (oldPageNumber != currentViewportPage);
 
@@ -3236,6 +4205,7 @@ void Document::setPrevViewport()
 
         // restore previous viewport and notify it to observers
         --d->m_viewportIterator;
+        d->journalViewport();
         foreachObserver( notifyViewportChanged( true ) );
 
         const int currentViewportPage = (*d->m_viewportIterator).pageNumber;
@@ -3255,6 +4225,7 @@ void Document::setNextViewport()
 
         // restore next viewport and notify it to observers
         ++d->m_viewportIterator;
+        d->journalViewport();
         foreachObserver( notifyViewportChanged( true ) );
 
         const int currentViewportPage = (*d->m_viewportIterator).pageNumber;
@@ -3278,6 +4249,9 @@ void Document::searchText( int searchID, const QString & text, bool fromStart, Q
 {
     d->m_searchCancelled = false;
 
+    // the search goes through the whole document
+    loadAllPages();
+
     // safety checks: don't perform searches on empty or unsearchable docs
     if ( !d->m_generator || !d->m_generator->hasFeature( Generator::TextExtraction ) || d->m_pagesVector.isEmpty() )
     {
@@ -3324,6 +4298,8 @@ void Document::searchText( int searchID, const QString & text, bool fromStart, Q
     s->cachedNoDialogs = noDialogs;
     s->cachedColor = color;
     s->isCurrentlySearching = true;
+    s->useCandidatePages = false;
+    s->candidatePages.clear();
 
     // global data for search
     QSet< int > *pagesToNotify = new QSet< int >;
@@ -3342,6 +4318,26 @@ void Document::searchText( int searchID, const QString & text, bool fromStart, Q
     {
         QMap< Page *, QVector<RegularAreaRect *> > *pageMatches = new QMap< Page *, QVector<RegularAreaRect *> >;
 
+        if ( d->m_textSearchIndex && d->m_textSearchIndex->pageCount() == d->m_pagesVector.count() )
+        {
+            s->useCandidatePages = true;
+            s->candidatePages = d->searchCandidatePages( QStringList() << text, true );
+        }
+        else
+        {
+            // index the document for the next searches
+            d->startTextIndexing();
+        }
+
+        // extract the text of the pages to look at in the background
+        QVector< int > pages = s->candidatePages;
+        if ( !s->useCandidatePages )
+        {
+            for ( int i = 0; i < d->m_pagesVector.count(); ++i )
+                pages.append( i );
+        }
+        d->startSearchTextExtraction( pages );
+
         // search and highlight 'text' (as a solid phrase) on all pages
         QMetaObject::invokeMethod(this, "doContinueAllDocumentSearch", Qt::QueuedConnection, Q_ARG(void *, pagesToNotify), Q_ARG(void *, pageMatches), Q_ARG(int, 0), Q_ARG(int, searchID), Q_ARG(QString, text), Q_ARG(int, caseSensitivity), Q_ARG(QColor, color));
     }
@@ -3396,6 +4392,25 @@ void Document::searchText( int searchID, const QString & text, bool fromStart, Q
         QMap< Page *, QVector< QPair<RegularAreaRect *, QColor> > > *pageMatches = new QMap< Page *, QVector<QPair<RegularAreaRect *, QColor> > >;
         const QStringList words = text.split( ' ', QString::SkipEmptyParts );
 
+        if ( d->m_textSearchIndex && d->m_textSearchIndex->pageCount() == d->m_pagesVector.count() )
+        {
+            s->useCandidatePages = true;
+            s->candidatePages = d->searchCandidatePages( words, matchAll );
+        }
+        else
+        {
+            // index the document for the next searches
+            d->startTextIndexing();
+        }
+
+        QVector< int > pages = s->candidatePages;
+        if ( !s->useCandidatePages )
+        {
+            for ( int i = 0; i < d->m_pagesVector.count(); ++i )
+                pages.append( i );
+        }
+        d->startSearchTextExtraction( pages );
+
         // search and highlight every word in 'text' on all pages
         QMetaObject::invokeMethod(this, "doContinueGooglesDocumentSearch", Qt::QueuedConnection, Q_ARG(void *, pagesToNotify), Q_ARG(void *, pageMatches), Q_ARG(int, 0), Q_ARG(int, searchID), Q_ARG(QStringList, words), Q_ARG(int, caseSensitivity), Q_ARG(QColor, color), Q_ARG(bool, matchAll));
     }
@@ -3897,6 +4912,7 @@ bool Document::supportsPrintToFile() const
 
 bool Document::print( QPrinter &printer )
 {
+    loadAllPages();
     return d->m_generator ? d->m_generator->print( printer ) : false;
 }
 
@@ -4353,23 +5369,36 @@ void DocumentPrivate::requestDone( PixmapRequest * req )
         kDebug(OkularDebug) << "requestDone with generator not in READY state.";
 #endif
 
+    // an obsolete request: the page did not get its pixmap, unless the
+    // generator sets the pixmaps itself (e.g. CHM), then the pixmap is
+    // accounted and notified like any other
+    const bool tiled = req->observer() == m_tiledObserver && req->page()->d->tilesManager();
+    if ( req->shouldAbortRender() && ( tiled || !req->page()->hasPixmap( req->observer(), req->width(), req->height() ) ) )
+    {
+        // the tiles of the aborted request are not being generated anymore,
+        // otherwise the same request would be ignored when asked again
+        if ( tiled )
+            req->page()->d->tilesManager()->setRequest( NormalizedRect(), 0, 0 );
+
+        m_pixmapRequestsMutex.lock();
+        m_executingPixmapRequests.removeAll( req );
+        const bool hasPixmaps = !m_pixmapRequestsQueue.isEmpty();
+        m_pixmapRequestsMutex.unlock();
+        delete req;
+        if ( hasPixmaps )
+            sendGeneratorPixmapRequest();
+        return;
+    }
+
     // [MEM] 1.1 find and remove a previous entry for the same page and id
-    QLinkedList< AllocatedPixmap * >::iterator aIt = m_allocatedPixmaps.begin();
-    QLinkedList< AllocatedPixmap * >::iterator aEnd = m_allocatedPixmaps.end();
-    for ( ; aIt != aEnd; ++aIt )
-        if ( (*aIt)->page == req->pageNumber() && (*aIt)->observer == req->observer() )
-        {
-            AllocatedPixmap * p = *aIt;
-            m_allocatedPixmaps.erase( aIt );
-            m_allocatedPixmapsTotalMemory -= p->memory;
-            delete p;
-            break;
-        }
+    AllocatedPixmap * memoryPage = m_allocatedPixmaps.take( req->observer(), req->pageNumber() );
+    if ( memoryPage )
+        m_allocatedPixmapsTotalMemory -= memoryPage->memory;
 
     DocumentObserver *observer = req->observer();
     if ( m_observers.contains(observer) )
     {
-        // [MEM] 1.2 append memory allocation descriptor to the FIFO
+        // [MEM] 1.2 add memory allocation descriptor to the index
         qulonglong memoryBytes = 0;
         const TilesManager *tm = ( req->observer() == m_tiledObserver ) ? req->page()->d->tilesManager() : 0;
         if ( tm )
@@ -4377,17 +5406,30 @@ void DocumentPrivate::requestDone( PixmapRequest * req )
         else
             memoryBytes = 4 * req->width() * req->height();
 
-        AllocatedPixmap * memoryPage = new AllocatedPixmap( req->observer(), req->pageNumber(), memoryBytes );
-        m_allocatedPixmaps.append( memoryPage );
+        if ( memoryPage )
+        {
+            // regenerated pixmap: keep its access history
+            memoryPage->memory = memoryBytes;
+            m_allocatedPixmaps.insert( memoryPage );
+            m_allocatedPixmaps.touch( req->observer(), req->pageNumber() );
+        }
+        else
+        {
+            memoryPage = new AllocatedPixmap( req->observer(), req->pageNumber(), memoryBytes );
+            m_allocatedPixmaps.insert( memoryPage );
+        }
         m_allocatedPixmapsTotalMemory += memoryBytes;
 
         // 2. notify an observer that its pixmap changed
         observer->notifyPageChanged( req->pageNumber(), DocumentObserver::Pixmap );
     }
-#ifndef NDEBUG
     else
+    {
+        delete memoryPage;
+#ifndef NDEBUG
         kWarning(OkularDebug) << "Receiving a done request for the defunct observer" << observer;
 #endif
+    }
 
     // 3. delete request
     m_pixmapRequestsMutex.lock();
@@ -4397,12 +5439,22 @@ void DocumentPrivate::requestDone( PixmapRequest * req )
 
     // 4. start a new generation if some is pending
     m_pixmapRequestsMutex.lock();
-    bool hasPixmaps = !m_pixmapRequestsStack.isEmpty();
+    bool hasPixmaps = !m_pixmapRequestsQueue.isEmpty();
     m_pixmapRequestsMutex.unlock();
     if ( hasPixmaps )
         sendGeneratorPixmapRequest();
 }
 
+void DocumentPrivate::partialPixmapDone( PixmapRequest * req )
+{
+    if ( !m_generator || m_closingLoop )
+        return;
+
+    DocumentObserver *observer = req->observer();
+    if ( m_observers.contains( observer ) )
+        observer->notifyPageChanged( req->pageNumber(), DocumentObserver::Pixmap );
+}
+
 void DocumentPrivate::setPageBoundingBox( int page, const NormalizedRect& boundingBox )
 {
     Page * kp = m_pagesVector[ page ];
@@ -4487,6 +5539,7 @@ void DocumentPrivate::setRotationInternal( int r, bool notify )
     }
     // set the new rotation
     m_rotation = rotation;
+    journalGeneralInfo();
 
     if ( notify )
     {
@@ -4513,7 +5566,6 @@ void Document::setPageSize( const PageSize &size )
     for ( ; pIt != pEnd; ++pIt )
         (*pIt)->d->changeSize( size );
     // clear 'memory allocation' descriptors
-    qDeleteAll( d->m_allocatedPixmaps );
     d->m_allocatedPixmaps.clear();
     d->m_allocatedPixmapsTotalMemory = 0;
     // notify the generator that the current page size has changed
@@ -131,6 +131,41 @@ class OKULAR_EXPORT Document : public QObject
          */
         bool isOpened() const;
 
+        /**
+         * Frees the memory the document holds for its pages: the pixmaps of
+         * all the observers, the tiles and the text pages. The pending pixmap
+         * requests are dropped as well.
+         *
+         * The observers are not notified, so that the views of a document
+         * that is not shown do not request their pixmaps again right away;
+         * call wakeUp() when the document is about to be shown again.
+         *
+         * @since 0.19 (KDE 4.13)
+         */
+        void hibernate();
+
+        /**
+         * Makes the observers request again the pixmaps that were freed by
+         * hibernate(). Does nothing if the document is not hibernated.
+         *
+         * @since 0.19 (KDE 4.13)
+         */
+        void wakeUp();
+
+        /**
+         * Sets whether the next closeDocument() keeps the rendered pixmaps
+         * and the text pages of the pages, so that the next openDocument()
+         * of the same document gives them back to the pages that did not
+         * change. Used when reloading a document whose file changed.
+         *
+         * The generator tells which pages did not change by answering the
+         * "PageFingerprint" meta data for each page number: a page whose
+         * fingerprint is empty is always considered changed.
+         *
+         * @since 0.19 (KDE 4.13)
+         */
+        void setKeepPagesOnClose( bool keep );
+
         /**
          * Returns the meta data of the document or 0 if no meta data
          * are available.
@@ -202,6 +237,30 @@ class OKULAR_EXPORT Document : public QObject
          */
         uint pages() const;
 
+        /**
+         * Loads at once the pages of the document that the generator did not
+         * load yet, for the operations that need all of them, like choosing
+         * the pages to print.
+         *
+         * @see Generator::IncrementalLoading
+         * @since 0.19 (KDE 4.13)
+         */
+        void loadAllPages();
+
+        /**
+         * Loads in the background the annotations, form fields, transition
+         * and actions of all the pages, for the users that need them for the
+         * whole document, like the list of the reviews. Otherwise they are
+         * only loaded for a page when they are needed.
+         *
+         * The observers are notified with DocumentObserver::Metadata as the
+         * pages are loaded.
+         *
+         * @see Page::isMetadataLoaded()
+         * @since 0.19 (KDE 4.13)
+         */
+        void loadPagesMetadata();
+
         /**
          * Returns the url of the currently opened document.
          */
@@ -271,6 +330,11 @@ class OKULAR_EXPORT Document : public QObject
         /**
          * Returns the meta data for the given @p key and @p option or an empty variant
          * if the key doesn't exists.
+         *
+         * The "PixmapRequestQueueStatistics" key is answered by the document itself
+         * with a QVariantMap describing the pixmap request queue: the number of
+         * queued and executing requests, the maximum queue depth, and the average
+         * and maximum time (in milliseconds) the dispatched requests waited.
          */
         QVariant metaData( const QString & key, const QVariant & option = QVariant() ) const;
 
@@ -976,7 +1040,8 @@ class OKULAR_EXPORT Document : public QObject
 
         Q_DISABLE_COPY( Document )
 
-        Q_PRIVATE_SLOT( d, void saveDocumentInfo() const )
+        Q_PRIVATE_SLOT( d, void _o_flushDocumentInfoJournal() )
+        Q_PRIVATE_SLOT( d, void _o_compactDocumentInfo() )
         Q_PRIVATE_SLOT( d, void slotTimedMemoryCheck() )
         Q_PRIVATE_SLOT( d, void sendGeneratorPixmapRequest() )
         Q_PRIVATE_SLOT( d, void rotationFinished( int page, Okular::Page *okularPage ) )
@@ -985,6 +1050,10 @@ class OKULAR_EXPORT Document : public QObject
         Q_PRIVATE_SLOT( d, void slotGeneratorConfigChanged( const QString& ) )
         Q_PRIVATE_SLOT( d, void refreshPixmaps( int ) )
         Q_PRIVATE_SLOT( d, void _o_configChanged() )
+        Q_PRIVATE_SLOT( d, void _o_pagesMetadataLoaded() )
+        Q_PRIVATE_SLOT( d, void _o_loadMorePages() )
+        Q_PRIVATE_SLOT( d, void _o_loadPagesMetadata() )
+        Q_PRIVATE_SLOT( d, void _o_textIndexingFinished() )
 
         // search thread simulators
         Q_PRIVATE_SLOT( d, void doContinueDirectionMatchSearch(void *doContinueDirectionMatchSearchStruct) )
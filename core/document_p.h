@@ -19,6 +19,8 @@
 #include <QtCore/QMap>
 #include <QtCore/QMutex>
 #include <QtCore/QPointer>
+#include <QtCore/QSet>
+#include <QtCore/QThreadPool>
 
 #include <kcomponentdata.h>
 #include <kservicetypetrader.h>
@@ -26,13 +28,15 @@
 // local includes
 #include "fontinfo.h"
 #include "generator.h"
+#include "pixmapeviction_p.h"
+#include "pixmapmemorybudget_p.h"
+#include "pixmaprequestqueue_p.h"
 
 class QUndoStack;
 class QEventLoop;
 class QTimer;
 class KTemporaryFile;
 
-struct AllocatedPixmap;
 struct ArchiveData;
 struct RunningSearch;
 
@@ -64,6 +68,10 @@ struct GeneratorInfo
 namespace Okular {
 
 class FontExtractionThread;
+class ReloadedPage;
+class TextExtractionJob;
+class TextIndexingThread;
+class TextSearchIndex;
 
 struct DoContinueDirectionMatchSearchStruct
 {
@@ -96,6 +104,9 @@ class DocumentPrivate
             m_bookmarkManager( 0 ),
             m_memCheckTimer( 0 ),
             m_saveBookmarksTimer( 0 ),
+            m_journalTimer( 0 ),
+            m_loadMorePagesTimer( 0 ),
+            m_loadMetadataTimer( 0 ),
             m_generator( 0 ),
             m_generatorsLoaded( false ),
             m_pageController( 0 ),
@@ -104,10 +115,23 @@ class DocumentPrivate
             m_archiveData( 0 ),
             m_fontsCached( false ),
             m_documentInfo( 0 ),
+            m_textSearchIndex( 0 ),
+            m_textIndexingThread( 0 ),
+            m_searchTextExtraction( 0 ),
             m_annotationEditingEnabled ( true ),
-            m_annotationBeingMoved( false )
+            m_annotationBeingMoved( false ),
+            m_hibernated( false ),
+            m_keepPagesOnClose( false ),
+            m_nextMetadataPage( 0 ),
+            m_loadAllPagesMetadata( false ),
+            m_pendingViewportFallbackPage( -1 ),
+            m_journalGeneralInfo( false )
         {
+            // one compaction of the document info at a time
+            m_documentInfoWriter.setMaxThreadCount( 1 );
             calculateMaxTextPages();
+            updatePixmapEvictionPolicy();
+            updateDiskCacheSettings();
         }
 
         // private methods
@@ -117,12 +141,34 @@ class DocumentPrivate
         qulonglong calculateMemoryToFree();
         void cleanupPixmapMemory();
         void cleanupPixmapMemory( qulonglong memoryToFree );
+        qulonglong evictPixmaps( qulonglong memoryToFree );
         AllocatedPixmap * searchLowestPriorityPixmap( bool unloadableOnly = false, bool thenRemoveIt = false, DocumentObserver *observer = 0 /* any */ );
         void calculateMaxTextPages();
+        void updatePixmapEvictionPolicy();
+        void updateDiskCacheSettings();
+        QByteArray diskCacheKey( PixmapRequest *request ) const;
+        PixmapRequest *previewRequest( PixmapRequest *request ) const;
+        void pixmapMemoryChanged( DocumentObserver *observer, int page, qlonglong memoryDiff );
+        void keepReloadedPages();
+        void restoreReloadedPages();
+        void clearReloadedPages();
+        void loadTextSearchIndex();
+        void startTextIndexing();
+        QString textSearchIndexFileName() const;
+        QVector< int > searchCandidatePages( const QStringList &texts, bool matchAll ) const;
+        void startSearchTextExtraction( const QVector< int > &pageNumbers );
+        void requestSearchTextPage( Page *page );
         qulonglong getTotalMemory();
         qulonglong getFreeMemory( qulonglong *freeSwap = 0 );
         void loadDocumentInfo();
         void loadDocumentInfo( const QString &fileName );
+        QDomDocument documentInfo() const;
+        void saveDocumentInfo() const;
+        void saveGeneralInfo( QDomElement &generalInfo, QDomDocument &doc ) const;
+        QString journalFileName() const;
+        void journalPage( int page );
+        void journalGeneralInfo();
+        void journalViewport();
         void loadViewsInfo( View *view, const QDomElement &e );
         void saveViewsInfo( View *view, QDomElement &e ) const;
         QString giveAbsolutePath( const QString & fileName ) const;
@@ -143,6 +189,10 @@ class DocumentPrivate
         bool canModifyExternalAnnotations() const;
         bool canRemoveExternalAnnotations() const;
         void warnLimitedAnnotSupport();
+        bool isPixmapRequestExecuting( DocumentObserver *observer, int pageNumber ) const;
+        void abortPixmapRequests( DocumentObserver *observer, const QSet< int > &keptPages = QSet< int >() );
+        void loadPageMetadata( Page *page );
+        void loadMorePages( bool allPages );
 
         // Methods that implement functionality needed by undo commands
         void performAddPageAnnotation( int page, Annotation *annotation );
@@ -151,7 +201,8 @@ class DocumentPrivate
         void performSetAnnotationContents( const QString & newContents, Annotation *annot, int pageNumber );
 
         // private slots
-        void saveDocumentInfo() const;
+        void _o_flushDocumentInfoJournal();
+        void _o_compactDocumentInfo();
         void slotTimedMemoryCheck();
         void sendGeneratorPixmapRequest();
         void rotationFinished( int page, Okular::Page *okularPage );
@@ -160,6 +211,10 @@ class DocumentPrivate
         void slotGeneratorConfigChanged( const QString& );
         void refreshPixmaps( int );
         void _o_configChanged();
+        void _o_pagesMetadataLoaded();
+        void _o_loadMorePages();
+        void _o_loadPagesMetadata();
+        void _o_textIndexingFinished();
         void doContinueDirectionMatchSearch(void *doContinueDirectionMatchSearchStruct);
         void doContinueAllDocumentSearch(void *pagesToNotifySet, void *pageMatchesMap, int currentPage, int searchID, const QString & text, int caseSensitivity, const QColor & color);
         void doContinueGooglesDocumentSearch(void *pagesToNotifySet, void *pageMatchesMap, int currentPage, int searchID, const QStringList & words, int caseSensitivity, const QColor & color, bool matchAll);
@@ -172,6 +227,11 @@ class DocumentPrivate
          * the pixmap generation @p request.
          */
         void requestDone( PixmapRequest * request );
+        /**
+         * This method is used by the generators to signal that a part of
+         * the pixmap of @p request has been set to the page.
+         */
+        void partialPixmapDone( PixmapRequest * request );
         void textGenerationDone( Page *page );
         /**
          * Sets the bounding box of the given @p page (in terms of upright orientation, i.e., Rotation0).
@@ -219,10 +279,10 @@ class DocumentPrivate
         // FIXME This is a hack, we need to support
         // multiple tiled observers, but for the moment we only support one
         DocumentObserver *m_tiledObserver;
-        QLinkedList< PixmapRequest * > m_pixmapRequestsStack;
+        PixmapRequestQueue m_pixmapRequestsQueue;
         QLinkedList< PixmapRequest * > m_executingPixmapRequests;
         QMutex m_pixmapRequestsMutex;
-        QLinkedList< AllocatedPixmap * > m_allocatedPixmaps;
+        PixmapEvictionIndex m_allocatedPixmaps;
         qulonglong m_allocatedPixmapsTotalMemory;
         QList< int > m_allocatedTextPagesFifo;
         int m_maxAllocatedTextPages;
@@ -247,6 +307,9 @@ class DocumentPrivate
         // timers (memory checking / info saver)
         QTimer *m_memCheckTimer;
         QTimer *m_saveBookmarksTimer;
+        QTimer *m_journalTimer;
+        QTimer *m_loadMorePagesTimer;
+        QTimer *m_loadMetadataTimer;
 
         QHash<QString, GeneratorInfo> m_loadedGenerators;
         Generator * m_generator;
@@ -271,15 +334,55 @@ class DocumentPrivate
         DocumentInfo *m_documentInfo;
         FontInfo::List m_fontsCache;
 
+        // the index of the words of the pages, and the thread building it
+        TextSearchIndex *m_textSearchIndex;
+        TextIndexingThread *m_textIndexingThread;
+        // the text pages extracted for the running whole-document search
+        TextExtractionJob *m_searchTextExtraction;
+
         QSet< View * > m_views;
 
         bool m_annotationEditingEnabled;
         bool m_annotationsNeedSaveAs;
         bool m_annotationBeingMoved; // is an annotation currently being moved?
+
+        bool m_hibernated; // were the pixmaps freed by hibernate()?
+
+        // the rendered data kept by closeDocument() for the pages that do
+        // not change when the document is opened again, by page fingerprint
+        bool m_keepPagesOnClose;
+        QHash< QByteArray, ReloadedPage * > m_reloadedPages;
+        KUrl m_reloadedPagesUrl;
+        QString m_reloadedPagesGenerator;
+
+        // pages whose metadata was loaded, to be notified to the observers,
+        // the first page whose metadata may still need to be loaded, and
+        // whether an user of the document asked for the metadata of all pages
+        QList< int > m_pagesWithLoadedMetadata;
+        int m_nextMetadataPage;
+        bool m_loadAllPagesMetadata;
+
+        // pages still being loaded by the generator: the saved data of the
+        // pages not loaded yet, and the viewport to go to once its page is
+        // loaded, if the page shown meanwhile was not changed
+        QHash< int, QDomElement > m_pendingPageInfo;
+        DocumentViewport m_pendingViewport;
+        int m_pendingViewportFallbackPage;
+
+        // disk cache stuff: the identifier of the document file, and the
+        // pages that do not look like in the file anymore
+        QByteArray m_diskCacheFingerprint;
+        QSet< int > m_modifiedPages;
         bool m_showWarningLimitedAnnotSupport;
 
         QUndoStack *m_undoStack;
         QDomNode m_prevPropsOfAnnotBeingModified;
+
+        // the document info changes not written to the journal yet, and the
+        // thread writing the compacted document info file
+        QSet< int > m_journalPages;
+        bool m_journalGeneralInfo;
+        QThreadPool m_documentInfoWriter;
 };
 
 }
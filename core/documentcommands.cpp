@@ -367,6 +367,7 @@ void EditFormTextCommand::undo()
 {
     moveViewportIfBoundingRectNotFullyVisible( m_form->rect(), m_docPriv, m_pageNumber );
     m_form->setText( m_prevContents );
+    m_docPriv->journalPage( m_pageNumber );
     m_docPriv->m_parent->formTextChangedByUndoRedo( m_pageNumber, m_form, m_prevContents, m_prevCursorPos, m_prevAnchorPos );
 }
 
@@ -374,6 +375,7 @@ void EditFormTextCommand::redo()
 {
     moveViewportIfBoundingRectNotFullyVisible( m_form->rect(), m_docPriv, m_pageNumber );
     m_form->setText( m_newContents  );
+    m_docPriv->journalPage( m_pageNumber );
     m_docPriv->m_parent->formTextChangedByUndoRedo( m_pageNumber, m_form, m_newContents, m_newCursorPos, m_newCursorPos );
 }
 
@@ -414,6 +416,7 @@ void EditFormListCommand::undo()
 {
     moveViewportIfBoundingRectNotFullyVisible( m_form->rect(), m_docPriv, m_pageNumber );
     m_form->setCurrentChoices( m_prevChoices );
+    m_docPriv->journalPage( m_pageNumber );
     m_docPriv->m_parent->formListChangedByUndoRedo( m_pageNumber, m_form, m_prevChoices );
 }
 
@@ -421,6 +424,7 @@ void EditFormListCommand::redo()
 {
     moveViewportIfBoundingRectNotFullyVisible( m_form->rect(), m_docPriv, m_pageNumber );
     m_form->setCurrentChoices( m_newChoices );
+    m_docPriv->journalPage( m_pageNumber );
     m_docPriv->m_parent->formListChangedByUndoRedo( m_pageNumber, m_form, m_newChoices );
 }
 
@@ -467,6 +471,7 @@ void EditFormComboCommand::undo()
         m_form->setEditChoice( m_prevContents );
     }
     moveViewportIfBoundingRectNotFullyVisible( m_form->rect(), m_docPriv, m_pageNumber );
+    m_docPriv->journalPage( m_pageNumber );
     m_docPriv->m_parent->formComboChangedByUndoRedo( m_pageNumber, m_form, m_prevContents, m_prevCursorPos, m_prevAnchorPos );
 }
 
@@ -481,6 +486,7 @@ void EditFormComboCommand::redo()
         m_form->setEditChoice( m_newContents );
     }
     moveViewportIfBoundingRectNotFullyVisible( m_form->rect(), m_docPriv, m_pageNumber );
+    m_docPriv->journalPage( m_pageNumber );
     m_docPriv->m_parent->formComboChangedByUndoRedo( m_pageNumber, m_form, m_newContents, m_newCursorPos, m_newCursorPos );
 }
 
@@ -537,6 +543,7 @@ void EditFormButtonsCommand::undo()
 
     Okular::NormalizedRect boundingRect = buildBoundingRectangleForButtons( m_formButtons );
     moveViewportIfBoundingRectNotFullyVisible( boundingRect, m_docPriv, m_pageNumber );
+    m_docPriv->journalPage( m_pageNumber );
     m_docPriv->m_parent->formButtonsChangedByUndoRedo( m_pageNumber, m_formButtons );
 }
 
@@ -552,6 +559,7 @@ void EditFormButtonsCommand::redo()
 
     Okular::NormalizedRect boundingRect = buildBoundingRectangleForButtons( m_formButtons );
     moveViewportIfBoundingRectNotFullyVisible( boundingRect, m_docPriv, m_pageNumber );
+    m_docPriv->journalPage( m_pageNumber );
     m_docPriv->m_parent->formButtonsChangedByUndoRedo( m_pageNumber, m_formButtons );
 }
 
@@ -0,0 +1,113 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "documentinfojournal_p.h"
+
+#include <QtCore/QFile>
+#include <QtXml/QDomDocument>
+#include <QtXml/QDomElement>
+
+using namespace Okular;
+
+static const char JournalHeader[] = "okular-docdata-journal 1\n";
+
+QByteArray DocumentInfoJournal::record( const QDomElement &element )
+{
+    QDomDocument doc;
+    doc.appendChild( doc.importNode( element, true ) );
+    const QByteArray xml = doc.toByteArray( -1 );
+
+    // the size line, the element, and a newline to keep the file readable
+    QByteArray result = QByteArray::number( xml.size() );
+    result += '\n';
+    result += xml;
+    result += '\n';
+    return result;
+}
+
+bool DocumentInfoJournal::append( const QString &fileName, const QByteArray &records )
+{
+    QFile file( fileName );
+    if ( !file.open( QIODevice::WriteOnly | QIODevice::Append ) )
+        return false;
+
+    if ( file.size() == 0 && file.write( JournalHeader ) < 0 )
+        return false;
+
+    if ( file.write( records ) != records.size() )
+        return false;
+
+    return file.flush();
+}
+
+// replaces the child of @p parent with the same tag (and page number) as @p element
+static void replaceElement( QDomElement &parent, const QDomElement &element )
+{
+    const bool isPage = element.tagName() == "page";
+    for ( QDomElement e = parent.firstChildElement( element.tagName() ); !e.isNull(); e = e.nextSiblingElement( element.tagName() ) )
+    {
+        if ( !isPage || e.attribute( "number" ) == element.attribute( "number" ) )
+        {
+            parent.replaceChild( element, e );
+            return;
+        }
+    }
+    parent.appendChild( element );
+}
+
+bool DocumentInfoJournal::replay( const QString &fileName, QDomDocument &document )
+{
+    QFile file( fileName );
+    if ( !file.open( QIODevice::ReadOnly ) )
+        return false;
+
+    if ( file.readLine() != JournalHeader )
+        return false;
+
+    QDomElement root = document.documentElement();
+    if ( root.isNull() )
+    {
+        root = document.createElement( "documentInfo" );
+        document.appendChild( root );
+    }
+
+    while ( !file.atEnd() )
+    {
+        bool ok = false;
+        const qint64 size = file.readLine().trimmed().toLongLong( &ok );
+        if ( !ok || size <= 0 )
+            break;
+
+        // a record cut short, the end of the journal was not written
+        const QByteArray xml = file.read( size );
+        if ( xml.size() != size || file.read( 1 ) != "\n" )
+            break;
+
+        QDomDocument recordDoc;
+        if ( !recordDoc.setContent( xml ) )
+            break;
+
+        const QDomElement element = document.importNode( recordDoc.documentElement(), true ).toElement();
+        if ( element.tagName() == "page" )
+        {
+            QDomElement pageList = root.firstChildElement( "pageList" );
+            if ( pageList.isNull() )
+                pageList = root.insertBefore( document.createElement( "pageList" ), root.firstChild() ).toElement();
+            replaceElement( pageList, element );
+        }
+        else if ( element.tagName() == "generalInfo" )
+        {
+            replaceElement( root, element );
+        }
+    }
+
+    return true;
+}
+
+/* kate: replace-tabs on; indent-width 4; */
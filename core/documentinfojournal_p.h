@@ -0,0 +1,58 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_DOCUMENTINFOJOURNAL_P_H_
+#define _OKULAR_DOCUMENTINFOJOURNAL_P_H_
+
+#include <QtCore/QByteArray>
+#include <QtCore/QString>
+
+class QDomDocument;
+class QDomElement;
+
+namespace Okular {
+
+/**
+ * @short Append-only journal of the changes to the document info file.
+ *
+ * Each record holds the new state of a part of the document info: either
+ * a \<page\> element, with the whole local contents of the page (an empty
+ * one if there is nothing left to keep), or the \<generalInfo\> element.
+ * Replaying the records over the document info replaces those parts, so
+ * replaying a record more than once does no harm.
+ *
+ * Each record is preceded by its size, a record cut by a crash is ignored.
+ */
+class DocumentInfoJournal
+{
+    public:
+        /**
+         * Returns the record of @p element, a \<page\> or \<generalInfo\>
+         * element.
+         */
+        static QByteArray record( const QDomElement &element );
+
+        /**
+         * Appends @p records to the journal @p fileName, creating it if
+         * needed.
+         */
+        static bool append( const QString &fileName, const QByteArray &records );
+
+        /**
+         * Applies the records of the journal @p fileName to @p document,
+         * which may be empty. Returns whether the journal was read.
+         */
+        static bool replay( const QString &fileName, QDomDocument &document );
+};
+
+}
+
+#endif
+
+/* kate: replace-tabs on; indent-width 4; */
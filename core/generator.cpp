@@ -22,6 +22,8 @@
 #include "document.h"
 #include "document_p.h"
 #include "page.h"
+#include "pixmapdiskcache_p.h"
+#include "settings_core.h"
 #include "textpage.h"
 #include "utils.h"
 
@@ -29,7 +31,7 @@ using namespace Okular;
 
 GeneratorPrivate::GeneratorPrivate()
     : m_document( 0 ),
-      mPixmapGenerationThread( 0 ), mTextPageGenerationThread( 0 ),
+      mPixmapGenerationsRunning( 0 ), mTextPageGenerationThread( 0 ),
       m_mutex( 0 ), m_threadsMutex( 0 ), mPixmapReady( true ), mTextPageReady( true ),
       m_closing( false ), m_closingLoop( 0 ),
       m_dpi(72.0, 72.0)
@@ -38,10 +40,10 @@ GeneratorPrivate::GeneratorPrivate()
 
 GeneratorPrivate::~GeneratorPrivate()
 {
-    if ( mPixmapGenerationThread )
-        mPixmapGenerationThread->wait();
+    foreach ( PixmapGenerationThread *thread, mPixmapGenerationThreads )
+        thread->wait();
 
-    delete mPixmapGenerationThread;
+    qDeleteAll( mPixmapGenerationThreads );
 
     if ( mTextPageGenerationThread )
         mTextPageGenerationThread->wait();
@@ -54,16 +56,27 @@ GeneratorPrivate::~GeneratorPrivate()
 
 PixmapGenerationThread* GeneratorPrivate::pixmapGenerationThread()
 {
-    if ( mPixmapGenerationThread )
-        return mPixmapGenerationThread;
+    // reuse an idle thread, if any
+    foreach ( PixmapGenerationThread *thread, mPixmapGenerationThreads )
+    {
+        if ( !thread->request() )
+            return thread;
+    }
+
+    if ( mPixmapGenerationThreads.count() >= maxPixmapGenerationThreads() )
+        return 0;
 
     Q_Q( Generator );
-    mPixmapGenerationThread = new PixmapGenerationThread( q );
-    QObject::connect( mPixmapGenerationThread, SIGNAL(finished()),
+    PixmapGenerationThread *thread = new PixmapGenerationThread( q );
+    QObject::connect( thread, SIGNAL(finished()),
                       q, SLOT(pixmapGenerationFinished()),
                       Qt::QueuedConnection );
+    QObject::connect( thread, SIGNAL(partialImageReady()),
+                      q, SLOT(pixmapGenerationUpdated()),
+                      Qt::QueuedConnection );
+    mPixmapGenerationThreads.append( thread );
 
-    return mPixmapGenerationThread;
+    return thread;
 }
 
 TextPageGenerationThread* GeneratorPrivate::textPageGenerationThread()
@@ -83,16 +96,21 @@ TextPageGenerationThread* GeneratorPrivate::textPageGenerationThread()
 void GeneratorPrivate::pixmapGenerationFinished()
 {
     Q_Q( Generator );
-    PixmapRequest *request = mPixmapGenerationThread->request();
-    mPixmapGenerationThread->endGeneration();
+    PixmapGenerationThread *thread = qobject_cast< PixmapGenerationThread * >( q->sender() );
+    if ( !thread )
+        return;
+
+    PixmapRequest *request = thread->request();
+    thread->endGeneration();
 
     QMutexLocker locker( threadsLock() );
+    --mPixmapGenerationsRunning;
     mPixmapReady = true;
 
     if ( m_closing )
     {
         delete request;
-        if ( mTextPageReady )
+        if ( mTextPageReady && mPixmapGenerationsRunning == 0 )
         {
             locker.unlock();
             m_closingLoop->quit();
@@ -100,15 +118,39 @@ void GeneratorPrivate::pixmapGenerationFinished()
         return;
     }
 
-    const QImage& img = mPixmapGenerationThread->image();
-    request->page()->setPixmap( request->observer(), new QPixmap( QPixmap::fromImage( img ) ), request->normalizedRect() );
-    const int pageNumber = request->page()->number();
+    // the image of an obsolete request may be unfinished, the document
+    // just drops the request
+    if ( !request->shouldAbortRender() )
+    {
+        const QImage& img = thread->image();
+        request->page()->setPixmap( request->observer(), new QPixmap( QPixmap::fromImage( img ) ), request->normalizedRect() );
+        const int pageNumber = request->page()->number();
 
-    if ( mPixmapGenerationThread->calcBoundingBox() )
-        q->updatePageBoundingBox( pageNumber, mPixmapGenerationThread->boundingBox() );
+        if ( thread->calcBoundingBox() )
+            q->updatePageBoundingBox( pageNumber, thread->boundingBox() );
+    }
     q->signalPixmapRequestDone( request );
 }
 
+void GeneratorPrivate::pixmapGenerationUpdated()
+{
+    Q_Q( Generator );
+    PixmapGenerationThread *thread = qobject_cast< PixmapGenerationThread * >( q->sender() );
+    // the request is still running: finished() comes after this
+    if ( !thread || !thread->request() || m_closing || thread->request()->shouldAbortRender() )
+        return;
+
+    const QImage img = thread->takePartialImage();
+    if ( img.isNull() )
+        return;
+
+    // the final pixmap will replace it, the memory is accounted then
+    PixmapRequest *request = thread->request();
+    request->page()->setPixmap( request->observer(), new QPixmap( QPixmap::fromImage( img ) ), request->normalizedRect() );
+    if ( m_document )
+        m_document->partialPixmapDone( request );
+}
+
 void GeneratorPrivate::textpageGenerationFinished()
 {
     Q_Q( Generator );
@@ -121,7 +163,7 @@ void GeneratorPrivate::textpageGenerationFinished()
     if ( m_closing )
     {
         delete mTextPageGenerationThread->textPage();
-        if ( mPixmapReady )
+        if ( mPixmapGenerationsRunning == 0 )
         {
             locker.unlock();
             m_closingLoop->quit();
@@ -137,6 +179,18 @@ void GeneratorPrivate::textpageGenerationFinished()
     }
 }
 
+int GeneratorPrivate::maxPixmapGenerationThreads() const
+{
+    // generators that are not reentrant are served by one thread only
+    if ( !m_features.contains( Generator::ParallelRendering ) )
+        return 1;
+
+    int threads = SettingsCore::renderThreads();
+    if ( threads <= 0 )
+        threads = QThread::idealThreadCount();
+    return qMax( 1, threads );
+}
+
 QMutex* GeneratorPrivate::threadsLock()
 {
     if ( !m_threadsMutex )
@@ -154,6 +208,24 @@ QImage GeneratorPrivate::image( PixmapRequest * )
     return QImage();
 }
 
+QImage GeneratorPrivate::cachedImage( PixmapRequest *request )
+{
+    Q_Q( Generator );
+    PixmapDiskCache *cache = PixmapDiskCache::self();
+    const QByteArray key = request->d->mDiskCacheKey;
+    if ( key.isEmpty() || !cache )
+        return q->image( request );
+
+    QImage img = cache->find( key );
+    if ( img.isNull() || img.width() != request->width() || img.height() != request->height() )
+    {
+        img = q->image( request );
+        if ( !request->shouldAbortRender() )
+            cache->insert( key, img );
+    }
+    return img;
+}
+
 
 Generator::Generator( QObject *parent, const QVariantList &args )
     : QObject( parent ), d_ptr( new GeneratorPrivate() )
@@ -179,6 +251,11 @@ bool Generator::loadDocumentFromData( const QByteArray &, QVector< Page * > & )
     return false;
 }
 
+bool Generator::loadMorePages( QVector< Page * > & )
+{
+    return false;
+}
+
 bool Generator::closeDocument()
 {
     Q_D( Generator );
@@ -186,7 +263,7 @@ bool Generator::closeDocument()
     d->m_closing = true;
 
     d->threadsLock()->lock();
-    if ( !( d->mPixmapReady && d->mTextPageReady ) )
+    if ( !( d->mPixmapGenerationsRunning == 0 && d->mTextPageReady ) )
     {
         QEventLoop loop;
         d->m_closingLoop = &loop;
@@ -220,11 +297,17 @@ void Generator::generatePixmap( PixmapRequest *request )
     Q_D( Generator );
     d->mPixmapReady = false;
 
-    const bool calcBoundingBox = !request->isTile() && !request->page()->isBoundingBoxKnown();
+    // a preview is too small for an accurate bounding box
+    const bool calcBoundingBox = !request->isTile() && !request->isPreview() && !request->page()->isBoundingBoxKnown();
 
     if ( request->asynchronous() && hasFeature( Threaded ) )
     {
-        d->pixmapGenerationThread()->startGeneration( request, calcBoundingBox );
+        PixmapGenerationThread *thread = d->pixmapGenerationThread();
+        Q_ASSERT( thread );
+        ++d->mPixmapGenerationsRunning;
+        thread->startGeneration( request, calcBoundingBox );
+        // accept more requests as long as there are render threads left
+        d->mPixmapReady = d->mPixmapGenerationsRunning < d->maxPixmapGenerationThreads();
 
         /**
          * We create the text page for every page that is visible to the
@@ -238,7 +321,7 @@ void Generator::generatePixmap( PixmapRequest *request )
         return;
     }
 
-    const QImage& img = image( request );
+    const QImage& img = d->cachedImage( request );
     request->page()->setPixmap( request->observer(), new QPixmap( QPixmap::fromImage( img ) ), request->normalizedRect() );
     const int pageNumber = request->page()->number();
 
@@ -273,6 +356,10 @@ TextPage* Generator::textPage( Page* )
     return 0;
 }
 
+void Generator::loadPageMetadata( Page* )
+{
+}
+
 const DocumentInfo * Generator::generateDocumentInfo()
 {
     return 0;
@@ -368,6 +455,14 @@ void Generator::signalTextGenerationDone( Page *page, TextPage *textPage )
         delete textPage;
 }
 
+void Generator::signalPartialPixmap( PixmapRequest *request, const QImage &image )
+{
+    // the render threads pass the image to the main one themselves
+    PixmapGenerationThread *thread = qobject_cast< PixmapGenerationThread * >( QThread::currentThread() );
+    if ( thread && thread->request() == request && !image.isNull() )
+        thread->setPartialImage( image );
+}
+
 const Document * Generator::document() const
 {
     Q_D( const Generator );
@@ -446,6 +541,8 @@ PixmapRequest::PixmapRequest( DocumentObserver *observer, int pageNumber, int wi
     d->mFeatures = features;
     d->mForce = false;
     d->mTile = false;
+    d->mPreview = false;
+    d->mShouldAbortRender = 0;
     d->mNormalizedRect = NormalizedRect();
 }
 
@@ -489,6 +586,21 @@ bool PixmapRequest::preload() const
     return d->mFeatures & Preload;
 }
 
+bool PixmapRequest::progressive() const
+{
+    return d->mFeatures & Progressive;
+}
+
+bool PixmapRequest::isPreview() const
+{
+    return d->mPreview;
+}
+
+bool PixmapRequest::shouldAbortRender() const
+{
+    return d->mShouldAbortRender != 0;
+}
+
 Page* PixmapRequest::page() const
 {
     return d->mPage;
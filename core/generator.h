@@ -188,6 +188,8 @@ class OKULAR_EXPORT Generator : public QObject
     /// @cond PRIVATE
     friend class PixmapGenerationThread;
     friend class TextPageGenerationThread;
+    friend class TextExtractionJob;
+    friend class TextIndexingThread;
     /// @endcond
 
     Q_OBJECT
@@ -207,7 +209,12 @@ class OKULAR_EXPORT Generator : public QObject
             PrintNative,       ///< Whether the Generator supports native cross-platform printing (QPainter-based).
             PrintPostscript,   ///< Whether the Generator supports postscript-based file printing.
             PrintToFile,       ///< Whether the Generator supports export to PDF & PS through the Print Dialog
-            TiledRendering     ///< Whether the Generator can render tiles @since 0.16 (KDE 4.10)
+            TiledRendering,    ///< Whether the Generator can render tiles @since 0.16 (KDE 4.10)
+            ParallelRendering, ///< Whether image() can be called for several requests at the same time from different threads @since 0.19 (KDE 4.13)
+            IncrementalLoading, ///< Whether loadDocument() can return after loading only the first pages, the others being loaded with loadMorePages() @since 0.19 (KDE 4.13)
+            CachedRendering,   ///< Whether image() only depends on the page, the requested size and the render settings, so that the rendered pages can be kept in the disk cache @since 0.19 (KDE 4.13)
+            ParallelTextExtraction, ///< Whether textPage() can be called for several pages at the same time from different threads @since 0.19 (KDE 4.13)
+            ProgressiveRendering ///< Whether a small preview of a page is rendered much faster than the page, so that it is worth showing first (see PixmapRequest::isPreview()) @since 0.19 (KDE 4.13)
         };
 
         /**
@@ -238,6 +245,21 @@ class OKULAR_EXPORT Generator : public QObject
          */
         virtual bool loadDocumentFromData( const QByteArray & fileData, QVector< Page * > & pagesVector );
 
+        /**
+         * Appends the next pages of the document to @p pagesVector.
+         *
+         * This method is called repeatedly from the event loop after the
+         * document has been opened, as long as it returns true, so it should
+         * only load a few pages each time. Pixmaps may be requested for the
+         * pages already loaded in the meantime.
+         *
+         * @note the Generator has to have the feature @ref IncrementalLoading enabled
+         *
+         * @returns whether there are more pages to load.
+         * @since 0.19 (KDE 4.13)
+         */
+        virtual bool loadMorePages( QVector< Page * > & pagesVector );
+
         /**
          * This method is called when the document is closed and not used
          * any longer.
@@ -276,6 +298,18 @@ class OKULAR_EXPORT Generator : public QObject
          */
         virtual void generateTextPage( Page * page );
 
+        /**
+         * This method is called to load the annotations, form fields,
+         * transition and actions of the given @p page, the first time they
+         * are needed, if the generator created the page with
+         * Page::setMetadataLoaded( false ).
+         *
+         * It is called from the main thread.
+         *
+         * @since 0.19 (KDE 4.13)
+         */
+        virtual void loadPageMetadata( Page * page );
+
         /**
          * Returns the general information object of the document or 0 if
          * no information are available.
@@ -430,6 +464,16 @@ class OKULAR_EXPORT Generator : public QObject
          */
         void signalTextGenerationDone( Page *page, TextPage *textPage );
 
+        /**
+         * This method can be called from image() to show @p image, a part
+         * of the rendering of @p request done so far, while the rendering
+         * goes on. It has an effect only for the requests rendered in a
+         * thread.
+         *
+         * @since 0.19 (KDE 4.13)
+         */
+        void signalPartialPixmap( PixmapRequest *request, const QImage &image );
+
         /**
          * This method is called when the document is closed and not used
          * any longer.
@@ -443,7 +487,8 @@ class OKULAR_EXPORT Generator : public QObject
          * the passed pixmap @p request.
          *
          * @warning this method may be executed in its own separated thread if the
-         * @ref Threaded is enabled!
+         * @ref Threaded is enabled! If @ref ParallelRendering is enabled too, it
+         * may be executed concurrently by several threads.
          */
         virtual QImage image( PixmapRequest *page );
 
@@ -528,6 +573,7 @@ class OKULAR_EXPORT Generator : public QObject
         Q_DISABLE_COPY( Generator )
 
         Q_PRIVATE_SLOT( d_func(), void pixmapGenerationFinished() )
+        Q_PRIVATE_SLOT( d_func(), void pixmapGenerationUpdated() )
         Q_PRIVATE_SLOT( d_func(), void textpageGenerationFinished() )
 };
 
@@ -538,13 +584,15 @@ class OKULAR_EXPORT PixmapRequest
 {
     friend class Document;
     friend class DocumentPrivate;
+    friend class GeneratorPrivate;
 
     public:
         enum PixmapRequestFeature
         {
             NoFeature = 0,
             Asynchronous = 1,
-            Preload = 2
+            Preload = 2,
+            Progressive = 4 ///< Show a quick preview of the page first if there is nothing to show for it and the generator has the ProgressiveRendering feature @since 0.19 (KDE 4.13)
         };
         Q_DECLARE_FLAGS( PixmapRequestFeatures, PixmapRequestFeature )
 
@@ -606,6 +654,34 @@ class OKULAR_EXPORT PixmapRequest
          */
         bool preload() const;
 
+        /**
+         * Returns whether a quick low resolution preview of the page is
+         * rendered first, when the observer has nothing to show for it yet.
+         *
+         * @since 0.19 (KDE 4.13)
+         */
+        bool progressive() const;
+
+        /**
+         * Returns whether the request is the quick preview of a progressive
+         * request, which the generator may render with lower quality
+         * settings.
+         *
+         * @since 0.19 (KDE 4.13)
+         */
+        bool isPreview() const;
+
+        /**
+         * Returns whether the request has become obsolete, for example
+         * because the user moved far away from its page, while it was being
+         * rendered. Generators rendering in several steps can check it
+         * from time to time, and return from image() early if it is set:
+         * the image returned is then dropped.
+         *
+         * @since 0.19 (KDE 4.13)
+         */
+        bool shouldAbortRender() const;
+
         /**
          * Returns a pointer to the page where the pixmap shall be generated for.
          */
@@ -13,6 +13,8 @@
 
 #include "fontinfo.h"
 #include "generator.h"
+#include "textpage.h"
+#include "textsearchindex_p.h"
 #include "utils.h"
 
 using namespace Okular;
@@ -55,14 +57,35 @@ NormalizedRect PixmapGenerationThread::boundingBox() const
     return mBoundingBox;
 }
 
+void PixmapGenerationThread::setPartialImage( const QImage &image )
+{
+    QMutexLocker locker( &mPartialImageMutex );
+    // only the latest one is shown if the previous ones were not yet
+    const bool pending = !mPartialImage.isNull();
+    mPartialImage = image;
+    locker.unlock();
+
+    if ( !pending )
+        emit partialImageReady();
+}
+
+QImage PixmapGenerationThread::takePartialImage()
+{
+    QMutexLocker locker( &mPartialImageMutex );
+    const QImage image = mPartialImage;
+    mPartialImage = QImage();
+    return image;
+}
+
 void PixmapGenerationThread::run()
 {
     mImage = QImage();
+    takePartialImage();
 
     if ( mRequest )
     {
-        mImage = mGenerator->image( mRequest );
-        if ( mCalcBoundingBox )
+        mImage = mGenerator->d_func()->cachedImage( mRequest );
+        if ( mCalcBoundingBox && !mRequest->shouldAbortRender() )
             mBoundingBox = Utils::imageBoundingBox( &mImage );
     }
 }
@@ -141,4 +164,61 @@ void FontExtractionThread::run()
     }
 }
 
+
+TextIndexingThread::TextIndexingThread( Generator *generator, const QVector< Page * > &pages )
+    : mGenerator( generator ), mPages( pages ), mIndex( 0 ), mGoOn( true )
+{
+}
+
+TextIndexingThread::~TextIndexingThread()
+{
+    delete mIndex;
+}
+
+void TextIndexingThread::stopIndexing()
+{
+    mGoOn = false;
+}
+
+TextSearchIndex *TextIndexingThread::takeIndex()
+{
+    TextSearchIndex *index = mIndex;
+    mIndex = 0;
+    return index;
+}
+
+void TextIndexingThread::run()
+{
+    // the text pages of the document are only used by the GUI thread,
+    // extract private ones, one at a time so that the rendering of the
+    // pages shown is not slowed down
+    TextSearchIndex *index = new TextSearchIndex( mPages.count() );
+    for ( int i = 0; i < mPages.count(); ++i )
+    {
+        // let the pages being rendered go first
+        bool idle = false;
+        while ( mGoOn && !idle )
+        {
+            idle = mGenerator->userMutex()->tryLock();
+            if ( idle )
+                mGenerator->userMutex()->unlock();
+            else
+                msleep( 50 );
+        }
+        if ( !mGoOn )
+        {
+            delete index;
+            return;
+        }
+
+        TextPage *textPage = mGenerator->textPage( mPages.at( i ) );
+        if ( textPage )
+        {
+            index->addPage( i, textPage->text() );
+            delete textPage;
+        }
+    }
+    mIndex = index;
+}
+
 #include "generator_p.moc"
@@ -12,12 +12,15 @@
 
 #include "area.h"
 
+#include <QtCore/QAtomicInt>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
 #include <QtCore/QSet>
 #include <QtCore/QThread>
+#include <QtCore/QVector>
 #include <QtGui/QImage>
 
 class QEventLoop;
-class QMutex;
 
 namespace Okular {
 
@@ -30,6 +33,7 @@ class PixmapGenerationThread;
 class PixmapRequest;
 class TextPage;
 class TextPageGenerationThread;
+class TextSearchIndex;
 
 class GeneratorPrivate
 {
@@ -43,8 +47,10 @@ class GeneratorPrivate
 
         PixmapGenerationThread* pixmapGenerationThread();
         TextPageGenerationThread* textPageGenerationThread();
+        int maxPixmapGenerationThreads() const;
 
         void pixmapGenerationFinished();
+        void pixmapGenerationUpdated();
         void textpageGenerationFinished();
 
         QMutex* threadsLock();
@@ -52,11 +58,17 @@ class GeneratorPrivate
         virtual QVariant metaData( const QString &key, const QVariant &option ) const;
         virtual QImage image( PixmapRequest * );
 
+        // image() of the generator, going through the disk cache if the
+        // request has a cache key
+        QImage cachedImage( PixmapRequest *request );
+
         DocumentPrivate *m_document;
         // NOTE: the following should be a QSet< GeneratorFeature >,
         // but it is not to avoid #include'ing generator.h
         QSet< int > m_features;
-        PixmapGenerationThread *mPixmapGenerationThread;
+        // the render threads; more than one only with ParallelRendering
+        QList< PixmapGenerationThread * > mPixmapGenerationThreads;
+        int mPixmapGenerationsRunning;
         TextPageGenerationThread *mTextPageGenerationThread;
         mutable QMutex *m_mutex;
         QMutex *m_threadsMutex;
@@ -81,8 +93,14 @@ class PixmapRequestPrivate
         int mFeatures;
         bool mForce : 1;
         bool mTile : 1;
+        // the low resolution first pass of a progressive request
+        bool mPreview : 1;
+        // set from the main thread, read by the render thread
+        QAtomicInt mShouldAbortRender;
         Page *mPage;
         NormalizedRect mNormalizedRect;
+        // key of the rendered page in the disk cache, empty if not cacheable
+        QByteArray mDiskCacheKey;
 };
 
 
@@ -103,6 +121,13 @@ class PixmapGenerationThread : public QThread
         bool calcBoundingBox() const;
         NormalizedRect boundingBox() const;
 
+        // called from the thread while the generator renders the request
+        void setPartialImage( const QImage &image );
+        QImage takePartialImage();
+
+    Q_SIGNALS:
+        void partialImageReady();
+
     protected:
         virtual void run();
 
@@ -110,6 +135,8 @@ class PixmapGenerationThread : public QThread
         Generator *mGenerator;
         PixmapRequest *mRequest;
         QImage mImage;
+        QMutex mPartialImageMutex;
+        QImage mPartialImage;
         NormalizedRect mBoundingBox;
         bool mCalcBoundingBox : 1;
 };
@@ -162,6 +189,32 @@ class FontExtractionThread : public QThread
         bool mGoOn;
 };
 
+class TextIndexingThread : public QThread
+{
+    Q_OBJECT
+
+    public:
+        TextIndexingThread( Generator *generator, const QVector< Page * > &pages );
+        ~TextIndexingThread();
+
+        void stopIndexing();
+
+        /**
+         * Returns the index built, or 0 if the indexing was stopped.
+         * The caller takes its ownership.
+         */
+        TextSearchIndex *takeIndex();
+
+    protected:
+        virtual void run();
+
+    private:
+        Generator *mGenerator;
+        QVector< Page * > mPages;
+        TextSearchIndex *mIndex;
+        bool mGoOn;
+};
+
 }
 
 #endif
@@ -0,0 +1,202 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "objectrectindex_p.h"
+
+#include <QtCore/QtAlgorithms>
+
+#include <limits>
+#include <math.h>
+
+using namespace Okular;
+
+// a grid cell holds about this many rects
+static const int RectsPerCell = 2;
+static const int MaxGridSize = 64;
+
+ObjectRectIndex::ObjectRectIndex( const QLinkedList< ObjectRect * > &rects )
+{
+    QVector< const ObjectRect * > actions, images, sourceRefs;
+    QLinkedList< ObjectRect * >::const_iterator it = rects.constBegin(), end = rects.constEnd();
+    for ( ; it != end; ++it )
+    {
+        switch ( (*it)->objectType() )
+        {
+            case ObjectRect::Action:
+                actions.append( *it );
+                break;
+            case ObjectRect::Image:
+                images.append( *it );
+                break;
+            case ObjectRect::SourceRef:
+                sourceRefs.append( *it );
+                break;
+            case ObjectRect::OAnnotation:
+                break;
+        }
+    }
+
+    buildGrid( m_actions, actions );
+    buildGrid( m_images, images );
+    buildGrid( m_sourceRefs, sourceRefs );
+}
+
+bool ObjectRectIndex::isIndexed( ObjectRect::ObjectType type )
+{
+    return type != ObjectRect::OAnnotation;
+}
+
+QVector< const ObjectRect * > ObjectRectIndex::candidates( ObjectRect::ObjectType type, double x, double y, double xDistance, double yDistance ) const
+{
+    QVector< const ObjectRect * > result;
+    const Grid *g = grid( type );
+    if ( !g || g->rects.isEmpty() )
+        return result;
+
+    const int left = cell( x - xDistance, g->columns ), right = cell( x + xDistance, g->columns );
+    const int top = cell( y - yDistance, g->rows ), bottom = cell( y + yDistance, g->rows );
+
+    QVector< int > indexes;
+    for ( int row = top; row <= bottom; ++row )
+    {
+        for ( int column = left; column <= right; ++column )
+            indexes += g->cells.at( row * g->columns + column );
+    }
+
+    // the rects spanning several cells are found more than once
+    qSort( indexes );
+    int previous = -1;
+    for ( int i = indexes.count() - 1; i >= 0; --i )
+    {
+        const int index = indexes.at( i );
+        if ( index != previous )
+            result.append( g->rects.at( index ) );
+        previous = index;
+    }
+    return result;
+}
+
+const ObjectRect * ObjectRectIndex::nearest( ObjectRect::ObjectType type, double x, double y, double xScale, double yScale, double *distance ) const
+{
+    const ObjectRect *res = 0;
+    int resIndex = -1;
+    double minDistance = std::numeric_limits<double>::max();
+
+    const Grid *g = grid( type );
+    if ( g && !g->rects.isEmpty() )
+    {
+        // look at the cells around the one of the point, ring by ring, until
+        // the cells left are farther than the nearest rect found
+        const double cellSize = qMin( fabs( xScale ) / g->columns, fabs( yScale ) / g->rows );
+        const int column = cell( x, g->columns ), row = cell( y, g->rows );
+        const int rings = qMax( g->columns, g->rows );
+        for ( int r = 0; r <= rings; ++r )
+        {
+            for ( int cy = row - r; cy <= row + r; ++cy )
+            {
+                if ( cy < 0 || cy >= g->rows )
+                    continue;
+
+                // the rows inside the ring only have their two ends on it
+                const int step = ( cy == row - r || cy == row + r ) ? 1 : 2 * r;
+                for ( int cx = column - r; cx <= column + r; cx += step )
+                {
+                    if ( cx < 0 || cx >= g->columns )
+                        continue;
+
+                    foreach ( int index, g->cells.at( cy * g->columns + cx ) )
+                    {
+                        const double d = g->rects.at( index )->distanceSqr( x, y, xScale, yScale );
+                        if ( d < minDistance || ( d == minDistance && index < resIndex ) )
+                        {
+                            res = g->rects.at( index );
+                            resIndex = index;
+                            minDistance = d;
+                        }
+                    }
+                }
+            }
+
+            // the cells of the next rings are at least this far
+            const double reach = r * cellSize;
+            if ( res && minDistance < reach * reach )
+                break;
+        }
+    }
+
+    if ( distance )
+        *distance = minDistance;
+    return res;
+}
+
+QRectF ObjectRectIndex::objectBox( const ObjectRect *rect )
+{
+    if ( rect->objectType() == ObjectRect::SourceRef )
+    {
+        // only the coordinates given are taken into account for the distance
+        const NormalizedPoint &point = static_cast< const SourceRefObjectRect * >( rect )->m_point;
+        if ( point.x == -1.0 )
+            return QRectF( 0.0, point.y, 1.0, 0.0 );
+        if ( point.y == -1.0 )
+            return QRectF( point.x, 0.0, 0.0, 1.0 );
+        return QRectF( point.x, point.y, 0.0, 0.0 );
+    }
+
+    return rect->region().boundingRect();
+}
+
+int ObjectRectIndex::cell( double coordinate, int count )
+{
+    // whatever is out of the page goes to the cells on its border
+    if ( !( coordinate > 0.0 ) )
+        return 0;
+    if ( coordinate >= 1.0 )
+        return count - 1;
+    return qMin( (int)( coordinate * count ), count - 1 );
+}
+
+void ObjectRectIndex::buildGrid( Grid &grid, const QVector< const ObjectRect * > &rects )
+{
+    const int size = qBound( 1, (int)sqrt( (double)rects.count() / RectsPerCell ), MaxGridSize );
+    grid.columns = size;
+    grid.rows = size;
+    grid.rects = rects;
+    grid.cells.clear();
+    grid.cells.resize( size * size );
+
+    for ( int i = 0; i < rects.count(); ++i )
+    {
+        const QRectF box = objectBox( rects.at( i ) );
+        const int left = cell( box.left(), size ), right = cell( box.right(), size );
+        const int top = cell( box.top(), size ), bottom = cell( box.bottom(), size );
+        for ( int row = top; row <= bottom; ++row )
+        {
+            for ( int column = left; column <= right; ++column )
+                grid.cells[ row * size + column ].append( i );
+        }
+    }
+}
+
+const ObjectRectIndex::Grid *ObjectRectIndex::grid( ObjectRect::ObjectType type ) const
+{
+    switch ( type )
+    {
+        case ObjectRect::Action:
+            return &m_actions;
+        case ObjectRect::Image:
+            return &m_images;
+        case ObjectRect::SourceRef:
+            return &m_sourceRefs;
+        case ObjectRect::OAnnotation:
+            break;
+    }
+    return 0;
+}
+
+/* kate: replace-tabs on; indent-width 4; */
@@ -0,0 +1,79 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_OBJECTRECTINDEX_P_H_
+#define _OKULAR_OBJECTRECTINDEX_P_H_
+
+#include <QtCore/QLinkedList>
+#include <QtCore/QRectF>
+#include <QtCore/QVector>
+
+#include "area.h"
+
+namespace Okular {
+
+/**
+ * @short Grid index of the object rects of a page, one grid per type.
+ *
+ * It finds the object rects near a point without looking at all the rects
+ * of the page. Only the action, image and source reference rects are
+ * indexed: the annotations can be moved without the page knowing, and
+ * they are few anyway.
+ *
+ * The index refers to the rects in their current transformation, so it has
+ * to be rebuilt whenever the rects of the page change or are rotated.
+ */
+class ObjectRectIndex
+{
+    public:
+        explicit ObjectRectIndex( const QLinkedList< ObjectRect * > &rects );
+
+        static bool isIndexed( ObjectRect::ObjectType type );
+
+        /**
+         * Returns the rects of type @p type that may be closer than
+         * @p xDistance and @p yDistance (in normalized coordinates) to the
+         * point @p x, @p y. They are sorted in the reverse order of the
+         * list of rects of the page.
+         */
+        QVector< const ObjectRect * > candidates( ObjectRect::ObjectType type, double x, double y, double xDistance, double yDistance ) const;
+
+        /**
+         * Returns the rect of type @p type with the smallest
+         * ObjectRect::distanceSqr() from the point @p x, @p y, the first in
+         * the list of rects of the page if several are as close.
+         */
+        const ObjectRect * nearest( ObjectRect::ObjectType type, double x, double y, double xScale, double yScale, double *distance ) const;
+
+    private:
+        struct Grid
+        {
+            int columns;
+            int rows;
+            // in the order of the list of rects
+            QVector< const ObjectRect * > rects;
+            // the indexes in rects of the rects overlapping each cell
+            QVector< QVector< int > > cells;
+        };
+
+        static QRectF objectBox( const ObjectRect *rect );
+        static int cell( double coordinate, int count );
+        static void buildGrid( Grid &grid, const QVector< const ObjectRect * > &rects );
+        const Grid *grid( ObjectRect::ObjectType type ) const;
+
+        Grid m_actions;
+        Grid m_images;
+        Grid m_sourceRefs;
+};
+
+}
+
+#endif
+
+/* kate: replace-tabs on; indent-width 4; */
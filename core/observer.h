@@ -45,7 +45,8 @@ class OKULAR_EXPORT DocumentObserver
             TextSelection = 8,    ///< Text selection has been changed
             Annotations = 16,     ///< Annotations have been changed
             BoundingBox = 32,     ///< Bounding boxes have been changed
-            NeedSaveAs = 64       ///< Set along with Annotations when Save As is needed or annotation changes will be lost @since 0.15 (KDE 4.9)
+            NeedSaveAs = 64,      ///< Set along with Annotations when Save As is needed or annotation changes will be lost @since 0.15 (KDE 4.9)
+            Metadata = 128        ///< The annotations, form fields, transition and actions of the page have been loaded, set along with Annotations @since 0.19 (KDE 4.13)
         };
 
         /**
@@ -53,7 +54,8 @@ class OKULAR_EXPORT DocumentObserver
          */
         enum SetupFlags {
             DocumentChanged = 1,    ///< The document is a new document.
-            NewLayoutForPages = 2   ///< All the pages have
+            NewLayoutForPages = 2,  ///< All the pages have
+            PagesAppended = 4       ///< Pages have been appended to the document while it is being loaded, the previous ones did not change @since 0.19 (KDE 4.13)
         };
 
         /**
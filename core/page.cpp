@@ -10,9 +10,11 @@
 #include "page_p.h"
 
 // qt/kde includes
+#include <QtCore/QCoreApplication>
 #include <QtCore/QHash>
 #include <QtCore/QSet>
 #include <QtCore/QString>
+#include <QtCore/QThread>
 #include <QtCore/QVariant>
 #include <QtCore/QUuid>
 #include <QtGui/QPixmap>
@@ -31,6 +33,7 @@
 #include "document_p.h"
 #include "form.h"
 #include "form_p.h"
+#include "objectrectindex_p.h"
 #include "observer.h"
 #include "pagecontroller_p.h"
 #include "pagesize.h"
@@ -43,6 +46,7 @@
 #include "utils_p.h"
 
 #include <limits>
+#include <math.h>
 
 #ifdef PAGE_PROFILE
 #include <QtCore/QTime>
@@ -71,7 +75,7 @@ PagePrivate::PagePrivate( Page *page, uint n, double w, double h, Rotation o )
       m_rotation( Rotation0 ),
       m_text( 0 ), m_transition( 0 ), m_textSelections( 0 ),
       m_openingAction( 0 ), m_closingAction( 0 ), m_duration( -1 ),
-      m_isBoundingBoxKnown( false )
+      m_rectIndex( 0 ), m_isBoundingBoxKnown( false ), m_isMetadataLoaded( true )
 {
     // avoid Division-By-Zero problems in the program
     if ( m_width <= 0 )
@@ -88,6 +92,7 @@ PagePrivate::~PagePrivate()
     delete m_closingAction;
     delete m_text;
     delete m_transition;
+    delete m_rectIndex;
 }
 
 
@@ -102,6 +107,8 @@ void PagePrivate::imageRotationDone( RotationJob * job )
         return;
     }
 
+    deleteTransformedPixmap( job->observer() );
+
     QMap< DocumentObserver*, PixmapObject >::iterator it = m_pixmaps.find( job->observer() );
     if ( it != m_pixmaps.end() )
     {
@@ -251,12 +258,10 @@ bool Page::hasObjectRect( double x, double y, double xScale, double yScale ) con
     if ( m_rects.isEmpty() )
         return false;
 
-    QLinkedList< ObjectRect * >::const_iterator it = m_rects.begin(), end = m_rects.end();
-    for ( ; it != end; ++it )
-        if ( (*it)->distanceSqr( x, y, xScale, yScale ) < distanceConsideredEqual )
-            return true;
-
-    return false;
+    return objectRect( ObjectRect::Action, x, y, xScale, yScale )
+        || objectRect( ObjectRect::Image, x, y, xScale, yScale )
+        || objectRect( ObjectRect::SourceRef, x, y, xScale, yScale )
+        || objectRect( ObjectRect::OAnnotation, x, y, xScale, yScale );
 }
 
 bool Page::hasHighlights( int s_id ) const
@@ -277,11 +282,13 @@ bool Page::hasHighlights( int s_id ) const
 
 bool Page::hasTransition() const
 {
+    d->loadMetadata();
     return d->m_transition != 0;
 }
 
 bool Page::hasAnnotations() const
 {
+    d->loadMetadata();
     return !m_annotations.isEmpty();
 }
 
@@ -389,6 +396,7 @@ void PagePrivate::rotateAt( Rotation orientation )
     QLinkedList< ObjectRect * >::const_iterator objectIt = m_page->m_rects.begin(), end = m_page->m_rects.end();
     for ( ; objectIt != end; ++objectIt )
         (*objectIt)->transform( matrix );
+    invalidateRectIndex();
 
     QLinkedList< HighlightAreaRect* >::const_iterator hlIt = m_page->m_highlights.begin(), hlItEnd = m_page->m_highlights.end();
     for ( ; hlIt != hlItEnd; ++hlIt )
@@ -414,6 +422,18 @@ void PagePrivate::changeSize( const PageSize &size )
 
 const ObjectRect * Page::objectRect( ObjectRect::ObjectType type, double x, double y, double xScale, double yScale ) const
 {
+    if ( ObjectRectIndex::isIndexed( type ) )
+    {
+        const double maxDistance = sqrt( distanceConsideredEqual );
+        const QVector< const ObjectRect * > candidates = d->rectIndex()->candidates( type, x, y, maxDistance / xScale, maxDistance / yScale );
+        foreach ( const ObjectRect *objrect, candidates )
+        {
+            if ( objrect->distanceSqr( x, y, xScale, yScale ) < distanceConsideredEqual )
+                return objrect;
+        }
+        return 0;
+    }
+
     // Walk list in reverse order so that annotations in the foreground are preferred
     QLinkedListIterator< ObjectRect * > it( m_rects );
     it.toBack();
@@ -431,6 +451,18 @@ QLinkedList< const ObjectRect * > Page::objectRects( ObjectRect::ObjectType type
 {
     QLinkedList< const ObjectRect * > result;
 
+    if ( ObjectRectIndex::isIndexed( type ) )
+    {
+        const double maxDistance = sqrt( distanceConsideredEqual );
+        const QVector< const ObjectRect * > candidates = d->rectIndex()->candidates( type, x, y, maxDistance / xScale, maxDistance / yScale );
+        foreach ( const ObjectRect *objrect, candidates )
+        {
+            if ( objrect->distanceSqr( x, y, xScale, yScale ) < distanceConsideredEqual )
+                result.append( objrect );
+        }
+        return result;
+    }
+
     QLinkedListIterator< ObjectRect * > it( m_rects );
     it.toBack();
     while ( it.hasPrevious() )
@@ -446,6 +478,9 @@ QLinkedList< const ObjectRect * > Page::objectRects( ObjectRect::ObjectType type
 
 const ObjectRect* Page::nearestObjectRect( ObjectRect::ObjectType type, double x, double y, double xScale, double yScale, double * distance ) const
 {
+    if ( ObjectRectIndex::isIndexed( type ) )
+        return d->rectIndex()->nearest( type, x, y, xScale, yScale, distance );
+
     ObjectRect * res = 0;
     double minDistance = std::numeric_limits<double>::max();
 
@@ -470,16 +505,19 @@ const ObjectRect* Page::nearestObjectRect( ObjectRect::ObjectType type, double x
 
 const PageTransition * Page::transition() const
 {
+    d->loadMetadata();
     return d->m_transition;
 }
 
 QLinkedList< Annotation* > Page::annotations() const
 {
+    d->loadMetadata();
     return m_annotations;
 }
 
 const Action * Page::pageAction( PageAction action ) const
 {
+    d->loadMetadata();
     switch ( action )
     {
         case Page::Opening:
@@ -495,11 +533,14 @@ const Action * Page::pageAction( PageAction action ) const
 
 QLinkedList< FormField * > Page::formFields() const
 {
+    d->loadMetadata();
     return d->formfields;
 }
 
 void Page::setPixmap( DocumentObserver *observer, QPixmap *pixmap, const NormalizedRect &rect )
 {
+    d->deleteTransformedPixmap( observer );
+
     if ( d->m_rotation == Rotation0 ) {
         TilesManager *tm = ( observer == d->m_doc->m_tiledObserver ) ? d->m_tilesManager : 0;
         if ( tm )
@@ -561,6 +602,7 @@ void Page::setObjectRects( const QLinkedList< ObjectRect * > & rects )
         (*objectIt)->transform( matrix );
 
     m_rects << rects;
+    d->invalidateRectIndex();
 }
 
 void PagePrivate::setHighlight( int s_id, RegularAreaRect *rect, const QColor & color )
@@ -590,6 +632,7 @@ void Page::setSourceReferences( const QLinkedList< SourceRefObjectRect * > & ref
     deleteSourceReferences();
     foreach( SourceRefObjectRect * rect, refRects )
         m_rects << rect;
+    d->invalidateRectIndex();
 }
 
 void Page::setDuration( double seconds )
@@ -624,6 +667,9 @@ QColor Page::textSelectionColor() const
 
 void Page::addAnnotation( Annotation * annotation )
 {
+    // the annotations of the generator come first
+    d->loadMetadata();
+
     // Generate uniqueName: okular-{UUID}
     if(annotation->uniqueName().isEmpty())
     {
@@ -640,10 +686,13 @@ void Page::addAnnotation( Annotation * annotation )
     annotation->d_ptr->annotationTransform( matrix );
 
     m_rects.append( rect );
+    d->invalidateRectIndex();
 }
 
 bool Page::removeAnnotation( Annotation * annotation )
 {
+    d->loadMetadata();
+
     if ( !d->m_doc->m_parent->canRemovePageAnnotation(annotation) )
         return false;
 
@@ -660,6 +709,7 @@ bool Page::removeAnnotation( Annotation * annotation )
                     delete *it;
                     it = m_rects.erase( it );
                     rectfound = true;
+                    d->invalidateRectIndex();
                 }
             kDebug(OkularDebug) << "removed annotation:" << annotation->uniqueName();
             annotation->d_ptr->m_page = 0;
@@ -703,6 +753,16 @@ void Page::setFormFields( const QLinkedList< FormField * >& fields )
     }
 }
 
+void Page::setMetadataLoaded( bool loaded )
+{
+    d->m_isMetadataLoaded = loaded;
+}
+
+bool Page::isMetadataLoaded() const
+{
+    return d->m_isMetadataLoaded;
+}
+
 void Page::deletePixmap( DocumentObserver *observer )
 {
     if ( observer == d->m_doc->m_tiledObserver && d->m_tilesManager )
@@ -712,6 +772,7 @@ void Page::deletePixmap( DocumentObserver *observer )
     }
     else
     {
+        d->deleteTransformedPixmap( observer );
         PagePrivate::PixmapObject object = d->m_pixmaps.take( observer );
         delete object.m_pixmap;
     }
@@ -722,6 +783,7 @@ void Page::deletePixmaps()
     QMapIterator< DocumentObserver*, PagePrivate::PixmapObject > it( d->m_pixmaps );
     while ( it.hasNext() ) {
         it.next();
+        d->deleteTransformedPixmap( it.key() );
         delete it.value().m_pixmap;
     }
 
@@ -736,6 +798,7 @@ void Page::deleteRects()
     QSet<ObjectRect::ObjectType> which;
     which << ObjectRect::Action << ObjectRect::Image;
     deleteObjectRects( m_rects, which );
+    d->invalidateRectIndex();
 }
 
 void PagePrivate::deleteHighlights( int s_id )
@@ -761,15 +824,32 @@ void PagePrivate::deleteTextSelections()
     m_textSelections = 0;
 }
 
+void PagePrivate::loadMetadata()
+{
+    if ( m_isMetadataLoaded || !m_doc )
+        return;
+
+    // the generator threads would deadlock on the generator lock, the pages
+    // to render are loaded when they are requested anyway
+    if ( QThread::currentThread() != QCoreApplication::instance()->thread() )
+        return;
+
+    // set it first, the generator fills the page through the usual setters
+    m_isMetadataLoaded = true;
+    m_doc->loadPageMetadata( m_page );
+}
+
 void Page::deleteSourceReferences()
 {
     deleteObjectRects( m_rects, QSet<ObjectRect::ObjectType>() << ObjectRect::SourceRef );
+    d->invalidateRectIndex();
 }
 
 void Page::deleteAnnotations()
 {
     // delete ObjectRects of type Annotation
     deleteObjectRects( m_rects, QSet<ObjectRect::ObjectType>() << ObjectRect::OAnnotation );
+    d->invalidateRectIndex();
     // delete all stored annotations
     QLinkedList< Annotation * >::const_iterator aIt = m_annotations.begin(), aEnd = m_annotations.end();
     for ( ; aIt != aEnd; ++aIt )
@@ -779,6 +859,9 @@ void Page::deleteAnnotations()
 
 void PagePrivate::restoreLocalContents( const QDomNode & pageNode )
 {
+    // the restored annotations and form values apply to the generator ones
+    loadMetadata();
+
     // iterate over all chilren (annotationList, ...)
     QDomNode childNode = pageNode.firstChild();
     while ( childNode.isElement() )
@@ -982,6 +1065,16 @@ const QPixmap * Page::_o_nearestPixmap( DocumentObserver *observer, int w, int h
     return pixmap;
 }
 
+const QPixmap * Page::_o_transformedPixmap( DocumentObserver *observer, const QPixmap *source, const QByteArray &transform ) const
+{
+    return d->transformedPixmap( observer, source, transform );
+}
+
+bool Page::_o_setTransformedPixmap( DocumentObserver *observer, const QPixmap *source, const QByteArray &transform, const QPixmap &pixmap )
+{
+    return d->setTransformedPixmap( observer, source, transform, pixmap );
+}
+
 bool Page::hasTilesManager() const
 {
     return d->m_tilesManager != 0;
@@ -1006,3 +1099,55 @@ void PagePrivate::setTilesManager( TilesManager *tm )
     m_tilesManager = tm;
 }
 
+const ObjectRectIndex *PagePrivate::rectIndex() const
+{
+    if ( !m_rectIndex )
+        m_rectIndex = new ObjectRectIndex( m_page->m_rects );
+    return m_rectIndex;
+}
+
+void PagePrivate::invalidateRectIndex()
+{
+    delete m_rectIndex;
+    m_rectIndex = 0;
+}
+
+const QPixmap *PagePrivate::transformedPixmap( DocumentObserver *observer, const QPixmap *source, const QByteArray &transform ) const
+{
+    QMap< DocumentObserver*, TransformedPixmapObject >::const_iterator it = m_transformedPixmaps.constFind( observer );
+    if ( it == m_transformedPixmaps.constEnd() || it.value().m_sourceKey != source->cacheKey() || it.value().m_transform != transform )
+        return 0;
+
+    return &it.value().m_pixmap;
+}
+
+bool PagePrivate::setTransformedPixmap( DocumentObserver *observer, const QPixmap *source, const QByteArray &transform, const QPixmap &pixmap )
+{
+    QMap< DocumentObserver*, PixmapObject >::const_iterator it = m_pixmaps.constFind( observer );
+    if ( it == m_pixmaps.constEnd() || it.value().m_pixmap != source )
+        return false;
+
+    deleteTransformedPixmap( observer );
+
+    TransformedPixmapObject object;
+    object.m_pixmap = pixmap;
+    object.m_sourceKey = source->cacheKey();
+    object.m_transform = transform;
+    m_transformedPixmaps.insert( observer, object );
+    if ( m_doc )
+        m_doc->pixmapMemoryChanged( observer, m_number, 4 * (qlonglong)pixmap.width() * pixmap.height() );
+    return true;
+}
+
+void PagePrivate::deleteTransformedPixmap( DocumentObserver *observer )
+{
+    QMap< DocumentObserver*, TransformedPixmapObject >::iterator it = m_transformedPixmaps.find( observer );
+    if ( it == m_transformedPixmaps.end() )
+        return;
+
+    const QPixmap &pixmap = it.value().m_pixmap;
+    if ( m_doc )
+        m_doc->pixmapMemoryChanged( observer, m_number, -4 * (qlonglong)pixmap.width() * pixmap.height() );
+    m_transformedPixmaps.erase( it );
+}
+
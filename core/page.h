@@ -17,6 +17,7 @@
 #include "global.h"
 #include "textpage.h"
 
+class QByteArray;
 class QPixmap;
 
 class PagePainter;
@@ -343,6 +344,27 @@ class OKULAR_EXPORT Page
          */
         void setFormFields( const QLinkedList< FormField * >& fields );
 
+        /**
+         * Sets whether the annotations, form fields, transition and page
+         * actions of the page are @p loaded.
+         *
+         * A generator can create the pages of a document with them not
+         * loaded yet, then Generator::loadPageMetadata() is called the first
+         * time they are queried or the page is shown. Pages are created with
+         * them loaded.
+         *
+         * @since 0.19 (KDE 4.13)
+         */
+        void setMetadataLoaded( bool loaded );
+
+        /**
+         * Returns whether the annotations, form fields, transition and page
+         * actions of the page are loaded.
+         *
+         * @since 0.19 (KDE 4.13)
+         */
+        bool isMetadataLoaded() const;
+
         /**
          * Deletes the pixmap for the given @p observer
          */
@@ -400,6 +422,8 @@ class OKULAR_EXPORT Page
         /// @endcond
 
         const QPixmap * _o_nearestPixmap( DocumentObserver *, int, int ) const;
+        const QPixmap * _o_transformedPixmap( DocumentObserver *, const QPixmap *, const QByteArray & ) const;
+        bool _o_setTransformedPixmap( DocumentObserver *, const QPixmap *, const QByteArray &, const QPixmap & );
 
         QLinkedList< ObjectRect* > m_rects;
         QLinkedList< HighlightAreaRect* > m_highlights;
@@ -14,6 +14,7 @@
 // qt/kde includes
 #include <qlinkedlist.h>
 #include <qmap.h>
+#include <qpixmap.h>
 #include <qtransform.h>
 #include <qstring.h>
 #include <qdom.h>
@@ -32,6 +33,7 @@ class DocumentObserver;
 class DocumentPrivate;
 class FormField;
 class HighlightAreaRect;
+class ObjectRectIndex;
 class Page;
 class PageSize;
 class PageTransition;
@@ -104,12 +106,51 @@ class PagePrivate
          */
         void deleteTextSelections();
 
+        /**
+         * Asks the generator for the annotations, form fields, transition
+         * and page actions of the page if they are not loaded yet.
+         */
+        void loadMetadata();
+
         /**
          * Get/set the tiles manager for the tiled observer
          */
         TilesManager *tilesManager() const;
         void setTilesManager( TilesManager *tm );
 
+        /**
+         * Returns the spatial index of the object rects of the page, building
+         * it if needed.
+         */
+        const ObjectRectIndex *rectIndex() const;
+
+        /**
+         * Drops the spatial index of the object rects, to be called whenever
+         * they change.
+         */
+        void invalidateRectIndex();
+
+        /**
+         * Returns the pixmap of @p observer with its colors changed by
+         * @p transform, if it was cached for the pixmap @p source.
+         *
+         * Only the pixmaps of the observer itself are cached, so that the
+         * memory they use is accounted with them.
+         */
+        const QPixmap *transformedPixmap( DocumentObserver *observer, const QPixmap *source, const QByteArray &transform ) const;
+
+        /**
+         * Caches @p pixmap as the pixmap of @p observer, @p source, with its
+         * colors changed by @p transform. Returns whether it was cached.
+         */
+        bool setTransformedPixmap( DocumentObserver *observer, const QPixmap *source, const QByteArray &transform, const QPixmap &pixmap );
+
+        /**
+         * Drops the transformed pixmap of @p observer, to be called whenever
+         * its pixmap changes.
+         */
+        void deleteTransformedPixmap( DocumentObserver *observer );
+
         class PixmapObject
         {
             public:
@@ -117,6 +158,15 @@ class PagePrivate
                 Rotation m_rotation;
         };
         QMap< DocumentObserver*, PixmapObject > m_pixmaps;
+        class TransformedPixmapObject
+        {
+            public:
+                QPixmap m_pixmap;
+                // the cache key of the pixmap it was made from
+                qint64 m_sourceKey;
+                QByteArray m_transform;
+        };
+        QMap< DocumentObserver*, TransformedPixmapObject > m_transformedPixmaps;
         TilesManager* m_tilesManager;
 
         Page *m_page;
@@ -135,8 +185,10 @@ class PagePrivate
         Action * m_closingAction;
         double m_duration;
         QString m_label;
+        mutable ObjectRectIndex *m_rectIndex;
 
         bool m_isBoundingBoxKnown : 1;
+        bool m_isMetadataLoaded : 1;
         QDomDocument restoredLocalAnnotationList; // <annotationList>...</annotationList>
 };
 
@@ -0,0 +1,249 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "pixmapdiskcache_p.h"
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QRunnable>
+#include <QtCore/QThreadPool>
+#include <QtGui/QImage>
+
+#include <kde_file.h>
+#include <kglobal.h>
+#include <kstandarddirs.h>
+
+using namespace Okular;
+
+// bytes read from each end of a file to identify it
+static const qint64 FingerprintChunkSize = 64 * 1024;
+
+K_GLOBAL_STATIC( PixmapDiskCache, s_pixmapDiskCache )
+
+namespace Okular {
+
+class PixmapDiskCacheWriter : public QRunnable
+{
+    public:
+        PixmapDiskCacheWriter( const QByteArray &key, const QString &fileName, const QImage &image )
+            : m_key( key ), m_fileName( fileName ), m_image( image )
+        {
+        }
+
+        void run()
+        {
+            // write to a temporary file first, so that find() never sees
+            // an incomplete image
+            const QString partFileName = m_fileName + QLatin1String( ".part" );
+            if ( !m_image.save( partFileName, "PNG" ) )
+            {
+                QFile::remove( partFileName );
+                return;
+            }
+            QFile::remove( m_fileName );
+            if ( !QFile::rename( partFileName, m_fileName ) )
+            {
+                QFile::remove( partFileName );
+                return;
+            }
+
+            PixmapDiskCache *cache = PixmapDiskCache::self();
+            if ( !cache )
+                return;
+
+            QMutexLocker locker( &cache->m_mutex );
+            cache->loadIndex();
+            cache->addEntry( m_key, QFileInfo( m_fileName ).size() );
+            cache->trim();
+        }
+
+    private:
+        QByteArray m_key;
+        QString m_fileName;
+        QImage m_image;
+};
+
+}
+
+PixmapDiskCache *PixmapDiskCache::self()
+{
+    // pending writes may end after the application shutdown
+    if ( s_pixmapDiskCache.isDestroyed() )
+        return 0;
+    return s_pixmapDiskCache;
+}
+
+PixmapDiskCache::PixmapDiskCache()
+    : m_enabled( false ), m_indexLoaded( false ),
+      m_maximumSize( 256 * 1024 * 1024 ), m_size( 0 ), m_clock( 0 )
+{
+    m_directory = KStandardDirs::locateLocal( "cache", QLatin1String( "okular/pages/" ) );
+}
+
+bool PixmapDiskCache::isEnabled() const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_enabled && !m_directory.isEmpty();
+}
+
+void PixmapDiskCache::setEnabled( bool enabled )
+{
+    QMutexLocker locker( &m_mutex );
+    m_enabled = enabled;
+}
+
+void PixmapDiskCache::setMaximumSize( qulonglong size )
+{
+    QMutexLocker locker( &m_mutex );
+    if ( m_maximumSize == size )
+        return;
+
+    m_maximumSize = size;
+    if ( m_indexLoaded )
+        trim();
+}
+
+QByteArray PixmapDiskCache::fileFingerprint( const QString &fileName )
+{
+    QFile file( fileName );
+    if ( !file.open( QIODevice::ReadOnly ) )
+        return QByteArray();
+
+    const qint64 size = file.size();
+    QCryptographicHash hash( QCryptographicHash::Md5 );
+    hash.addData( QByteArray::number( size ) );
+    // a file rewritten in place with the same size and ends, e.g. a single
+    // edited character, is still told apart by its inode and time stamp
+    KDE_struct_stat buf;
+    if ( KDE::stat( fileName, &buf ) == 0 )
+    {
+        hash.addData( QByteArray::number( (qulonglong)buf.st_ino ) );
+        hash.addData( QByteArray::number( (qlonglong)buf.st_mtime ) );
+    }
+    hash.addData( file.read( FingerprintChunkSize ) );
+    if ( size > FingerprintChunkSize && file.seek( qMax( FingerprintChunkSize, size - FingerprintChunkSize ) ) )
+        hash.addData( file.read( FingerprintChunkSize ) );
+    return hash.result();
+}
+
+QByteArray PixmapDiskCache::key( const QByteArray &fingerprint, int page, int width, int height, const QString &renderSettings )
+{
+    QCryptographicHash hash( QCryptographicHash::Md5 );
+    hash.addData( fingerprint );
+    hash.addData( QString::fromLatin1( "%1:%2x%3:" ).arg( page ).arg( width ).arg( height ).toLatin1() );
+    hash.addData( renderSettings.toUtf8() );
+    return hash.result().toHex();
+}
+
+bool PixmapDiskCache::contains( const QByteArray &key )
+{
+    QMutexLocker locker( &m_mutex );
+    if ( !m_enabled || m_directory.isEmpty() )
+        return false;
+
+    loadIndex();
+    return m_entries.contains( key );
+}
+
+QImage PixmapDiskCache::find( const QByteArray &key )
+{
+    {
+        QMutexLocker locker( &m_mutex );
+        if ( !m_enabled || m_directory.isEmpty() )
+            return QImage();
+
+        loadIndex();
+        QHash< QByteArray, Entry >::iterator it = m_entries.find( key );
+        if ( it == m_entries.end() )
+            return QImage();
+
+        m_entriesByAccess.remove( it->lastAccess );
+        it->lastAccess = ++m_clock;
+        m_entriesByAccess.insert( it->lastAccess, key );
+    }
+
+    const QString name = fileName( key );
+    QImage image( name, "PNG" );
+    if ( image.isNull() )
+    {
+        QMutexLocker locker( &m_mutex );
+        removeEntry( key );
+        return image;
+    }
+
+    // keep the order of use for the next sessions
+    KDE::utime( name, 0 );
+    return image.convertToFormat( QImage::Format_ARGB32_Premultiplied );
+}
+
+void PixmapDiskCache::insert( const QByteArray &key, const QImage &image )
+{
+    if ( image.isNull() || !isEnabled() )
+        return;
+
+    QThreadPool::globalInstance()->start( new PixmapDiskCacheWriter( key, fileName( key ), image ) );
+}
+
+QString PixmapDiskCache::fileName( const QByteArray &key ) const
+{
+    return m_directory + QString::fromLatin1( key ) + QLatin1String( ".png" );
+}
+
+void PixmapDiskCache::loadIndex()
+{
+    if ( m_indexLoaded )
+        return;
+
+    m_indexLoaded = true;
+    if ( m_directory.isEmpty() )
+        return;
+
+    // oldest first, so that they get the lowest access stamps
+    const QFileInfoList files = QDir( m_directory ).entryInfoList( QStringList() << QLatin1String( "*.png" ), QDir::Files, QDir::Time | QDir::Reversed );
+    foreach ( const QFileInfo &info, files )
+        addEntry( info.completeBaseName().toLatin1(), info.size() );
+    trim();
+}
+
+void PixmapDiskCache::addEntry( const QByteArray &key, qulonglong size )
+{
+    removeEntry( key );
+
+    Entry entry;
+    entry.lastAccess = ++m_clock;
+    entry.size = size;
+    m_entries.insert( key, entry );
+    m_entriesByAccess.insert( entry.lastAccess, key );
+    m_size += size;
+}
+
+void PixmapDiskCache::removeEntry( const QByteArray &key )
+{
+    QHash< QByteArray, Entry >::iterator it = m_entries.find( key );
+    if ( it == m_entries.end() )
+        return;
+
+    m_entriesByAccess.remove( it->lastAccess );
+    m_size -= it->size;
+    m_entries.erase( it );
+}
+
+void PixmapDiskCache::trim()
+{
+    while ( m_size > m_maximumSize && !m_entriesByAccess.isEmpty() )
+    {
+        const QByteArray key = m_entriesByAccess.begin().value();
+        QFile::remove( fileName( key ) );
+        removeEntry( key );
+    }
+}
+
+/* kate: replace-tabs on; indent-width 4; */
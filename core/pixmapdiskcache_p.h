@@ -0,0 +1,109 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_PIXMAPDISKCACHE_P_H_
+#define _OKULAR_PIXMAPDISKCACHE_P_H_
+
+#include <QtCore/QByteArray>
+#include <QtCore/QHash>
+#include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+class QImage;
+
+namespace Okular {
+
+/**
+ * @short Keeps the rendered pages on disk across sessions.
+ *
+ * The pages are stored as PNG files in the KDE cache directory, named after
+ * a key made of a fingerprint of the document file, the page number, the
+ * size of the rendering and the settings that affect it. The pages are
+ * stored unrotated, as the generators render them. When the files take
+ * more than the maximum size, the least recently used ones are removed.
+ *
+ * contains(), find() and insert() can be called from the render threads.
+ */
+class PixmapDiskCache
+{
+    public:
+        static PixmapDiskCache *self();
+
+        PixmapDiskCache();
+
+        bool isEnabled() const;
+        void setEnabled( bool enabled );
+
+        /**
+         * Sets the maximum size of the cache, in bytes.
+         */
+        void setMaximumSize( qulonglong size );
+
+        /**
+         * Returns an identifier of the contents of the file @p fileName,
+         * or an empty array if it cannot be read. Only the size, the inode,
+         * the modification time and both ends of the file are looked at, so
+         * that large files are cheap to identify.
+         */
+        static QByteArray fileFingerprint( const QString &fileName );
+
+        /**
+         * Returns the key of the rendering of @p page of the document with
+         * the given @p fingerprint.
+         */
+        static QByteArray key( const QByteArray &fingerprint, int page, int width, int height, const QString &renderSettings );
+
+        /**
+         * Returns whether an image is stored for @p key.
+         */
+        bool contains( const QByteArray &key );
+
+        /**
+         * Returns the image stored for @p key, or a null image.
+         */
+        QImage find( const QByteArray &key );
+
+        /**
+         * Stores @p image for @p key. The image is written in the background.
+         */
+        void insert( const QByteArray &key, const QImage &image );
+
+    private:
+        friend class PixmapDiskCacheWriter;
+
+        struct Entry
+        {
+            qint64 lastAccess;
+            qulonglong size;
+        };
+
+        QString fileName( const QByteArray &key ) const;
+        // the following need m_mutex to be locked
+        void loadIndex();
+        void addEntry( const QByteArray &key, qulonglong size );
+        void removeEntry( const QByteArray &key );
+        void trim();
+
+        QString m_directory;
+        mutable QMutex m_mutex;
+        bool m_enabled;
+        bool m_indexLoaded;
+        qulonglong m_maximumSize;
+        qulonglong m_size;
+        qint64 m_clock;
+        QHash< QByteArray, Entry > m_entries;
+        QMap< qint64, QByteArray > m_entriesByAccess;
+};
+
+}
+
+#endif
+
+/* kate: replace-tabs on; indent-width 4; */
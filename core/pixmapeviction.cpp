@@ -0,0 +1,329 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "pixmapeviction_p.h"
+
+#include "observer.h"
+
+using namespace Okular;
+
+static inline bool canEvict( const AllocatedPixmap *pixmap, bool unloadableOnly )
+{
+    return !unloadableOnly || pixmap->observer->canUnloadPixmap( pixmap->page );
+}
+
+PixmapEvictionIndex::PixmapEvictionIndex()
+    : m_policy( Distance ), m_count( 0 ), m_clock( 0 ),
+      m_recentCount( 0 ), m_recentTarget( 0 ), m_recentGhosts( 0 )
+{
+}
+
+PixmapEvictionIndex::~PixmapEvictionIndex()
+{
+    clear();
+}
+
+PixmapEvictionIndex::Policy PixmapEvictionIndex::policy() const
+{
+    return m_policy;
+}
+
+void PixmapEvictionIndex::setPolicy( Policy policy )
+{
+    m_policy = policy;
+}
+
+bool PixmapEvictionIndex::isEmpty() const
+{
+    return m_count == 0;
+}
+
+int PixmapEvictionIndex::count() const
+{
+    return m_count;
+}
+
+void PixmapEvictionIndex::insert( AllocatedPixmap *pixmap )
+{
+    const Key key( pixmap->observer, pixmap->page );
+    QHash< Key, QPair< qint64, bool > >::iterator ghost = m_ghosts.find( key );
+
+    if ( pixmap->accessCount == 0 )
+    {
+        pixmap->accessCount = 1;
+        pixmap->lastAccess = ++m_clock;
+
+        // a pixmap evicted not long ago is wanted again: give more room to
+        // the list it was evicted from, and consider it frequently used
+        if ( ghost != m_ghosts.end() )
+        {
+            const int recentGhosts = m_recentGhosts;
+            const int frequentGhosts = m_ghosts.count() - m_recentGhosts;
+            if ( ghost->second )
+                m_recentTarget = qMax( 0, m_recentTarget - qMax( 1, recentGhosts / qMax( 1, frequentGhosts ) ) );
+            else
+                m_recentTarget = qMin( m_count + 1, m_recentTarget + qMax( 1, frequentGhosts / qMax( 1, recentGhosts ) ) );
+            pixmap->accessCount = 2;
+        }
+    }
+
+    if ( ghost != m_ghosts.end() )
+    {
+        if ( !ghost->second )
+            --m_recentGhosts;
+        m_ghostsByAge.remove( ghost->first );
+        m_ghosts.erase( ghost );
+    }
+
+    Bucket &bucket = m_buckets[ pixmap->observer ];
+    bucket.byPage.insert( pixmap->page, pixmap );
+    if ( pixmap->accessCount > 1 )
+    {
+        bucket.frequent.insert( pixmap->lastAccess, pixmap );
+    }
+    else
+    {
+        bucket.recent.insert( pixmap->lastAccess, pixmap );
+        ++m_recentCount;
+    }
+    ++m_count;
+}
+
+AllocatedPixmap *PixmapEvictionIndex::take( DocumentObserver *observer, int page )
+{
+    QHash< DocumentObserver *, Bucket >::const_iterator it = m_buckets.constFind( observer );
+    if ( it == m_buckets.constEnd() )
+        return 0;
+
+    AllocatedPixmap *pixmap = it->byPage.value( page );
+    if ( pixmap )
+        remove( pixmap );
+    return pixmap;
+}
+
+QList< AllocatedPixmap * > PixmapEvictionIndex::takeAll( DocumentObserver *observer )
+{
+    const QList< AllocatedPixmap * > pixmaps = m_buckets.value( observer ).byPage.values();
+    foreach ( AllocatedPixmap *pixmap, pixmaps )
+        remove( pixmap );
+    return pixmaps;
+}
+
+void PixmapEvictionIndex::clear()
+{
+    QHash< DocumentObserver *, Bucket >::const_iterator it = m_buckets.constBegin(), itEnd = m_buckets.constEnd();
+    for ( ; it != itEnd; ++it )
+        qDeleteAll( it->byPage );
+    m_buckets.clear();
+    m_count = 0;
+    m_recentCount = 0;
+    m_recentTarget = 0;
+    m_ghosts.clear();
+    m_ghostsByAge.clear();
+    m_recentGhosts = 0;
+}
+
+void PixmapEvictionIndex::touch( DocumentObserver *observer, int page )
+{
+    QHash< DocumentObserver *, Bucket >::iterator it = m_buckets.find( observer );
+    if ( it == m_buckets.end() )
+        return;
+
+    AllocatedPixmap *pixmap = it->byPage.value( page );
+    if ( !pixmap )
+        return;
+
+    if ( pixmap->accessCount > 1 )
+    {
+        it->frequent.remove( pixmap->lastAccess );
+    }
+    else
+    {
+        it->recent.remove( pixmap->lastAccess );
+        --m_recentCount;
+    }
+    ++pixmap->accessCount;
+    pixmap->lastAccess = ++m_clock;
+    it->frequent.insert( pixmap->lastAccess, pixmap );
+}
+
+AllocatedPixmap *PixmapEvictionIndex::victim( int currentPage, bool unloadableOnly, DocumentObserver *observer ) const
+{
+    AllocatedPixmap *selected = 0;
+    QHash< DocumentObserver *, Bucket >::const_iterator it = m_buckets.constBegin(), itEnd = m_buckets.constEnd();
+    for ( ; it != itEnd; ++it )
+    {
+        // Filter by observer
+        if ( observer && it.key() != observer )
+            continue;
+
+        AllocatedPixmap *candidate = bucketVictim( *it, currentPage, unloadableOnly );
+        if ( candidate && ( !selected || isBetterVictim( candidate, selected, currentPage ) ) )
+            selected = candidate;
+    }
+    return selected;
+}
+
+AllocatedPixmap *PixmapEvictionIndex::takeVictim( int currentPage, bool unloadableOnly, DocumentObserver *observer )
+{
+    AllocatedPixmap *pixmap = victim( currentPage, unloadableOnly, observer );
+    if ( pixmap )
+    {
+        remove( pixmap );
+        addGhost( pixmap );
+    }
+    return pixmap;
+}
+
+AllocatedPixmap *PixmapEvictionIndex::bucketVictim( const Bucket &bucket, int currentPage, bool unloadableOnly ) const
+{
+    switch ( m_policy )
+    {
+        case Distance:
+        {
+            // the farthest pixmap is at one of the ends of the page index,
+            // move inwards only past the pixmaps that cannot be unloaded
+            QMap< int, AllocatedPixmap * >::const_iterator first = bucket.byPage.constBegin();
+            QMap< int, AllocatedPixmap * >::const_iterator end = bucket.byPage.constEnd();
+            while ( first != end )
+            {
+                QMap< int, AllocatedPixmap * >::const_iterator last = end;
+                --last;
+                if ( qAbs( last.key() - currentPage ) >= qAbs( first.key() - currentPage ) )
+                {
+                    if ( canEvict( *last, unloadableOnly ) )
+                        return *last;
+                    end = last;
+                }
+                else
+                {
+                    if ( canEvict( *first, unloadableOnly ) )
+                        return *first;
+                    ++first;
+                }
+            }
+            return 0;
+        }
+
+        case LeastRecentlyUsed:
+        {
+            AllocatedPixmap *recent = lruVictim( bucket.recent, unloadableOnly );
+            AllocatedPixmap *frequent = lruVictim( bucket.frequent, unloadableOnly );
+            if ( !recent || !frequent )
+                return recent ? recent : frequent;
+            return recent->lastAccess < frequent->lastAccess ? recent : frequent;
+        }
+
+        case Adaptive:
+        {
+            const bool recentFirst = preferRecent();
+            AllocatedPixmap *pixmap = lruVictim( recentFirst ? bucket.recent : bucket.frequent, unloadableOnly );
+            if ( !pixmap )
+                pixmap = lruVictim( recentFirst ? bucket.frequent : bucket.recent, unloadableOnly );
+            return pixmap;
+        }
+    }
+    return 0;
+}
+
+AllocatedPixmap *PixmapEvictionIndex::lruVictim( const QMap< qint64, AllocatedPixmap * > &list, bool unloadableOnly ) const
+{
+    QMap< qint64, AllocatedPixmap * >::const_iterator it = list.constBegin(), itEnd = list.constEnd();
+    for ( ; it != itEnd; ++it )
+    {
+        if ( canEvict( *it, unloadableOnly ) )
+            return *it;
+    }
+    return 0;
+}
+
+bool PixmapEvictionIndex::isBetterVictim( const AllocatedPixmap *a, const AllocatedPixmap *b, int currentPage ) const
+{
+    switch ( m_policy )
+    {
+        case Distance:
+            return qAbs( a->page - currentPage ) > qAbs( b->page - currentPage );
+
+        case LeastRecentlyUsed:
+            return a->lastAccess < b->lastAccess;
+
+        case Adaptive:
+        {
+            const bool recentFirst = preferRecent();
+            const bool aPreferred = ( a->accessCount <= 1 ) == recentFirst;
+            const bool bPreferred = ( b->accessCount <= 1 ) == recentFirst;
+            if ( aPreferred != bPreferred )
+                return aPreferred;
+            return a->lastAccess < b->lastAccess;
+        }
+    }
+    return false;
+}
+
+bool PixmapEvictionIndex::preferRecent() const
+{
+    return m_recentCount > m_recentTarget;
+}
+
+void PixmapEvictionIndex::remove( AllocatedPixmap *pixmap )
+{
+    QHash< DocumentObserver *, Bucket >::iterator it = m_buckets.find( pixmap->observer );
+    if ( it == m_buckets.end() )
+        return;
+
+    it->byPage.remove( pixmap->page );
+    if ( pixmap->accessCount > 1 )
+    {
+        it->frequent.remove( pixmap->lastAccess );
+    }
+    else
+    {
+        it->recent.remove( pixmap->lastAccess );
+        --m_recentCount;
+    }
+    --m_count;
+
+    if ( it->byPage.isEmpty() )
+        m_buckets.erase( it );
+}
+
+void PixmapEvictionIndex::addGhost( const AllocatedPixmap *pixmap )
+{
+    const Key key( pixmap->observer, pixmap->page );
+    const bool frequent = pixmap->accessCount > 1;
+    const qint64 age = ++m_clock;
+    QHash< Key, QPair< qint64, bool > >::iterator previous = m_ghosts.find( key );
+    if ( previous != m_ghosts.end() )
+    {
+        if ( !previous->second )
+            --m_recentGhosts;
+        m_ghostsByAge.remove( previous->first );
+        m_ghosts.erase( previous );
+    }
+    m_ghosts.insert( key, qMakePair( age, frequent ) );
+    m_ghostsByAge.insert( age, key );
+    if ( !frequent )
+        ++m_recentGhosts;
+
+    // remember about as many evicted pixmaps as there are cached ones
+    while ( m_ghosts.count() > qMax( m_count, 16 ) )
+    {
+        QMap< qint64, Key >::iterator oldest = m_ghostsByAge.begin();
+        QHash< Key, QPair< qint64, bool > >::iterator ghost = m_ghosts.find( *oldest );
+        if ( ghost != m_ghosts.end() )
+        {
+            if ( !ghost->second )
+                --m_recentGhosts;
+            m_ghosts.erase( ghost );
+        }
+        m_ghostsByAge.erase( oldest );
+    }
+}
+
+/* kate: replace-tabs on; indent-width 4; */
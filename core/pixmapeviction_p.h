@@ -0,0 +1,150 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_PIXMAPEVICTION_P_H_
+#define _OKULAR_PIXMAPEVICTION_P_H_
+
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QMap>
+#include <QtCore/QPair>
+
+namespace Okular {
+class DocumentObserver;
+}
+
+struct AllocatedPixmap
+{
+    // owner of the page
+    Okular::DocumentObserver *observer;
+    int page;
+    qulonglong memory;
+    // access bookkeeping, maintained by PixmapEvictionIndex
+    qint64 lastAccess;
+    int accessCount;
+    // public constructor: initialize data
+    AllocatedPixmap( Okular::DocumentObserver *o, int p, qulonglong m ) : observer( o ), page( p ), memory( m ), lastAccess( 0 ), accessCount( 0 ) {}
+};
+
+namespace Okular {
+
+/**
+ * @short Index of the allocated pixmaps, used to choose which one to evict.
+ *
+ * The pixmaps of each observer are indexed both by page number and by last
+ * access, so that finding the pixmap to evict does not need to look at every
+ * allocated pixmap:
+ * - Distance: the pixmap farthest from the current page is evicted; it is
+ *   always at one of the ends of the page index.
+ * - LeastRecentlyUsed: the pixmap that was not used for the longest time is
+ *   evicted.
+ * - Adaptive: ARC-like policy; pixmaps used once and pixmaps used several
+ *   times are kept in two LRU lists, and the share of the cache given to
+ *   each list adapts itself when recently evicted pixmaps are requested again.
+ *
+ * The index owns the AllocatedPixmap descriptors it holds.
+ */
+class PixmapEvictionIndex
+{
+    public:
+        enum Policy
+        {
+            Distance,
+            LeastRecentlyUsed,
+            Adaptive
+        };
+
+        PixmapEvictionIndex();
+        ~PixmapEvictionIndex();
+
+        Policy policy() const;
+        void setPolicy( Policy policy );
+
+        bool isEmpty() const;
+        int count() const;
+
+        /**
+         * Adds @p pixmap to the index. A pixmap that was never indexed before
+         * counts as a new access, one that was taken out of the index and is
+         * put back keeps its access history.
+         */
+        void insert( AllocatedPixmap *pixmap );
+
+        /**
+         * Removes and returns the pixmap of @p observer for @p page, if any.
+         */
+        AllocatedPixmap *take( Okular::DocumentObserver *observer, int page );
+
+        /**
+         * Removes and returns all the pixmaps of @p observer.
+         */
+        QList< AllocatedPixmap * > takeAll( Okular::DocumentObserver *observer );
+
+        /**
+         * Deletes all the pixmap descriptors.
+         */
+        void clear();
+
+        /**
+         * Marks the pixmap of @p observer for @p page as used.
+         */
+        void touch( Okular::DocumentObserver *observer, int page );
+
+        /**
+         * Returns the pixmap that should be evicted first according to the
+         * policy, or 0 if there is none. If @p unloadableOnly is set only the
+         * pixmaps the observers allow to unload are considered, if
+         * @p observer is not null only the pixmaps of that observer are.
+         */
+        AllocatedPixmap *victim( int currentPage, bool unloadableOnly, Okular::DocumentObserver *observer = 0 ) const;
+
+        /**
+         * Like victim(), but the pixmap is also removed from the index and
+         * remembered as evicted.
+         */
+        AllocatedPixmap *takeVictim( int currentPage, bool unloadableOnly, Okular::DocumentObserver *observer = 0 );
+
+    private:
+        typedef QPair< Okular::DocumentObserver *, int > Key;
+
+        struct Bucket
+        {
+            QMap< int, AllocatedPixmap * > byPage;
+            // pixmaps used once and more than once, by last access
+            QMap< qint64, AllocatedPixmap * > recent;
+            QMap< qint64, AllocatedPixmap * > frequent;
+        };
+
+        AllocatedPixmap *bucketVictim( const Bucket &bucket, int currentPage, bool unloadableOnly ) const;
+        AllocatedPixmap *lruVictim( const QMap< qint64, AllocatedPixmap * > &list, bool unloadableOnly ) const;
+        bool isBetterVictim( const AllocatedPixmap *a, const AllocatedPixmap *b, int currentPage ) const;
+        bool preferRecent() const;
+        void remove( AllocatedPixmap *pixmap );
+        void addGhost( const AllocatedPixmap *pixmap );
+
+        QHash< Okular::DocumentObserver *, Bucket > m_buckets;
+        Policy m_policy;
+        int m_count;
+        qint64 m_clock;
+
+        // adaptive policy: pixmaps in the 'recent' lists, their target
+        // number and the recently evicted pixmaps (with whether they
+        // were in the 'frequent' lists)
+        int m_recentCount;
+        int m_recentTarget;
+        QHash< Key, QPair< qint64, bool > > m_ghosts;
+        QMap< qint64, Key > m_ghostsByAge;
+        int m_recentGhosts;
+};
+
+}
+
+#endif
+
+/* kate: replace-tabs on; indent-width 4; */
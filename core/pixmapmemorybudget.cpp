@@ -0,0 +1,89 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "pixmapmemorybudget_p.h"
+
+#include <kglobal.h>
+
+#include "document_p.h"
+
+using namespace Okular;
+
+K_GLOBAL_STATIC( PixmapMemoryBudget, s_pixmapMemoryBudget )
+
+PixmapMemoryBudget *PixmapMemoryBudget::self()
+{
+    // documents destroyed after the application shutdown have nothing to share
+    if ( s_pixmapMemoryBudget.isDestroyed() )
+        return 0;
+    return s_pixmapMemoryBudget;
+}
+
+PixmapMemoryBudget::PixmapMemoryBudget()
+{
+}
+
+void PixmapMemoryBudget::registerDocument( DocumentPrivate *document )
+{
+    if ( !m_documents.contains( document ) )
+        m_documents.append( document );
+}
+
+void PixmapMemoryBudget::unregisterDocument( DocumentPrivate *document )
+{
+    m_documents.removeAll( document );
+}
+
+void PixmapMemoryBudget::touch( DocumentPrivate *document )
+{
+    // already the most recently used one, the common case
+    if ( !m_documents.isEmpty() && m_documents.last() == document )
+        return;
+
+    if ( m_documents.removeOne( document ) )
+        m_documents.append( document );
+}
+
+qulonglong PixmapMemoryBudget::totalMemory() const
+{
+    qulonglong memory = 0;
+    foreach ( const DocumentPrivate *document, m_documents )
+        memory += document->m_allocatedPixmapsTotalMemory;
+    return memory;
+}
+
+qulonglong PixmapMemoryBudget::reclaimableMemory( const DocumentPrivate *document ) const
+{
+    qulonglong memory = 0;
+    foreach ( const DocumentPrivate *other, m_documents )
+    {
+        if ( other == document )
+            break;
+        memory += other->m_allocatedPixmapsTotalMemory;
+    }
+    return memory;
+}
+
+qulonglong PixmapMemoryBudget::reclaim( const DocumentPrivate *document, qulonglong memoryToFree )
+{
+    // evicting pixmaps does not touch the documents, so the list is stable
+    QList< DocumentPrivate * >::const_iterator it = m_documents.constBegin(), itEnd = m_documents.constEnd();
+    for ( ; it != itEnd && memoryToFree > 0; ++it )
+    {
+        DocumentPrivate *other = *it;
+        if ( other == document )
+            break;
+
+        const qulonglong freed = other->evictPixmaps( memoryToFree );
+        memoryToFree = freed < memoryToFree ? memoryToFree - freed : 0;
+    }
+    return memoryToFree;
+}
+
+/* kate: replace-tabs on; indent-width 4; */
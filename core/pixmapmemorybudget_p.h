@@ -0,0 +1,71 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_PIXMAPMEMORYBUDGET_P_H_
+#define _OKULAR_PIXMAPMEMORYBUDGET_P_H_
+
+#include <QtCore/QList>
+
+namespace Okular {
+
+class DocumentPrivate;
+
+/**
+ * @short Accounts the pixmap memory of all the documents of the process.
+ *
+ * Every document registers itself here, so that the memory profiles apply
+ * to the pixmaps of all the open documents (e.g. the tabs of the shell) as a
+ * whole instead of to each of them separately.
+ *
+ * The documents are kept from the least to the most recently used one; when a
+ * document needs to free memory, the documents that were used before it give
+ * their pixmaps back first.
+ */
+class PixmapMemoryBudget
+{
+    public:
+        static PixmapMemoryBudget *self();
+
+        PixmapMemoryBudget();
+
+        void registerDocument( DocumentPrivate *document );
+        void unregisterDocument( DocumentPrivate *document );
+
+        /**
+         * Marks @p document as the most recently used one.
+         */
+        void touch( DocumentPrivate *document );
+
+        /**
+         * The pixmap memory allocated by all the documents.
+         */
+        qulonglong totalMemory() const;
+
+        /**
+         * The pixmap memory allocated by the documents used before
+         * @p document.
+         */
+        qulonglong reclaimableMemory( const DocumentPrivate *document ) const;
+
+        /**
+         * Frees up to @p memoryToFree bytes from the documents used before
+         * @p document, the least recently used first, and returns the
+         * amount that is still to be freed.
+         */
+        qulonglong reclaim( const DocumentPrivate *document, qulonglong memoryToFree );
+
+    private:
+        QList< DocumentPrivate * > m_documents;
+};
+
+}
+
+#endif
+
+/* kate: replace-tabs on; indent-width 4; */
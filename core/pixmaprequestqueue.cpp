@@ -0,0 +1,283 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "pixmaprequestqueue_p.h"
+
+#include "generator.h"
+
+using namespace Okular;
+
+PixmapRequestQueue::PixmapRequestQueue()
+    : m_order( 0 )
+{
+    m_clock.start();
+    resetStatistics();
+}
+
+PixmapRequestQueue::~PixmapRequestQueue()
+{
+    qDeleteAll( m_heap );
+}
+
+bool PixmapRequestQueue::isEmpty() const
+{
+    return m_heap.isEmpty();
+}
+
+int PixmapRequestQueue::count() const
+{
+    return m_heap.count();
+}
+
+PixmapRequest *PixmapRequestQueue::enqueue( PixmapRequest *request )
+{
+    PixmapRequest *replaced = take( request->observer(), request->pageNumber() );
+
+    Entry *entry = new Entry;
+    entry->request = request;
+    // priority zero requests are served newest first, the others oldest first
+    ++m_order;
+    entry->order = request->priority() == 0 ? -m_order : m_order;
+    entry->enqueueTime = m_clock.elapsed();
+    entry->index = m_heap.count();
+
+    m_heap.append( entry );
+    m_entries.insert( request, entry );
+    m_index[ request->observer() ].insert( request->pageNumber(), entry );
+    siftUp( entry->index );
+
+    m_maximumCount = qMax( m_maximumCount, m_heap.count() );
+
+    return replaced;
+}
+
+PixmapRequest *PixmapRequestQueue::top() const
+{
+    return m_heap.isEmpty() ? 0 : m_heap.first()->request;
+}
+
+PixmapRequest *PixmapRequestQueue::top( const QSet< PixmapRequest * > &skipped ) const
+{
+    if ( skipped.isEmpty() )
+        return top();
+
+    // visit the heap in priority order: the next request is always among the
+    // children of the requests skipped so far
+    QList< const Entry * > candidates;
+    if ( !m_heap.isEmpty() )
+        candidates.append( m_heap.first() );
+    while ( !candidates.isEmpty() )
+    {
+        int best = 0;
+        for ( int i = 1; i < candidates.count(); ++i )
+        {
+            if ( lessThan( candidates.at( i ), candidates.at( best ) ) )
+                best = i;
+        }
+
+        const Entry *entry = candidates.takeAt( best );
+        if ( !skipped.contains( entry->request ) )
+            return entry->request;
+
+        const int left = 2 * entry->index + 1;
+        if ( left < m_heap.count() )
+            candidates.append( m_heap.at( left ) );
+        if ( left + 1 < m_heap.count() )
+            candidates.append( m_heap.at( left + 1 ) );
+    }
+    return 0;
+}
+
+PixmapRequest *PixmapRequestQueue::takeTop()
+{
+    if ( m_heap.isEmpty() )
+        return 0;
+
+    PixmapRequest *request = m_heap.first()->request;
+    removeEntry( m_heap.first() );
+    return request;
+}
+
+bool PixmapRequestQueue::remove( PixmapRequest *request )
+{
+    Entry *entry = m_entries.value( request );
+    if ( !entry )
+        return false;
+
+    removeEntry( entry );
+    return true;
+}
+
+bool PixmapRequestQueue::dispatch( PixmapRequest *request )
+{
+    Entry *entry = m_entries.value( request );
+    if ( !entry )
+        return false;
+
+    const qint64 waitTime = m_clock.elapsed() - entry->enqueueTime;
+    ++m_dispatchedCount;
+    m_totalWaitTime += waitTime;
+    m_maximumWaitTime = qMax( m_maximumWaitTime, waitTime );
+
+    removeEntry( entry );
+    return true;
+}
+
+PixmapRequest *PixmapRequestQueue::take( DocumentObserver *observer, int pageNumber )
+{
+    Entry *entry = entryFor( observer, pageNumber );
+    if ( !entry )
+        return 0;
+
+    PixmapRequest *request = entry->request;
+    removeEntry( entry );
+    return request;
+}
+
+QList< PixmapRequest * > PixmapRequestQueue::takeAll( DocumentObserver *observer )
+{
+    QList< PixmapRequest * > requests;
+    const QHash< int, Entry * > entries = m_index.value( observer );
+    QHash< int, Entry * >::const_iterator it = entries.constBegin(), itEnd = entries.constEnd();
+    for ( ; it != itEnd; ++it )
+    {
+        requests.append( (*it)->request );
+        removeEntry( *it );
+    }
+    return requests;
+}
+
+QList< PixmapRequest * > PixmapRequestQueue::takeAll()
+{
+    QList< PixmapRequest * > requests;
+    foreach ( Entry *entry, m_heap )
+    {
+        requests.append( entry->request );
+        delete entry;
+    }
+    m_heap.clear();
+    m_entries.clear();
+    m_index.clear();
+    return requests;
+}
+
+int PixmapRequestQueue::maximumCount() const
+{
+    return m_maximumCount;
+}
+
+int PixmapRequestQueue::dispatchedCount() const
+{
+    return m_dispatchedCount;
+}
+
+qint64 PixmapRequestQueue::averageWaitTime() const
+{
+    return m_dispatchedCount > 0 ? m_totalWaitTime / m_dispatchedCount : 0;
+}
+
+qint64 PixmapRequestQueue::maximumWaitTime() const
+{
+    return m_maximumWaitTime;
+}
+
+void PixmapRequestQueue::resetStatistics()
+{
+    m_maximumCount = m_heap.count();
+    m_dispatchedCount = 0;
+    m_totalWaitTime = 0;
+    m_maximumWaitTime = 0;
+}
+
+bool PixmapRequestQueue::lessThan( const Entry *a, const Entry *b )
+{
+    const int priorityA = a->request->priority();
+    const int priorityB = b->request->priority();
+    if ( priorityA != priorityB )
+        return priorityA < priorityB;
+    return a->order < b->order;
+}
+
+void PixmapRequestQueue::swapEntries( int i, int j )
+{
+    qSwap( m_heap[ i ], m_heap[ j ] );
+    m_heap[ i ]->index = i;
+    m_heap[ j ]->index = j;
+}
+
+void PixmapRequestQueue::siftUp( int i )
+{
+    while ( i > 0 )
+    {
+        const int parent = ( i - 1 ) / 2;
+        if ( !lessThan( m_heap.at( i ), m_heap.at( parent ) ) )
+            break;
+        swapEntries( i, parent );
+        i = parent;
+    }
+}
+
+void PixmapRequestQueue::siftDown( int i )
+{
+    const int count = m_heap.count();
+    while ( true )
+    {
+        const int left = 2 * i + 1;
+        const int right = left + 1;
+        int smallest = i;
+        if ( left < count && lessThan( m_heap.at( left ), m_heap.at( smallest ) ) )
+            smallest = left;
+        if ( right < count && lessThan( m_heap.at( right ), m_heap.at( smallest ) ) )
+            smallest = right;
+        if ( smallest == i )
+            break;
+        swapEntries( i, smallest );
+        i = smallest;
+    }
+}
+
+PixmapRequestQueue::Entry *PixmapRequestQueue::entryFor( DocumentObserver *observer, int pageNumber ) const
+{
+    QHash< DocumentObserver *, QHash< int, Entry * > >::const_iterator it = m_index.constFind( observer );
+    if ( it == m_index.constEnd() )
+        return 0;
+    return it->value( pageNumber );
+}
+
+void PixmapRequestQueue::removeEntry( Entry *entry )
+{
+    const int index = entry->index;
+    const int last = m_heap.count() - 1;
+    if ( index != last )
+    {
+        swapEntries( index, last );
+        m_heap.removeLast();
+        // the entry moved in its place may belong either up or down
+        Entry *moved = m_heap.at( index );
+        siftUp( index );
+        siftDown( moved->index );
+    }
+    else
+    {
+        m_heap.removeLast();
+    }
+
+    m_entries.remove( entry->request );
+    QHash< DocumentObserver *, QHash< int, Entry * > >::iterator it = m_index.find( entry->request->observer() );
+    if ( it != m_index.end() )
+    {
+        it->remove( entry->request->pageNumber() );
+        if ( it->isEmpty() )
+            m_index.erase( it );
+    }
+
+    delete entry;
+}
+
+/* kate: replace-tabs on; indent-width 4; */
@@ -0,0 +1,149 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_PIXMAPREQUESTQUEUE_P_H_
+#define _OKULAR_PIXMAPREQUESTQUEUE_P_H_
+
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QSet>
+#include <QtCore/QVector>
+
+namespace Okular {
+
+class DocumentObserver;
+class PixmapRequest;
+
+/**
+ * @short Priority queue of the pixmap requests waiting for the generator.
+ *
+ * Requests are kept in a binary heap ordered by priority (lower values
+ * first). Among requests with the same non-zero priority the oldest one comes
+ * first, among priority zero (i.e. synchronous) requests the newest one does,
+ * as it used to be with the old request stack.
+ *
+ * Requests are also indexed by observer and page number, so that adding,
+ * replacing and removing a request costs O(log n).
+ *
+ * The queue does not own the requests, and it is not thread safe: the caller
+ * is in charge of locking.
+ */
+class PixmapRequestQueue
+{
+    public:
+        PixmapRequestQueue();
+        ~PixmapRequestQueue();
+
+        bool isEmpty() const;
+        int count() const;
+
+        /**
+         * Adds @p request to the queue.
+         *
+         * If a request for the same observer and page is already queued it is
+         * taken out of the queue and returned, so that the caller can delete it.
+         */
+        PixmapRequest *enqueue( PixmapRequest *request );
+
+        /**
+         * Returns the request to process next, or 0 if the queue is empty.
+         */
+        PixmapRequest *top() const;
+
+        /**
+         * Returns the request to process next which is not in @p skipped, or 0
+         * if there is none.
+         */
+        PixmapRequest *top( const QSet< PixmapRequest * > &skipped ) const;
+
+        /**
+         * Removes and returns the request to process next.
+         */
+        PixmapRequest *takeTop();
+
+        /**
+         * Removes @p request from the queue, returns whether it was queued.
+         */
+        bool remove( PixmapRequest *request );
+
+        /**
+         * Removes @p request from the queue as it is being handed to the
+         * generator, accounting the time it waited in the queue.
+         */
+        bool dispatch( PixmapRequest *request );
+
+        /**
+         * Removes and returns the request of @p observer for the page
+         * @p pageNumber, or 0 if there is none.
+         */
+        PixmapRequest *take( DocumentObserver *observer, int pageNumber );
+
+        /**
+         * Removes and returns all the requests of @p observer.
+         */
+        QList< PixmapRequest * > takeAll( DocumentObserver *observer );
+
+        /**
+         * Removes and returns all the requests.
+         */
+        QList< PixmapRequest * > takeAll();
+
+        /**
+         * The maximum number of requests that have been queued at the same time.
+         */
+        int maximumCount() const;
+
+        /**
+         * The number of requests that have been dispatched.
+         */
+        int dispatchedCount() const;
+
+        /**
+         * The average and maximum time (in milliseconds) the dispatched
+         * requests waited in the queue.
+         */
+        qint64 averageWaitTime() const;
+        qint64 maximumWaitTime() const;
+
+        void resetStatistics();
+
+    private:
+        struct Entry
+        {
+            PixmapRequest *request;
+            qint64 order;
+            qint64 enqueueTime;
+            int index;
+        };
+
+        static bool lessThan( const Entry *a, const Entry *b );
+        void swapEntries( int i, int j );
+        void siftUp( int i );
+        void siftDown( int i );
+        Entry *entryFor( DocumentObserver *observer, int pageNumber ) const;
+        void removeEntry( Entry *entry );
+
+        QVector< Entry * > m_heap;
+        QHash< PixmapRequest *, Entry * > m_entries;
+        QHash< DocumentObserver *, QHash< int, Entry * > > m_index;
+        qint64 m_order;
+
+        QElapsedTimer m_clock;
+        int m_maximumCount;
+        int m_dispatchedCount;
+        qint64 m_totalWaitTime;
+        qint64 m_maximumWaitTime;
+};
+
+}
+
+#endif
+
+/* kate: replace-tabs on; indent-width 4; */
@@ -58,6 +58,38 @@ TextDocumentGenerator* TextDocumentConverter::generator() const
 /**
  * Generic Generator Implementation
  */
+void TextDocumentGeneratorPrivate::calculatePositions( int page, int &start, int &end ) const
+{
+    if ( page < 0 || page >= mPagePositions.count() )
+    {
+        TextDocumentUtils::calculatePositions( mDocument, page, start, end );
+        return;
+    }
+
+    QPair< int, int > &positions = mPagePositions[ page ];
+    if ( positions.first < 0 )
+        TextDocumentUtils::calculatePositions( mDocument, page, positions.first, positions.second );
+    start = positions.first;
+    end = positions.second;
+}
+
+// the line of the layout holding the position, looked for from the line
+// @p hint on, as the positions are visited in order
+static QTextLine lineForPosition( const QTextLayout *layout, int position, int *hint )
+{
+    const int count = layout->lineCount();
+    for ( int i = *hint; i < count; ++i )
+    {
+        const QTextLine line = layout->lineAt( i );
+        if ( line.textStart() + line.textLength() > position )
+        {
+            *hint = i;
+            return line;
+        }
+    }
+    return layout->lineForTextPosition( position );
+}
+
 Okular::TextPage* TextDocumentGeneratorPrivate::createTextPage( int pageNumber ) const
 {
 #ifdef OKULAR_TEXTDOCUMENT_THREADED_RENDERING
@@ -71,24 +103,85 @@ Okular::TextPage* TextDocumentGeneratorPrivate::createTextPage( int pageNumber )
 #ifdef OKULAR_TEXTDOCUMENT_THREADED_RENDERING
     q->userMutex()->lock();
 #endif
-    TextDocumentUtils::calculatePositions( mDocument, pageNumber, start, end );
-
+    calculatePositions( pageNumber, start, end );
+
+    // walk the lines of the blocks of the page, each character gets the
+    // box between its position and the next one, or a line break if the
+    // next position is on another line
+    const QAbstractTextDocumentLayout *documentLayout = mDocument->documentLayout();
+    const QSizeF pageSize = mDocument->pageSize();
+    const int pageHeight = qMax( 1, qRound( pageSize.height() ) );
+    const int last = end - 1;
+
+    QTextBlock block = mDocument->findBlock( start );
+    QRectF blockRect;
+    if ( block.isValid() )
+        blockRect = documentLayout->blockBoundingRect( block );
+
+    while ( block.isValid() && block.position() < last )
     {
-    QTextCursor cursor( mDocument );
-    for ( int i = start; i < end - 1; ++i ) {
-        cursor.setPosition( i );
-        cursor.setPosition( i + 1, QTextCursor::KeepAnchor );
-
-        QString text = cursor.selectedText();
-        if ( text.length() == 1 ) {
-            QRectF rect;
-            TextDocumentUtils::calculateBoundingRect( mDocument, i, i + 1, rect, pageNumber );
-            if ( pageNumber == -1 )
-                text = "\n";
-
-            textPage->append( text, new Okular::NormalizedRect( rect.left(), rect.top(), rect.right(), rect.bottom() ) );
+        const QTextBlock nextBlock = block.next();
+        QRectF nextBlockRect;
+        if ( nextBlock.isValid() )
+            nextBlockRect = documentLayout->blockBoundingRect( nextBlock );
+
+        const QTextLayout *layout = block.layout();
+        const QTextLayout *nextLayout = nextBlock.isValid() ? nextBlock.layout() : 0;
+        const QString text = block.text();
+        const int blockPosition = block.position();
+        const int from = qMax( start, blockPosition ) - blockPosition;
+        const int to = qMin( last, blockPosition + block.length() ) - blockPosition;
+
+        int lineHint = 0;
+        int cachedPosition = -1, cachedLine = -1;
+        qreal cachedX = 0;
+        for ( int pos = from; pos < to; ++pos )
+        {
+            // the block separator is not part of the text of the block
+            const QChar c = pos < text.length() ? text.at( pos ) : mDocument->characterAt( blockPosition + pos );
+            const bool separator = pos + 1 > text.length();
+            const QTextLayout *endLayout = separator ? nextLayout : layout;
+
+            if ( !layout || !endLayout )
+            {
+                kWarning() << "Start or end layout not found" << layout << endLayout;
+                textPage->append( "\n", new Okular::NormalizedRect( 0, 0, 0, 0 ) );
+                continue;
+            }
+
+            const QTextLine startLine = lineForPosition( layout, pos, &lineHint );
+            int endHint = lineHint;
+            const QTextLine endLine = separator ? nextLayout->lineForTextPosition( 0 )
+                                                : lineForPosition( layout, pos + 1, &endHint );
+            const QRectF &endBlockRect = separator ? nextBlockRect : blockRect;
+
+            const bool cached = pos == cachedPosition && startLine.lineNumber() == cachedLine;
+            const double x = blockRect.x() + ( cached ? cachedX : startLine.cursorToX( pos ) );
+            const qreal endX = endLine.cursorToX( separator ? 0 : pos + 1 );
+            const double r = endBlockRect.x() + endX;
+            const double y = blockRect.y() + startLine.y();
+            const double b = endBlockRect.y() + endLine.y() + endLine.height();
+
+            // the next character starts where this one ends, if on the same line
+            cachedPosition = separator ? -1 : pos + 1;
+            cachedLine = endLine.lineNumber();
+            cachedX = endX;
+
+            const int offset = qRound( y ) % pageHeight;
+            if ( x > r )
+            {
+                // line break, so add a pseudo character on the start line
+                textPage->append( "\n", new Okular::NormalizedRect( x / pageSize.width(), offset / pageSize.height(),
+                                                                    ( x + 3 ) / pageSize.width(), ( offset + startLine.height() ) / pageSize.height() ) );
+                continue;
+            }
+
+            textPage->append( QString( c ), new Okular::NormalizedRect( x / pageSize.width(), offset / pageSize.height(),
+                                                                        r / pageSize.width(), ( offset + b - y ) / pageSize.height() ) );
         }
-    }
+
+        block = nextBlock;
+        blockRect = nextBlockRect;
     }
 #ifdef OKULAR_TEXTDOCUMENT_THREADED_RENDERING
     q->userMutex()->unlock();
@@ -299,6 +392,7 @@ bool TextDocumentGenerator::loadDocument( const QString & fileName, QVector<Okul
     d->generateAnnotationInfos();
 
     pagesVector.resize( d->mDocument->pageCount() );
+    d->mPagePositions.fill( qMakePair( -1, -1 ), d->mDocument->pageCount() );
 
     const QSize size = d->mDocument->pageSize().toSize();
 
@@ -348,6 +442,7 @@ bool TextDocumentGenerator::doCloseDocument()
     d->mLinkInfos.clear();
     d->mAnnotationPositions.clear();
     d->mAnnotationInfos.clear();
+    d->mPagePositions.clear();
     // do not use clear() for the following two, otherwise they change type
     d->mDocumentInfo = Okular::DocumentInfo();
     d->mDocumentSynopsis = Okular::DocumentSynopsis();
@@ -393,7 +488,12 @@ QImage TextDocumentGeneratorPrivate::image( PixmapRequest * request )
 #ifdef OKULAR_TEXTDOCUMENT_THREADED_RENDERING
     q->userMutex()->lock();
 #endif
-    mDocument->setDefaultFont( mFont );
+    if ( mDocument->defaultFont() != mFont )
+    {
+        // the text is laid out again, the pages start elsewhere
+        mPagePositions.fill( qMakePair( -1, -1 ) );
+        mDocument->setDefaultFont( mFont );
+    }
     mDocument->drawContents( &p, rect );
 #ifdef OKULAR_TEXTDOCUMENT_THREADED_RENDERING
     q->userMutex()->unlock();
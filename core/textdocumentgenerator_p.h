@@ -10,6 +10,8 @@
 #ifndef _OKULAR_TEXTDOCUMENTGENERATOR_P_H_
 #define _OKULAR_TEXTDOCUMENTGENERATOR_P_H_
 
+#include <QtCore/QPair>
+#include <QtCore/QVector>
 #include <QtGui/QAbstractTextDocumentLayout>
 #include <QtGui/QTextBlock>
 #include <QtGui/QTextDocument>
@@ -132,6 +134,7 @@ class TextDocumentGeneratorPrivate : public GeneratorPrivate
         /* reimp */ QImage image( PixmapRequest * );
 
         void calculateBoundingRect( int startPosition, int endPosition, QRectF &rect, int &page ) const;
+        // like TextDocumentUtils::calculatePositions(), cached
         void calculatePositions( int page, int &start, int &end ) const;
         Okular::TextPage* createTextPage( int ) const;
 
@@ -193,6 +196,9 @@ class TextDocumentGeneratorPrivate : public GeneratorPrivate
 
         TextDocumentSettings *mGeneralSettings;
 
+        // the first and the end position of each page, -1 if not known yet
+        mutable QVector< QPair< int, int > > mPagePositions;
+
         QFont mFont;
 };
 
@@ -0,0 +1,156 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "textextractionjob_p.h"
+
+#include <QtCore/QRunnable>
+#include <QtCore/QThread>
+
+#include "generator.h"
+#include "settings_core.h"
+#include "textpage.h"
+
+using namespace Okular;
+
+namespace Okular {
+
+class TextExtractionWorker : public QRunnable
+{
+    public:
+        TextExtractionWorker( TextExtractionJob *job )
+            : m_job( job )
+        {
+        }
+
+        void run()
+        {
+            while ( m_job->extractNext() )
+                ;
+
+            m_job->m_mutex.lock();
+            const bool last = --m_job->m_runningWorkers == 0;
+            m_job->m_mutex.unlock();
+            if ( last )
+                emit m_job->finished();
+        }
+
+    private:
+        TextExtractionJob *m_job;
+};
+
+}
+
+TextExtractionJob::TextExtractionJob( Generator *generator, const QVector< Page * > &pages, QObject *parent )
+    : QObject( parent ), m_generator( generator ), m_pages( pages ),
+      m_textPages( pages.count(), 0 ), m_extracted( pages.count(), false ),
+      m_next( 0 ), m_extractedCount( 0 ), m_runningWorkers( 0 ),
+      m_started( false ), m_cancelled( false )
+{
+    for ( int i = 0; i < m_pages.count(); ++i )
+        m_indexes.insert( m_pages.at( i ), i );
+
+    // generators that are not reentrant for text are served by one thread only
+    int threads = 1;
+    if ( m_generator->hasFeature( Generator::ParallelTextExtraction ) )
+    {
+        threads = SettingsCore::renderThreads();
+        if ( threads <= 0 )
+            threads = QThread::idealThreadCount();
+    }
+    m_pool.setMaxThreadCount( qMax( 1, qMin( threads, m_pages.count() ) ) );
+}
+
+TextExtractionJob::~TextExtractionJob()
+{
+    cancel();
+    m_pool.waitForDone();
+    qDeleteAll( m_textPages );
+}
+
+void TextExtractionJob::start()
+{
+    QMutexLocker locker( &m_mutex );
+    if ( m_started )
+        return;
+
+    m_started = true;
+    if ( m_pages.isEmpty() )
+    {
+        QMetaObject::invokeMethod( this, "finished", Qt::QueuedConnection );
+        return;
+    }
+
+    m_runningWorkers = m_pool.maxThreadCount();
+    for ( int i = 0; i < m_runningWorkers; ++i )
+        m_pool.start( new TextExtractionWorker( this ) );
+}
+
+void TextExtractionJob::cancel()
+{
+    QMutexLocker locker( &m_mutex );
+    m_cancelled = true;
+    m_pageExtracted.wakeAll();
+}
+
+int TextExtractionJob::count() const
+{
+    return m_pages.count();
+}
+
+int TextExtractionJob::extractedCount() const
+{
+    QMutexLocker locker( &m_mutex );
+    return m_extractedCount;
+}
+
+TextPage *TextExtractionJob::takeTextPage( const Page *page )
+{
+    const int index = m_indexes.value( page, -1 );
+    if ( index < 0 )
+        return 0;
+
+    start();
+
+    QMutexLocker locker( &m_mutex );
+    // the pages not started yet will not be extracted once cancelled
+    while ( !m_extracted.at( index ) && !( m_cancelled && index >= m_next ) )
+        m_pageExtracted.wait( &m_mutex );
+
+    TextPage *textPage = m_textPages.at( index );
+    m_textPages[ index ] = 0;
+    return textPage;
+}
+
+bool TextExtractionJob::extractNext()
+{
+    int index;
+    {
+        QMutexLocker locker( &m_mutex );
+        if ( m_cancelled || m_next >= m_pages.count() )
+            return false;
+        index = m_next++;
+    }
+
+    TextPage *textPage = m_generator->textPage( m_pages.at( index ) );
+
+    int extracted;
+    {
+        QMutexLocker locker( &m_mutex );
+        m_textPages[ index ] = textPage;
+        m_extracted[ index ] = true;
+        extracted = ++m_extractedCount;
+        m_pageExtracted.wakeAll();
+    }
+    emit progress( extracted, m_pages.count() );
+    return true;
+}
+
+#include "textextractionjob_p.moc"
+
+/* kate: replace-tabs on; indent-width 4; */
@@ -0,0 +1,97 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_TEXTEXTRACTIONJOB_P_H_
+#define _OKULAR_TEXTEXTRACTIONJOB_P_H_
+
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QThreadPool>
+#include <QtCore/QVector>
+#include <QtCore/QWaitCondition>
+
+namespace Okular {
+
+class Generator;
+class Page;
+class TextPage;
+
+/**
+ * @short Extracts the text pages of several pages in the background.
+ *
+ * The pages are extracted in order, with as many threads as the render
+ * threads if the generator has the ParallelTextExtraction feature, with
+ * one thread otherwise. The text pages are not attached to the pages: the
+ * caller takes them with takeTextPage(), the ones not taken are deleted
+ * with the job.
+ */
+class TextExtractionJob : public QObject
+{
+    Q_OBJECT
+
+    public:
+        TextExtractionJob( Generator *generator, const QVector< Page * > &pages, QObject *parent = 0 );
+
+        /**
+         * Cancels the job and waits for the pages being extracted.
+         */
+        ~TextExtractionJob();
+
+        /**
+         * Starts extracting the pages. takeTextPage() starts the job too.
+         */
+        void start();
+
+        /**
+         * Stops extracting new pages. The pages being extracted are still
+         * completed.
+         */
+        void cancel();
+
+        int count() const;
+        int extractedCount() const;
+
+        /**
+         * Waits for the text page of @p page to be extracted, and returns it.
+         * Returns 0 if @p page is not in the job, if it was not extracted
+         * because the job was cancelled, or if it was already taken.
+         */
+        TextPage *takeTextPage( const Page *page );
+
+    Q_SIGNALS:
+        void progress( int extracted, int count );
+        void finished();
+
+    private:
+        friend class TextExtractionWorker;
+
+        // called by the workers
+        bool extractNext();
+
+        Generator *m_generator;
+        QVector< Page * > m_pages;
+        QHash< const Page *, int > m_indexes;
+        QVector< TextPage * > m_textPages;
+        QVector< bool > m_extracted;
+        int m_next;
+        int m_extractedCount;
+        int m_runningWorkers;
+        bool m_started;
+        bool m_cancelled;
+        mutable QMutex m_mutex;
+        QWaitCondition m_pageExtracted;
+        QThreadPool m_pool;
+};
+
+}
+
+#endif
+
+/* kate: replace-tabs on; indent-width 4; */
@@ -0,0 +1,209 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include "textsearchindex_p.h"
+
+#include <QtCore/QBitArray>
+#include <QtCore/QDataStream>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+
+#include <ksavefile.h>
+
+using namespace Okular;
+
+static const quint32 IndexMagic = 0x4f4b5349; // "OKSI"
+static const qint32 IndexVersion = 1;
+
+// case folds the text and drops the hyphens, as TextPage::findText() may
+// ignore the ones splitting words at the end of lines
+static QString foldText( const QString &text )
+{
+    QString folded;
+    folded.reserve( text.length() );
+    const int length = text.length();
+    for ( int i = 0; i < length; ++i )
+    {
+        const QChar c = text.at( i );
+        if ( c != QLatin1Char( '-' ) )
+            folded.append( c.toCaseFolded() );
+    }
+    return folded;
+}
+
+TextSearchIndex::TextSearchIndex( int pageCount )
+    : m_pageCount( pageCount )
+{
+}
+
+int TextSearchIndex::pageCount() const
+{
+    return m_pageCount;
+}
+
+void TextSearchIndex::addPage( int page, const QString &text )
+{
+    if ( page < 0 || page >= m_pageCount )
+        return;
+
+    // a hyphen followed by a new line may either join the two parts of a
+    // word or not, index both
+    QString joined = text;
+    joined.remove( QLatin1String( "-\n" ) );
+    addWords( page, joined );
+    if ( joined.length() != text.length() )
+    {
+        QString split = text;
+        split.replace( QLatin1String( "-\n" ), QLatin1String( "\n" ) );
+        addWords( page, split );
+    }
+}
+
+QVector< int > TextSearchIndex::candidatePages( const QString &text ) const
+{
+    // TextPage::findText() looks for the query in this form
+    const QString query = text.normalized( QString::NormalizationForm_KC );
+
+    // every piece of the query between spaces has to be in a word of the
+    // page: at its start if it follows a space, at its end if a space follows
+    QBitArray pages( m_pageCount, true );
+    const int length = query.length();
+    int start = 0;
+    while ( start < length )
+    {
+        if ( query.at( start ).isSpace() )
+        {
+            ++start;
+            continue;
+        }
+
+        int end = start;
+        while ( end < length && !query.at( end ).isSpace() )
+            ++end;
+
+        const QString word = foldText( query.mid( start, end - start ) );
+        if ( !word.isEmpty() )
+            pages &= pagesWithWord( word, start > 0, end < length );
+        start = end;
+    }
+
+    QVector< int > result;
+    for ( int i = 0; i < m_pageCount; ++i )
+    {
+        if ( pages.testBit( i ) )
+            result.append( i );
+    }
+    return result;
+}
+
+bool TextSearchIndex::load( const QString &fileName, int pageCount, const QDateTime &documentStamp )
+{
+    QFile file( fileName );
+    if ( !file.open( QIODevice::ReadOnly ) )
+        return false;
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_4_6 );
+
+    quint32 magic;
+    qint32 version, count;
+    QDateTime stamp;
+    stream >> magic >> version;
+    if ( magic != IndexMagic || version != IndexVersion )
+        return false;
+
+    stream >> stamp >> count;
+    if ( stamp != documentStamp || count != pageCount )
+        return false;
+
+    QHash< QString, QVector< int > > words;
+    stream >> words;
+    if ( stream.status() != QDataStream::Ok )
+        return false;
+
+    m_pageCount = count;
+    m_words = words;
+    return true;
+}
+
+bool TextSearchIndex::save( const QString &fileName, const QDateTime &documentStamp ) const
+{
+    KSaveFile file( fileName );
+    if ( !file.open( QIODevice::WriteOnly ) )
+        return false;
+
+    QDataStream stream( &file );
+    stream.setVersion( QDataStream::Qt_4_6 );
+    stream << IndexMagic << IndexVersion << documentStamp << qint32( m_pageCount ) << m_words;
+    if ( stream.status() != QDataStream::Ok )
+    {
+        file.abort();
+        return false;
+    }
+    return file.finalize();
+}
+
+void TextSearchIndex::addWords( int page, const QString &text )
+{
+    const QString folded = foldText( text );
+    const int length = folded.length();
+    int start = 0;
+    while ( start < length )
+    {
+        if ( folded.at( start ).isSpace() )
+        {
+            ++start;
+            continue;
+        }
+
+        int end = start;
+        while ( end < length && !folded.at( end ).isSpace() )
+            ++end;
+
+        QVector< int > &pages = m_words[ folded.mid( start, end - start ) ];
+        if ( pages.isEmpty() || pages.last() != page )
+            pages.append( page );
+        start = end;
+    }
+}
+
+QBitArray TextSearchIndex::pagesWithWord( const QString &word, bool atWordStart, bool atWordEnd ) const
+{
+    QBitArray pages( m_pageCount );
+
+    if ( atWordStart && atWordEnd )
+    {
+        foreach ( int page, m_words.value( word ) )
+            pages.setBit( page );
+        return pages;
+    }
+
+    // partial words: look through the whole vocabulary
+    QHash< QString, QVector< int > >::const_iterator it = m_words.constBegin(), itEnd = m_words.constEnd();
+    for ( ; it != itEnd; ++it )
+    {
+        const QString &key = it.key();
+        bool matches;
+        if ( atWordStart )
+            matches = key.startsWith( word );
+        else if ( atWordEnd )
+            matches = key.endsWith( word );
+        else
+            matches = key.contains( word );
+
+        if ( matches )
+        {
+            foreach ( int page, it.value() )
+                pages.setBit( page );
+        }
+    }
+    return pages;
+}
+
+/* kate: replace-tabs on; indent-width 4; */
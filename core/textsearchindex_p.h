@@ -0,0 +1,74 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#ifndef _OKULAR_TEXTSEARCHINDEX_P_H_
+#define _OKULAR_TEXTSEARCHINDEX_P_H_
+
+#include <QtCore/QHash>
+#include <QtCore/QString>
+#include <QtCore/QVector>
+
+class QBitArray;
+class QDateTime;
+
+namespace Okular {
+
+/**
+ * @short Inverted index of the words of the pages of a document.
+ *
+ * It tells which pages may contain a text, so that the searches through the
+ * whole document only need to look at the text of those pages. The words
+ * are indexed case folded and without hyphens, so the pages returned by
+ * candidatePages() are a superset of the ones TextPage::findText() finds
+ * the text in, whatever the case sensitivity.
+ */
+class TextSearchIndex
+{
+    public:
+        explicit TextSearchIndex( int pageCount = 0 );
+
+        int pageCount() const;
+
+        /**
+         * Adds the words of @p text, the text of @p page. The pages have to
+         * be added in increasing order.
+         */
+        void addPage( int page, const QString &text );
+
+        /**
+         * Returns the pages that may contain @p text, in increasing order.
+         */
+        QVector< int > candidatePages( const QString &text ) const;
+
+        /**
+         * Loads the index from @p fileName. Fails if the file is not an
+         * index of a document with @p pageCount pages last modified at
+         * @p documentStamp.
+         */
+        bool load( const QString &fileName, int pageCount, const QDateTime &documentStamp );
+
+        /**
+         * Saves the index to @p fileName.
+         */
+        bool save( const QString &fileName, const QDateTime &documentStamp ) const;
+
+    private:
+        void addWords( int page, const QString &text );
+        QBitArray pagesWithWord( const QString &word, bool atWordStart, bool atWordEnd ) const;
+
+        int m_pageCount;
+        // the pages of each word, in increasing order
+        QHash< QString, QVector< int > > m_words;
+};
+
+}
+
+#endif
+
+/* kate: replace-tabs on; indent-width 4; */
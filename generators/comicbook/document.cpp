@@ -9,6 +9,8 @@
 
 #include "document.h"
 
+#include <QtCore/QFile>
+#include <QtCore/QRunnable>
 #include <QtCore/QScopedPointer>
 #include <QtGui/QImage>
 #include <QtGui/QImageReader>
@@ -28,6 +30,31 @@
 
 using namespace ComicBook;
 
+// the number of pages after the one shown whose data is read in advance
+static const int PrefetchedPages = 2;
+
+namespace ComicBook {
+
+class PrefetchJob : public QRunnable
+{
+    public:
+        PrefetchJob( const Document *document, int page )
+            : mDocument( document ), mPage( page )
+        {
+        }
+
+        void run()
+        {
+            mDocument->prefetch( mPage );
+        }
+
+    private:
+        const Document *mDocument;
+        int mPage;
+};
+
+}
+
 static void imagesInArchive( const QString &prefix, const KArchiveDirectory* dir, QStringList *entries )
 {
     Q_FOREACH ( const QString &entry, dir->entries() ) {
@@ -42,12 +69,14 @@ static void imagesInArchive( const QString &prefix, const KArchiveDirectory* dir
 
 
 Document::Document()
-    : mDirectory( 0 ), mUnrar( 0 ), mArchive( 0 )
+    : mDirectory( 0 ), mUnrar( 0 ), mArchive( 0 ), mNextEntry( 0 )
 {
+    mPrefetchPool.setMaxThreadCount( 1 );
 }
 
 Document::~Document()
 {
+    mPrefetchPool.waitForDone();
 }
 
 bool Document::open( const QString &fileName )
@@ -120,7 +149,12 @@ bool Document::open( const QString &fileName )
 
 void Document::close()
 {
+    mPrefetchPool.waitForDone();
+    mPrefetched.clear();
+    mPrefetching.clear();
+
     mLastErrorString.clear();
+    mNextEntry = 0;
 
     if ( !( mArchive || mUnrar || mDirectory ) )
         return;
@@ -158,16 +192,18 @@ bool Document::processArchive() {
     return true;
 }
 
-void Document::pages( QVector<Okular::Page*> * pagesVector )
+bool Document::pages( QVector<Okular::Page*> * pagesVector, int maxPages )
 {
-    qSort( mEntries.begin(), mEntries.end(), caseSensitiveNaturalOrderLessThen );
+    if ( mNextEntry == 0 )
+        qSort( mEntries.begin(), mEntries.end(), caseSensitiveNaturalOrderLessThen );
+    QMutexLocker locker( &mArchiveMutex );
     QScopedPointer< QIODevice > dev;
 
-    int count = 0;
-    pagesVector->clear();
-    pagesVector->resize( mEntries.size() );
+    int count = pagesVector->count();
+    const int lastPage = maxPages < 0 ? mEntries.count() : count + maxPages;
     QImageReader reader;
-    foreach(const QString &file, mEntries) {
+    while ( mNextEntry < mEntries.count() && count < lastPage ) {
+        const QString file = mEntries.at( mNextEntry++ );
         if ( mArchive ) {
             const KArchiveFile *entry = static_cast<const KArchiveFile*>( mArchiveDir->entry( file ) );
             if ( entry ) {
@@ -190,7 +226,7 @@ void Document::pages( QVector<Okular::Page*> * pagesVector )
                         pageSize = i.size();
                 }
                 if ( pageSize.isValid() ) {
-                    pagesVector->replace( count, new Okular::Page( count, pageSize.width(), pageSize.height(), Okular::Rotation0 ) );
+                    pagesVector->append( new Okular::Page( count, pageSize.width(), pageSize.height(), Okular::Rotation0 ) );
                     mPageMap.append(file);
                     count++;
                 } else {
@@ -199,7 +235,8 @@ void Document::pages( QVector<Okular::Page*> * pagesVector )
             }
         }
     }
-    pagesVector->resize( count );
+
+    return mNextEntry < mEntries.count();
 }
 
 QStringList Document::pageTitles() const
@@ -209,17 +246,70 @@ QStringList Document::pageTitles() const
 
 QImage Document::pageImage( int page ) const
 {
+    QByteArray data;
+    {
+        QMutexLocker locker( &mPrefetchMutex );
+        data = mPrefetched.take( page );
+    }
+    if ( data.isNull() )
+        data = pageData( page );
+
+    prefetchAfter( page );
+
+    return QImage::fromData( data );
+}
+
+QByteArray Document::pageData( int page ) const
+{
+    QMutexLocker locker( &mArchiveMutex );
+    if ( page < 0 || page >= mPageMap.count() )
+        return QByteArray();
+
     if ( mArchive ) {
         const KArchiveFile *entry = static_cast<const KArchiveFile*>( mArchiveDir->entry( mPageMap[ page ] ) );
         if ( entry )
-            return QImage::fromData( entry->data() );
+            return entry->data();
     } else if ( mDirectory ) {
-        return QImage( mPageMap[ page ] );
+        QFile file( mPageMap[ page ] );
+        if ( file.open( QIODevice::ReadOnly ) )
+            return file.readAll();
     } else {
-        return QImage::fromData( mUnrar->contentOf( mPageMap[ page ] ) );
+        return mUnrar->contentOf( mPageMap[ page ] );
     }
 
-    return QImage();
+    return QByteArray();
+}
+
+void Document::prefetchAfter( int page ) const
+{
+    QMutexLocker locker( &mPrefetchMutex );
+
+    // only keep the data of the pages after this one
+    QHash< int, QByteArray >::iterator it = mPrefetched.begin();
+    while ( it != mPrefetched.end() ) {
+        if ( it.key() <= page || it.key() > page + PrefetchedPages )
+            it = mPrefetched.erase( it );
+        else
+            ++it;
+    }
+
+    for ( int i = page + 1; i <= page + PrefetchedPages; ++i ) {
+        if ( mPrefetched.contains( i ) || mPrefetching.contains( i ) )
+            continue;
+
+        mPrefetching.insert( i );
+        mPrefetchPool.start( new PrefetchJob( this, i ) );
+    }
+}
+
+void Document::prefetch( int page ) const
+{
+    const QByteArray data = pageData( page );
+
+    QMutexLocker locker( &mPrefetchMutex );
+    mPrefetching.remove( page );
+    if ( !data.isEmpty() )
+        mPrefetched.insert( page, data );
 }
 
 QString Document::lastErrorString() const
@@ -10,7 +10,11 @@
 #ifndef COMICBOOK_DOCUMENT_H
 #define COMICBOOK_DOCUMENT_H
 
+#include <QtCore/QHash>
+#include <QtCore/QMutex>
+#include <QtCore/QSet>
 #include <QtCore/QStringList>
+#include <QtCore/QThreadPool>
 
 class KArchiveDirectory;
 class KArchive;
@@ -34,7 +38,9 @@ class Document
         bool open( const QString &fileName );
         void close();
 
-        void pages( QVector<Okular::Page*> * pagesVector );
+        // appends the next maxPages pages (all of them if -1) to pagesVector,
+        // returns whether there are more pages
+        bool pages( QVector<Okular::Page*> * pagesVector, int maxPages = -1 );
         QStringList pageTitles() const;
 
         QImage pageImage( int page ) const;
@@ -42,7 +48,12 @@ class Document
         QString lastErrorString() const;
 
     private:
+        friend class PrefetchJob;
+
         bool processArchive();
+        QByteArray pageData( int page ) const;
+        void prefetchAfter( int page ) const;
+        void prefetch( int page ) const;
 
         QStringList mPageMap;
         Directory *mDirectory;
@@ -51,6 +62,15 @@ class Document
         KArchiveDirectory *mArchiveDir;
         QString mLastErrorString;
         QStringList mEntries;
+        int mNextEntry;
+
+        // the archive is read from the thread prefetching the data of the
+        // next pages too
+        mutable QMutex mArchiveMutex;
+        mutable QThreadPool mPrefetchPool;
+        mutable QMutex mPrefetchMutex;
+        mutable QHash< int, QByteArray > mPrefetched;
+        mutable QSet< int > mPrefetching;
 };
 
 }
@@ -9,6 +9,7 @@
 
 #include "generator_comicbook.h"
 
+#include <QtCore/QMutex>
 #include <QtGui/QPainter>
 #include <QtGui/QPrinter>
 
@@ -43,6 +44,8 @@ ComicBookGenerator::ComicBookGenerator( QObject *parent, const QVariantList &arg
     setFeature( Threaded );
     setFeature( PrintNative );
     setFeature( PrintToFile );
+    setFeature( IncrementalLoading );
+    setFeature( CachedRendering );
 }
 
 ComicBookGenerator::~ComicBookGenerator()
@@ -59,10 +62,22 @@ bool ComicBookGenerator::loadDocument( const QString & fileName, QVector<Okular:
         return false;
     }
 
-    mDocument.pages( &pagesVector );
+    // only read the first pages, loadMorePages() reads the others
+    mDocument.pages( &pagesVector, 10 );
     return true;
 }
 
+bool ComicBookGenerator::loadMorePages( QVector<Okular::Page*> & pagesVector )
+{
+    // don't wait for the page being rendered, the document will ask again
+    if ( !userMutex()->tryLock() )
+        return true;
+
+    const bool morePages = mDocument.pages( &pagesVector, 5 );
+    userMutex()->unlock();
+    return morePages;
+}
+
 bool ComicBookGenerator::doCloseDocument()
 {
     mDocument.close();
@@ -75,7 +90,10 @@ QImage ComicBookGenerator::image( Okular::PixmapRequest * request )
     int width = request->width();
     int height = request->height();
 
+    // the pages may still be loaded from the main thread
+    userMutex()->lock();
     QImage image = mDocument.pageImage( request->pageNumber() );
+    userMutex()->unlock();
 
     return image.scaled( width, height, Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
 }
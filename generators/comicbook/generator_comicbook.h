@@ -24,6 +24,7 @@ class ComicBookGenerator : public Okular::Generator
 
         // [INHERITED] load a document and fill up the pagesVector
         bool loadDocument( const QString & fileName, QVector<Okular::Page*> & pagesVector );
+        bool loadMorePages( QVector<Okular::Page*> & pagesVector );
 
         // [INHERITED] print document using already configured kprinter
         bool print( QPrinter& printer );
@@ -87,7 +87,9 @@ DjVuGenerator::DjVuGenerator( QObject *parent, const QVariantList &args )
     : Okular::Generator( parent, args ), m_docInfo( 0 ), m_docSyn( 0 )
 {
     setFeature( TextExtraction );
+    setFeature( ParallelTextExtraction );
     setFeature( Threaded );
+    setFeature( TiledRendering );
     setFeature( PrintPostscript );
     if ( Okular::FilePrinter::ps2pdfAvailable() )
         setFeature( PrintToFile );
@@ -130,8 +132,13 @@ bool DjVuGenerator::doCloseDocument()
 
 QImage DjVuGenerator::image( Okular::PixmapRequest *request )
 {
+    // ddjvu renders any part of the page, so the tiles are rendered alone
+    QRect rect( 0, 0, request->width(), request->height() );
+    if ( request->isTile() )
+        rect = request->normalizedRect().geometry( request->width(), request->height() );
+
     userMutex()->lock();
-    QImage img = m_djvu->image( request->pageNumber(), request->width(), request->height(), request->page()->rotation() );
+    QImage img = m_djvu->image( request->pageNumber(), request->width(), request->height(), request->page()->rotation(), rect );
     userMutex()->unlock();
     return img;
 }
@@ -13,8 +13,8 @@
 #include <qdom.h>
 #include <qfile.h>
 #include <qhash.h>
+#include <qcache.h>
 #include <qlist.h>
-#include <qpainter.h>
 #include <qqueue.h>
 #include <qstring.h>
 
@@ -143,20 +143,34 @@ static bool find_replace_or_add_second_in_pair( miniexp_t theexp, const char* wh
     return false;
 }
 
-// ImageCacheItem
+// ImageCacheKey
 
-class ImageCacheItem
+class ImageCacheKey
 {
     public:
-        ImageCacheItem( int p, int w, int h, const QImage& i )
-          : page( p ), width( w ), height( h ), img( i ) { }
+        ImageCacheKey( int p, int w, int h, int r )
+          : page( p ), width( w ), height( h ), rotation( r ) { }
+
+        bool operator==( const ImageCacheKey &other ) const
+        {
+            return page == other.page && width == other.width
+                   && height == other.height && rotation == other.rotation;
+        }
 
         int page;
         int width;
         int height;
-        QImage img;
+        int rotation;
 };
 
+static uint qHash( const ImageCacheKey &key )
+{
+    return ::qHash( ( key.page << 2 ) | ( key.rotation & 3 ) ) ^ ::qHash( ( key.width << 16 ) | ( key.height & 0xffff ) );
+}
+
+// the memory the images in cache can use, in bytes
+static const int ImageCacheMaxCost = 64 * 1024 * 1024;
+
 
 // KdjVu::Page
 
@@ -430,12 +444,13 @@ class KDjVu::Private
     public:
         Private()
           : m_djvu_cxt( 0 ), m_djvu_document( 0 ), m_format( 0 ), m_docBookmarks( 0 ),
-            m_cacheEnabled( true )
+            mImgCache( ImageCacheMaxCost ), m_cacheEnabled( true )
         {
         }
 
-        QImage generateImageTile( ddjvu_page_t *djvupage, int& res,
-            int width, int row, int xdelta, int height, int col, int ydelta );
+        ddjvu_page_t *djvuPage( int page );
+        QImage renderRect( ddjvu_page_t *djvupage, int& res,
+            int width, int height, const QRect &rect );
 
         void readBookmarks();
         void fillBookmarksRecurse( QDomDocument& maindoc, QDomNode& curnode,
@@ -452,7 +467,8 @@ class KDjVu::Private
         QVector<KDjVu::Page*> m_pages;
         QVector<ddjvu_page_t *> m_pages_cache;
 
-        QList<ImageCacheItem*> mImgCache;
+        // the rendered pages, the cost is the size of the image in bytes
+        QCache<ImageCacheKey, QImage> mImgCache;
 
         QHash<QString, QVariant> m_metaData;
         QDomDocument * m_docBookmarks;
@@ -466,16 +482,28 @@ class KDjVu::Private
 
 unsigned int KDjVu::Private::s_formatmask[4] = { 0x00ff0000, 0x0000ff00, 0x000000ff, 0xff000000 };
 
-QImage KDjVu::Private::generateImageTile( ddjvu_page_t *djvupage, int& res,
-    int width, int row, int xdelta, int height, int col, int ydelta )
+ddjvu_page_t *KDjVu::Private::djvuPage( int page )
+{
+    if ( !m_pages_cache.at( page ) )
+    {
+        ddjvu_page_t *newpage = ddjvu_page_create_by_pageno( m_djvu_document, page );
+        // wait for the new page to be loaded
+        ddjvu_status_t sts;
+        while ( ( sts = ddjvu_page_decoding_status( newpage ) ) < DDJVU_JOB_OK )
+            handle_ddjvu_messages( m_djvu_cxt, true );
+        m_pages_cache[page] = newpage;
+    }
+    return m_pages_cache.at( page );
+}
+
+QImage KDjVu::Private::renderRect( ddjvu_page_t *djvupage, int& res,
+    int width, int height, const QRect &rect )
 {
     ddjvu_rect_t renderrect;
-    renderrect.x = row * xdelta;
-    renderrect.y = col * ydelta;
-    int realwidth = qMin( width - renderrect.x, xdelta );
-    int realheight = qMin( height - renderrect.y, ydelta );
-    renderrect.w = realwidth;
-    renderrect.h = realheight;
+    renderrect.x = rect.x();
+    renderrect.y = rect.y();
+    renderrect.w = rect.width();
+    renderrect.h = rect.height();
 #ifdef KDJVU_DEBUG
     kDebug() << "renderrect:" << renderrect;
 #endif
@@ -488,7 +516,7 @@ QImage KDjVu::Private::generateImageTile( ddjvu_page_t *djvupage, int& res,
     kDebug() << "pagerect:" << pagerect;
 #endif
     handle_ddjvu_messages( m_djvu_cxt, false );
-    QImage res_img( realwidth, realheight, QImage::Format_RGB32 );
+    QImage res_img( rect.width(), rect.height(), QImage::Format_RGB32 );
     // the following line workarounds a rare crash in djvulibre;
     // it should be fixed with >= 3.5.21
     ddjvu_page_get_width( djvupage );
@@ -759,7 +787,6 @@ void KDjVu::closeFile()
         ddjvu_page_release( *it );
     d->m_pages_cache.clear();
     // clearing the image cache
-    qDeleteAll( d->mImgCache );
     d->mImgCache.clear();
     // clearing the old metadata
     d->m_metaData.clear();
@@ -907,41 +934,27 @@ const QVector<KDjVu::Page*> &KDjVu::pages() const
 
 QImage KDjVu::image( int page, int width, int height, int rotation )
 {
-    if ( d->m_cacheEnabled )
-    {
-    bool found = false;
-    QList<ImageCacheItem*>::Iterator it = d->mImgCache.begin(), itEnd = d->mImgCache.end();
-    for ( ; ( it != itEnd ) && !found; ++it )
-    {
-        ImageCacheItem* cur = *it;
-        if ( ( cur->page == page ) &&
-             ( rotation % 2 == 0
-               ? cur->width == width && cur->height == height
-               : cur->width == height && cur->height == width ) )
-            found = true;
-    }
-    if ( found )
-    {
-        // taking the element and pushing to the top of the list
-        --it;
-        ImageCacheItem* cur2 = *it;
-        d->mImgCache.erase( it );
-        d->mImgCache.push_front( cur2 );
+    return image( page, width, height, rotation, QRect( 0, 0, width, height ) );
+}
 
-        return cur2->img;
-    }
-    }
+QImage KDjVu::image( int page, int width, int height, int rotation, const QRect &rect )
+{
+    const QRect pageRect( 0, 0, width, height );
+    const QRect region = rect.intersected( pageRect );
+    if ( region.isEmpty() )
+        return QImage();
+
+    const bool wholePage = region == pageRect;
+    const ImageCacheKey key( page, width, height, rotation );
 
-    if ( !d->m_pages_cache.at( page ) )
+    if ( d->m_cacheEnabled )
     {
-        ddjvu_page_t *newpage = ddjvu_page_create_by_pageno( d->m_djvu_document, page );
-        // wait for the new page to be loaded
-        ddjvu_status_t sts;
-        while ( ( sts = ddjvu_page_decoding_status( newpage ) ) < DDJVU_JOB_OK )
-            handle_ddjvu_messages( d->m_djvu_cxt, true );
-        d->m_pages_cache[page] = newpage;
+        // a part of a page in cache is just copied from it
+        if ( const QImage *cached = d->mImgCache.object( key ) )
+            return wholePage ? *cached : cached->copy( region );
     }
-    ddjvu_page_t *djvupage = d->m_pages_cache[page];
+
+    ddjvu_page_t *djvupage = d->djvuPage( page );
 
 /*
     if ( ddjvu_page_get_rotation( djvupage ) != flipRotation( rotation ) )
@@ -952,74 +965,24 @@ QImage KDjVu::image( int page, int width, int height, int rotation )
     }
 */
 
-    static const int xdelta = 1500;
-    static const int ydelta = 1500;
-
-    int xparts = width / xdelta + 1;
-    int yparts = height / ydelta + 1;
-
-    QImage newimg;
-
-    int res = 10000;
-    if ( ( xparts == 1 ) && ( yparts == 1 ) )
-    {
-         // only one part -- render at once with no need to auxiliary image
-         newimg = d->generateImageTile( djvupage, res,
-                 width, 0, xdelta, height, 0, ydelta );
-    }
-    else
-    {
-        // more than one part -- need to render piece-by-piece and to compose
-        // the results
-        newimg = QImage( width, height, QImage::Format_RGB32 );
-        QPainter p;
-        p.begin( &newimg );
-        int parts = xparts * yparts;
-        for ( int i = 0; i < parts; ++i )
-        {
-            int row = i % xparts;
-            int col = i / xparts;
-            int tmpres = 0;
-            QImage tempp = d->generateImageTile( djvupage, tmpres,
-                    width, row, xdelta, height, col, ydelta );
-            if ( tmpres )
-            {
-                p.drawImage( row * xdelta, col * ydelta, tempp );
-            }
-            res = qMin( tmpres, res );
-        }
-        p.end();
-    }
+    int res = 0;
+    QImage newimg = d->renderRect( djvupage, res, width, height, region );
 
-    if ( res && d->m_cacheEnabled )
+    // only whole pages are kept, parts of them are rarely asked twice
+    if ( res && wholePage && d->m_cacheEnabled )
     {
         // delete all the cached pixmaps for the current page with a size that
         // differs no more than 35% of the new pixmap size
-        int imgsize = newimg.width() * newimg.height();
-        if ( imgsize > 0 )
+        const int imgsize = width * height;
+        foreach ( const ImageCacheKey &cur, d->mImgCache.keys() )
         {
-            for( int i = 0; i < d->mImgCache.count(); )
-            {
-                ImageCacheItem* cur = d->mImgCache.at(i);
-                if ( ( cur->page == page ) &&
-                     ( abs( cur->img.width() * cur->img.height() - imgsize ) < imgsize * 0.35 ) )
-                {
-                    d->mImgCache.removeAt( i );
-                    delete cur;
-                }
-                else
-                    ++i;
-            }
+            if ( ( cur.page == page ) &&
+                 ( abs( cur.width * cur.height - imgsize ) < imgsize * 0.35 ) )
+                d->mImgCache.remove( cur );
         }
 
-        // the image cache has too many elements, remove the last
-        if ( d->mImgCache.size() >= 10 )
-        {
-            delete d->mImgCache.last();
-            d->mImgCache.removeLast();
-        }
-        ImageCacheItem* ich = new ImageCacheItem( page, width, height, newimg );
-        d->mImgCache.push_front( ich );
+        // the least recently used images are dropped when the cache is full
+        d->mImgCache.insert( key, new QImage( newimg ), newimg.byteCount() );
     }
 
     return newimg;
@@ -1139,7 +1102,6 @@ void KDjVu::setCacheEnabled( bool enable )
     d->m_cacheEnabled = enable;
     if ( !d->m_cacheEnabled )
     {
-        qDeleteAll( d->mImgCache );
         d->mImgCache.clear();
     }
 }
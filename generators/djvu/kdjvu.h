@@ -251,12 +251,20 @@ class KDjVu
         void linksAndAnnotationsForPage( int pageNum, QList<KDjVu::Link*> *links, QList<KDjVu::Annotation*> *annotations ) const;
 
         /**
-         * Check if the image for the specified \p page with the specified
-         * \p width, \p height and \p rotation is already in cache, and returns
-         * it. If not, a null image is returned.
+         * Returns the image for the specified \p page with the specified
+         * \p width, \p height and \p rotation, taking it from the cache
+         * if it is there already.
          */
         QImage image( int page, int width, int height, int rotation );
 
+        /**
+         * Returns the part \p rect of the image for the specified \p page
+         * with the specified \p width, \p height and \p rotation.
+         *
+         * Only that part is rendered, unless the whole image is in cache.
+         */
+        QImage image( int page, int width, int height, int rotation, const QRect &rect );
+
         /**
          * Export the currently open document as PostScript file \p fileName.
          * \returns whether the exporting was successful
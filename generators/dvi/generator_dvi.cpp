@@ -24,6 +24,7 @@
 #include "TeXFont.h"
 
 #include <qapplication.h>
+#include <qcryptographichash.h>
 #include <qstring.h>
 #include <qurl.h>
 #include <qvector.h>
@@ -598,7 +599,49 @@ QVariant DviGenerator::metaData( const QString & key, const QVariant & option )
             }
         }
     }
+    else if ( key == "PageFingerprint" )
+    {
+        return pageFingerprint( option.toInt() );
+    }
     return QVariant();
 }
 
+QByteArray DviGenerator::pageFingerprint( int page ) const
+{
+    if ( !m_dviRenderer || !m_dviRenderer->dviFile )
+        return QByteArray();
+
+    dvifile *dvif = m_dviRenderer->dviFile;
+    if ( page < 0 || page >= dvif->total_pages || dvif->page_offset.size() <= dvif->total_pages )
+        return QByteArray();
+
+    // the included graphic files may change without the DVI file changing
+    if ( dvif->numberOfExternalPSFiles > 0 || dvif->numberOfExternalNONPSFiles > 0 )
+        return QByteArray();
+
+    // the page record without its bop command (the page counters and the
+    // offset of the previous page), that change when pages are added
+    const quint8 *data = dvif->dvi_Data();
+    const quint32 begin = dvif->page_offset[ page ] + 45;
+    const quint32 end = dvif->page_offset[ page + 1 ];
+    const quint32 postamble = dvif->page_offset[ dvif->total_pages ];
+    if ( begin > end || postamble + 29 > dvif->size_of_file )
+        return QByteArray();
+
+    QCryptographicHash hash( QCryptographicHash::Md5 );
+    hash.addData( (const char *)data + begin, end - begin );
+
+    // the units, the magnification and the font definitions of the
+    // postamble, up to the post_post command and the trailing 223s
+    qint64 trailer = dvif->size_of_file;
+    while ( trailer > postamble && data[ trailer - 1 ] == 223 )
+        --trailer;
+    trailer -= 6;
+    hash.addData( (const char *)data + postamble + 5, 12 );
+    if ( trailer > postamble + 29 )
+        hash.addData( (const char *)data + postamble + 29, trailer - postamble - 29 );
+
+    return hash.result();
+}
+
 #include "generator_dvi.moc"
@@ -60,6 +60,7 @@ class DviGenerator : public Okular::Generator
 
         void loadPages( QVector< Okular::Page * > & pagesVector );
         Okular::TextPage *extractTextFromPage( dviPageInfo *pageInfo );
+        QByteArray pageFingerprint( int page ) const;
         void fillViewportFromAnchor( Okular::DocumentViewport &vp, const Anchor &anch, 
                                      int pW, int pH ) const; 
         void fillViewportFromAnchor( Okular::DocumentViewport &vp, const Anchor &anch,
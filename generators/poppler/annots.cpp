@@ -60,7 +60,7 @@ static int maskExportedFlags(int flags)
 
 //BEGIN PopplerAnnotationProxy implementation
 PopplerAnnotationProxy::PopplerAnnotationProxy( Poppler::Document *doc, QMutex *userMutex )
-    : ppl_doc ( doc ), mutex ( userMutex )
+    : ppl_doc ( doc ), mutex ( userMutex ), documentModified ( false )
 {
 }
 
@@ -68,6 +68,12 @@ PopplerAnnotationProxy::~PopplerAnnotationProxy()
 {
 }
 
+bool PopplerAnnotationProxy::hasModifiedDocument() const
+{
+    // NOTE: the mutex must be locked by the caller
+    return documentModified;
+}
+
 bool PopplerAnnotationProxy::supports( Capability cap ) const
 {
     switch ( cap )
@@ -92,6 +98,7 @@ void PopplerAnnotationProxy::notifyAddition( Okular::Annotation *okl_ann, int pa
     Okular::AnnotationUtils::storeAnnotation( okl_ann, dom_ann, doc );
 
     QMutexLocker ml(mutex);
+    documentModified = true;
 
     // Create poppler annotation
     Poppler::Annotation *ppl_ann = Poppler::AnnotationUtils::createAnnotation( dom_ann );
@@ -145,6 +152,7 @@ void PopplerAnnotationProxy::notifyModification( const Okular::Annotation *okl_a
         return;
 
     QMutexLocker ml(mutex);
+    documentModified = true;
 
     if ( okl_ann->flags() & Okular::Annotation::BeingMoved )
     {
@@ -256,6 +264,7 @@ void PopplerAnnotationProxy::notifyRemoval( Okular::Annotation *okl_ann, int pag
         return;
 
     QMutexLocker ml(mutex);
+    documentModified = true;
 
     Poppler::Page *ppl_page = ppl_doc->page( page );
     ppl_page->removeAnnotation( ppl_ann ); // Also destroys ppl_ann
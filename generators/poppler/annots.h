@@ -30,9 +30,13 @@ class PopplerAnnotationProxy : public Okular::AnnotationProxy
         void notifyAddition( Okular::Annotation *annotation, int page );
         void notifyModification( const Okular::Annotation *annotation, int page, bool appearanceChanged );
         void notifyRemoval( Okular::Annotation *annotation, int page );
+
+        // whether annotations have been changed in the poppler document
+        bool hasModifiedDocument() const;
     private:
         Poppler::Document *ppl_doc;
         QMutex *mutex;
+        bool documentModified;
 };
 
 #endif
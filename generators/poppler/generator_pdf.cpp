@@ -21,6 +21,7 @@
 #include <qregexp.h>
 #include <qstack.h>
 #include <qtextstream.h>
+#include <qthread.h>
 #include <QtGui/QPrinter>
 #include <QtGui/QPainter>
 
@@ -32,6 +33,7 @@
 #include <kwallet.h>
 #include <ktemporaryfile.h>
 #include <kdebug.h>
+#include <kde_file.h>
 #include <kglobal.h>
 
 #include <core/action.h>
@@ -47,6 +49,7 @@
 
 #include "ui_pdfsettingswidget.h"
 #include "pdfsettings.h"
+#include "settings_core.h"
 
 #include <config-okular-poppler.h>
 
@@ -422,13 +425,15 @@ static void PDFGeneratorPopplerDebugFunction(const QString &message, const QVari
 #endif
 
 PDFGenerator::PDFGenerator( QObject *parent, const QVariantList &args )
-    : Generator( parent, args ), pdfdoc( 0 ),
+    : Generator( parent, args ), pdfdoc( 0 ), hasFormFields( false ),
     docInfoDirty( true ), docSynopsisDirty( true ),
     docEmbeddedFilesDirty( true ), nextFontPage( 0 ),
     annotProxy( 0 ), synctex_scanner( 0 )
 {
     setFeature( Threaded );
+    setFeature( ParallelRendering );
     setFeature( TextExtraction );
+    setFeature( ParallelTextExtraction );
     setFeature( FontInfo );
 #ifdef Q_OS_WIN32
     setFeature( PrintNative );
@@ -439,6 +444,9 @@ PDFGenerator::PDFGenerator( QObject *parent, const QVariantList &args )
         setFeature( PrintToFile );
     setFeature( ReadRawData );
     setFeature( TiledRendering );
+    setFeature( IncrementalLoading );
+    setFeature( CachedRendering );
+    setFeature( ProgressiveRendering );
 
 #ifdef HAVE_POPPLER_0_16
     // You only need to do it once not for each of the documents but it is cheap enough
@@ -462,8 +470,11 @@ bool PDFGenerator::loadDocument( const QString & filePath, QVector<Okular::Page*
         return false;
     }
 #endif
-    // create PDFDoc for the given file
+    // create PDFDoc for the given file; remember which file it is, so that
+    // the private render copies are only loaded from the very same file
     pdfdoc = Poppler::Document::load( filePath, 0, 0 );
+    documentFilePath = filePath;
+    documentFileIdentity = fileIdentity( filePath );
     bool success = init(pagesVector, filePath.section('/', -1, -1));
     if (success)
     {
@@ -472,6 +483,8 @@ bool PDFGenerator::loadDocument( const QString & filePath, QVector<Okular::Page*
         initSynctexParser(filePath);
         if ( !synctex_scanner && QFile::exists(filePath + QLatin1String( "sync" ) ) )
         {
+            // the source references are set on all the pages at once
+            loadPages(pagesVector, pdfdoc->numPages());
             loadPdfSync(filePath, pagesVector);
         }
     }
@@ -489,6 +502,7 @@ bool PDFGenerator::loadDocumentFromData( const QByteArray & fileData, QVector<Ok
 #endif
     // create PDFDoc for the given file
     pdfdoc = Poppler::Document::loadFromData( fileData, 0, 0 );
+    documentData = fileData;
     return init(pagesVector, QString());
 }
 
@@ -549,6 +563,8 @@ bool PDFGenerator::init(QVector<Okular::Page*> & pagesVector, const QString &wal
 
         // 2. reopen the document using the password
         pdfdoc->unlock( password.toLatin1(), password.toLatin1() );
+        if ( !pdfdoc->isLocked() )
+            documentPassword = password.toLatin1();
 
         // 3. if the password is correct and the user chose to remember it, store it to the wallet
         if ( !pdfdoc->isLocked() && wallet && /*safety check*/ wallet->isOpen() && keep )
@@ -570,12 +586,12 @@ bool PDFGenerator::init(QVector<Okular::Page*> & pagesVector, const QString &wal
         pdfdoc = 0;
         return false;
     }
-    pagesVector.resize(pageCount);
-    rectsGenerated.fill(false, pageCount);
-
     annotationsHash.clear();
 
-    loadPages(pagesVector, 0, false);
+    // only load the first pages, enough to show the beginning of the
+    // document, the others are loaded by loadMorePages()
+    pagesVector.clear();
+    loadPages(pagesVector, qMin(pageCount, 20));
 
     // update the configuration
     reparseConfig();
@@ -596,6 +612,15 @@ bool PDFGenerator::doCloseDocument()
     delete pdfdoc;
     pdfdoc = 0;
     userMutex()->unlock();
+    renderDocumentsMutex.lock();
+    qDeleteAll( renderDocuments );
+    renderDocuments.clear();
+    renderDocumentsMutex.unlock();
+    documentData.clear();
+    documentFilePath.clear();
+    documentFileIdentity.clear();
+    documentPassword.clear();
+    hasFormFields = false;
     docInfoDirty = true;
     docSynopsisDirty = true;
     docSyn.clear();
@@ -603,7 +628,6 @@ bool PDFGenerator::doCloseDocument()
     qDeleteAll(docEmbeddedFiles);
     docEmbeddedFiles.clear();
     nextFontPage = 0;
-    rectsGenerated.clear();
     if ( synctex_scanner )
     {
         synctex_scanner_free( synctex_scanner );
@@ -613,12 +637,28 @@ bool PDFGenerator::doCloseDocument()
     return true;
 }
 
-void PDFGenerator::loadPages(QVector<Okular::Page*> &pagesVector, int rotation, bool clear)
+bool PDFGenerator::loadMorePages( QVector<Okular::Page*> & pagesVector )
+{
+    // don't wait for the page being rendered, the document will ask again
+    if ( !userMutex()->tryLock() )
+        return true;
+
+    bool morePages = false;
+    if ( pdfdoc )
+    {
+        const int pageCount = pdfdoc->numPages();
+        loadPages(pagesVector, qMin(pageCount, pagesVector.count() + 10));
+        morePages = pagesVector.count() < pageCount;
+    }
+    userMutex()->unlock();
+    return morePages;
+}
+
+void PDFGenerator::loadPages(QVector<Okular::Page*> &pagesVector, int count)
 {
     // TODO XPDF 3.01 check
-    const int count = pagesVector.count();
     double w = 0, h = 0;
-    for ( int i = 0; i < count ; i++ )
+    for ( int i = pagesVector.count(); i < count ; i++ )
     {
         // get xpdf page
         Poppler::Page * p = pdfdoc->page( i );
@@ -636,46 +676,63 @@ void PDFGenerator::loadPages(QVector<Okular::Page*> &pagesVector, int rotation,
             case Poppler::Page::Seascape: orientation = Okular::Rotation270; break;
             case Poppler::Page::Portrait: orientation = Okular::Rotation0; break;
             }
-            if (rotation % 2 == 1)
-            qSwap(w,h);
-            // init a Okular::page, add transition and annotation information
+            // init a Okular::page, the transition, annotation, action and
+            // form information is loaded when needed (see loadPageMetadata)
             page = new Okular::Page( i, w, h, orientation );
-            addTransition( p, page );
-            if ( true ) //TODO real check
-            addAnnotations( p, page );
-            Poppler::Link * tmplink = p->action( Poppler::Page::Opening );
-            if ( tmplink )
-            {
-                page->setPageAction( Okular::Page::Opening, createLinkFromPopplerLink( tmplink ) );
-            }
-            tmplink = p->action( Poppler::Page::Closing );
-            if ( tmplink )
-            {
-                page->setPageAction( Okular::Page::Closing, createLinkFromPopplerLink( tmplink ) );
-            }
             page->setDuration( p->duration() );
             page->setLabel( p->label() );
-
-            addFormFields( p, page );
+            page->setMetadataLoaded( false );
 //        kWarning(PDFDebug).nospace() << page->width() << "x" << page->height();
 
 #ifdef PDFGENERATOR_DEBUG
-            kDebug(PDFDebug) << "load page" << i << "with rotation" << rotation << "and orientation" << orientation;
+            kDebug(PDFDebug) << "load page" << i << "with orientation" << orientation;
 #endif
             delete p;
-
-            if (clear && pagesVector[i])
-                delete pagesVector[i];
         }
         else
         {
             page = new Okular::Page( i, defaultPageWidth, defaultPageHeight, Okular::Rotation0 );
         }
-        // set the Okular::page at the right position in document's pages vector
-        pagesVector[i] = page;
+        // append the Okular::page to document's pages vector
+        pagesVector.append(page);
     }
 }
 
+void PDFGenerator::loadPageMetadata( Okular::Page * page )
+{
+    QMutexLocker ml( userMutex() );
+
+    Poppler::Page * p = pdfdoc ? pdfdoc->page( page->number() ) : 0;
+    if ( !p )
+        return;
+
+    addTransition( p, page );
+    addAnnotations( p, page );
+    Poppler::Link * tmplink = p->action( Poppler::Page::Opening );
+    if ( tmplink )
+    {
+        page->setPageAction( Okular::Page::Opening, createLinkFromPopplerLink( tmplink ) );
+    }
+    tmplink = p->action( Poppler::Page::Closing );
+    if ( tmplink )
+    {
+        page->setPageAction( Okular::Page::Closing, createLinkFromPopplerLink( tmplink ) );
+    }
+
+    addFormFields( p, page );
+    if ( !page->formFields().isEmpty() )
+        hasFormFields = true;
+
+    // TODO previously we extracted Image type rects too, but that needed porting to poppler
+    // and as we are not doing anything with Image type rects i did not port it, have a look at
+    // dead gp_outputdev.cpp on image extraction
+    page->setObjectRects( generateLinks(p->links()) );
+
+    resolveMediaLinkReferences( page );
+
+    delete p;
+}
+
 const Okular::DocumentInfo * PDFGenerator::generateDocumentInfo()
 {
     if ( docInfoDirty )
@@ -910,15 +967,29 @@ QImage PDFGenerator::image( Okular::PixmapRequest * request )
     qreal fakeDpiX = request->width() / pageWidth * dpi().width();
     qreal fakeDpiY = request->height() / pageHeight * dpi().height();
 
-    // generate links rects only the first time
-    bool genObjectRects = !rectsGenerated.at( page->number() );
-
-    // 0. LOCK [waits for the thread end]
-    userMutex()->lock();
+    // render with a private copy of the document when possible, so that
+    // other threads can use the main one in the meanwhile
+    Poppler::Document *renderdoc = takeRenderDocument();
+    if ( renderdoc )
+    {
+        // a quick preview of the page, the private copy gets the settings
+        // of the main document back when taken again
+        if ( request->isPreview() )
+        {
+            renderdoc->setRenderHint( Poppler::Document::Antialiasing, false );
+            renderdoc->setRenderHint( Poppler::Document::TextAntialiasing, false );
+        }
+    }
+    else
+    {
+        // 0. LOCK [waits for the thread end]
+        userMutex()->lock();
+        renderdoc = pdfdoc;
+    }
 
     // 1. Set OutputDev parameters and Generate contents
     // note: thread safety is set on 'false' for the GUI (this) thread
-    Poppler::Page *p = pdfdoc->page(page->number());
+    Poppler::Page *p = renderdoc->page(page->number());
 
     // 2. Take data from outputdev and attach it to the Page
     QImage img;
@@ -940,23 +1011,115 @@ QImage PDFGenerator::image( Okular::PixmapRequest * request )
         img.fill( Qt::white );
     }
 
-    if ( p && genObjectRects )
+    delete p;
+
+    // 3. UNLOCK [re-enables shared access]
+    if ( renderdoc == pdfdoc )
+        userMutex()->unlock();
+    else
+        releaseRenderDocument( renderdoc );
+
+    return img;
+}
+
+Poppler::Document *PDFGenerator::takeRenderDocument()
+{
+    // NOTE: userMutex() must not be locked by the caller
+
+    // with one render thread the main document is enough
+    if ( renderThreadCount() < 2 )
+        return 0;
+
+    userMutex()->lock();
+    // the copies would not show the changes made to annotations and forms
+    if ( !pdfdoc || hasFormFields || ( annotProxy && annotProxy->hasModifiedDocument() ) )
     {
-        // TODO previously we extracted Image type rects too, but that needed porting to poppler
-        // and as we are not doing anything with Image type rects i did not port it, have a look at
-        // dead gp_outputdev.cpp on image extraction
-        page->setObjectRects( generateLinks(p->links()) );
-        rectsGenerated[ request->page()->number() ] = true;
+        userMutex()->unlock();
+        return 0;
+    }
+    const QByteArray data = documentData;
+    const QString filePath = documentFilePath;
+    const QByteArray identity = documentFileIdentity;
+    const QByteArray password = documentPassword;
+    const QColor paperColor = pdfdoc->paperColor();
+    const Poppler::Document::RenderHints hints = pdfdoc->renderHints();
+    userMutex()->unlock();
 
-        resolveMediaLinkReferences( page );
+    Poppler::Document *doc = 0;
+    renderDocumentsMutex.lock();
+    if ( !renderDocuments.isEmpty() )
+        doc = renderDocuments.takeLast();
+    renderDocumentsMutex.unlock();
+
+    if ( !doc )
+    {
+        // parsing the document can take a while, so do it without blocking
+        // the users of the main document
+        if ( !data.isEmpty() )
+        {
+            doc = Poppler::Document::loadFromData( data, password, password );
+        }
+        else
+        {
+            // the file must still be the one the main document was loaded
+            // from, otherwise the copy would render different pages
+            if ( identity.isEmpty() || fileIdentity( filePath ) != identity )
+                return 0;
+            doc = Poppler::Document::load( filePath, password, password );
+            if ( doc && fileIdentity( filePath ) != identity )
+            {
+                delete doc;
+                return 0;
+            }
+        }
+        if ( !doc || doc->isLocked() )
+        {
+            delete doc;
+            return 0;
+        }
     }
 
-    // 3. UNLOCK [re-enables shared access]
-    userMutex()->unlock();
+    // keep the render settings in sync with the main document
+    doc->setPaperColor( paperColor );
+#define SYNC_HINT(hintflag) doc->setRenderHint( hintflag, hints.testFlag( hintflag ) );
+    SYNC_HINT(Poppler::Document::Antialiasing)
+    SYNC_HINT(Poppler::Document::TextAntialiasing)
+#ifdef HAVE_POPPLER_0_12_1
+    SYNC_HINT(Poppler::Document::TextHinting)
+#endif
+#ifdef HAVE_POPPLER_0_24
+    SYNC_HINT(Poppler::Document::ThinLineSolid)
+    SYNC_HINT(Poppler::Document::ThinLineShape)
+#endif
+#undef SYNC_HINT
 
-    delete p;
+    return doc;
+}
 
-    return img;
+int PDFGenerator::renderThreadCount()
+{
+    int threads = Okular::SettingsCore::renderThreads();
+    if ( threads <= 0 )
+        threads = QThread::idealThreadCount();
+    return threads;
+}
+
+QByteArray PDFGenerator::fileIdentity( const QString &filePath )
+{
+    // a file replaced or rewritten gets another inode or modification time
+    KDE_struct_stat st;
+    if ( KDE::stat( filePath, &st ) != 0 )
+        return QByteArray();
+
+    return QByteArray::number( (qulonglong)st.st_ino ) + ':'
+        + QByteArray::number( (qlonglong)st.st_size ) + ':'
+        + QByteArray::number( (qlonglong)st.st_mtime );
+}
+
+void PDFGenerator::releaseRenderDocument( Poppler::Document *doc )
+{
+    QMutexLocker locker( &renderDocumentsMutex );
+    renderDocuments.append( doc );
 }
 
 template <typename PopplerLinkType, typename OkularLinkType, typename PopplerAnnotationType, typename OkularAnnotationType>
@@ -1042,12 +1205,19 @@ Okular::TextPage* PDFGenerator::textPage( Okular::Page *page )
     // build a TextList...
     QList<Poppler::TextBox*> textList;
     double pageWidth, pageHeight;
-    Poppler::Page *pp = pdfdoc->page( page->number() );
-    if (pp)
+    // extract with a private copy of the document when possible, so that
+    // several pages can be processed at the same time
+    Poppler::Document *textdoc = takeRenderDocument();
+    if ( !textdoc )
     {
         userMutex()->lock();
+        textdoc = pdfdoc;
+    }
+
+    Poppler::Page *pp = textdoc->page( page->number() );
+    if (pp)
+    {
         textList = pp->textList();
-        userMutex()->unlock();
 
         QSizeF s = pp->pageSizeF();
         pageWidth = s.width();
@@ -1061,6 +1231,11 @@ Okular::TextPage* PDFGenerator::textPage( Okular::Page *page )
         pageHeight = defaultPageHeight;
     }
 
+    if ( textdoc == pdfdoc )
+        userMutex()->unlock();
+    else
+        releaseRenderDocument( textdoc );
+
     Okular::TextPage *tp = abstractTextPage(textList, pageHeight, pageWidth, (Poppler::Page::Rotation)page->orientation());
     qDeleteAll(textList);
     return tp;
@@ -1267,6 +1442,22 @@ QVariant PDFGenerator::metaData( const QString & key, const QVariant & option )
         return false;
 #endif
     }
+    else if ( key == "HasForms" )
+    {
+        // whether the pages may have form fields, without loading them
+#ifdef HAVE_POPPLER_0_22
+        QMutexLocker ml(userMutex());
+        return pdfdoc->formType() == Poppler::Document::AcroForm;
+#else
+        return false;
+#endif
+    }
+    else if ( key == "RenderSettings" )
+    {
+        // the settings of ours that change the rendered pages, besides the
+        // ones of the document
+        return QString::number( PDFSettings::enhanceThinLines() );
+    }
     return QVariant();
 }
 
@@ -1542,7 +1733,7 @@ void PDFGenerator::addAnnotations( Poppler::Page * popplerPage, Okular::Page * p
 }
 
 void PDFGenerator::addTransition( Poppler::Page * pdfPage, Okular::Page * page )
-// called on opening when MUTEX is not used
+// called from loadPageMetadata() with the MUTEX locked
 {
     Poppler::PageTransition *pdfTransition = pdfPage->transition();
     if ( !pdfTransition || pdfTransition->type() == Poppler::PageTransition::Replace )
@@ -17,7 +17,7 @@
 
 #include <poppler-qt4.h>
 
-#include <qbitarray.h>
+#include <qmutex.h>
 #include <qpointer.h>
 
 #include <core/document.h>
@@ -62,7 +62,11 @@ class PDFGenerator : public Okular::Generator, public Okular::ConfigInterface, p
         // [INHERITED] load a document and fill up the pagesVector
         bool loadDocument( const QString & fileName, QVector<Okular::Page*> & pagesVector );
         bool loadDocumentFromData( const QByteArray & fileData, QVector<Okular::Page*> & pagesVector );
-        void loadPages(QVector<Okular::Page*> &pagesVector, int rotation=-1, bool clear=false);
+        void loadPages(QVector<Okular::Page*> &pagesVector, int count);
+        // [INHERITED] load the pages loadDocument() did not load
+        bool loadMorePages( QVector<Okular::Page*> & pagesVector );
+        // [INHERITED] load the annotations, forms, transition and actions of a page
+        void loadPageMetadata( Okular::Page * page );
         // [INHERITED] document information
         const Okular::DocumentInfo * generateDocumentInfo();
         const Okular::DocumentSynopsis * generateDocumentSynopsis();
@@ -132,9 +136,24 @@ class PDFGenerator : public Okular::Generator, public Okular::ConfigInterface, p
 
         bool setDocumentRenderHints();
 
+        // get/give back a private copy of the document for a render thread
+        Poppler::Document *takeRenderDocument();
+        void releaseRenderDocument( Poppler::Document *doc );
+        static int renderThreadCount();
+        static QByteArray fileIdentity( const QString &filePath );
+
         // poppler dependant stuff
         Poppler::Document *pdfdoc;
 
+        // idle copies of pdfdoc, so that several pages can be rendered at once
+        QList<Poppler::Document*> renderDocuments;
+        QMutex renderDocumentsMutex;
+        QByteArray documentData;
+        QString documentFilePath;
+        QByteArray documentFileIdentity;
+        QByteArray documentPassword;
+        bool hasFormFields;
+
 
         // misc variables for document info and synopsis caching
         bool docInfoDirty;
@@ -147,8 +166,6 @@ class PDFGenerator : public Okular::Generator, public Okular::ConfigInterface, p
         PopplerAnnotationProxy *annotProxy;
         QHash<Okular::Annotation*, Poppler::Annotation*> annotationsHash;
 
-        QBitArray rectsGenerated;
-
         QPointer<PDFOptionsPage> pdfOptionsPage;
         
         synctex_scanner_t synctex_scanner;
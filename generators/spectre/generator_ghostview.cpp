@@ -54,16 +54,16 @@ OKULAR_EXPORT_PLUGIN(GSGenerator, createAboutData())
 GSGenerator::GSGenerator( QObject *parent, const QVariantList &args ) :
     Okular::Generator( parent, args ),
     m_internalDocument(0),
-    m_docInfo(0),
-    m_request(0)
+    m_docInfo(0)
 {
+    // the rendering is done by the threads of GSRendererPool
+    setFeature( Threaded );
     setFeature( PrintPostscript );
     setFeature( PrintToFile );
 
-    GSRendererThread *renderer = GSRendererThread::getCreateRenderer();
-    if (!renderer->isRunning()) renderer->start();
-    connect(renderer, SIGNAL(imageDone(QImage*,Okular::PixmapRequest*)),
-                      SLOT(slotImageGenerated(QImage*,Okular::PixmapRequest*)),
+    GSRendererPool *renderer = GSRendererPool::self();
+    connect(renderer, SIGNAL(imageDone(GSGenerator*,QImage*,Okular::PixmapRequest*)),
+                      SLOT(slotImageGenerated(GSGenerator*,QImage*,Okular::PixmapRequest*)),
                       Qt::QueuedConnection);
 }
 
@@ -188,19 +188,23 @@ bool GSGenerator::doCloseDocument()
     return true;
 }
 
-void GSGenerator::slotImageGenerated(QImage *img, Okular::PixmapRequest *request)
+void GSGenerator::slotImageGenerated(GSGenerator *owner, QImage *img, Okular::PixmapRequest *request)
 {
-    // This can happen as GSInterpreterCMD is a singleton and on creation signals all the slots
-    // of all the generators attached to it
-    if (request != m_request) return;
+    // The renderers are shared by all the generators, and signal all of them
+    if (owner != this || !m_requests.contains(request)) return;
 
-    if ( !request->page()->isBoundingBoxKnown() )
-        updatePageBoundingBox( request->page()->number(), Okular::Utils::imageBoundingBox( img ) );
+    spectre_page_free(m_requests.take(request));
 
-    m_request = 0;
-    QPixmap *pix = new QPixmap(QPixmap::fromImage(*img));
+    // img is null for the requests dropped without rendering them
+    if (img && !request->shouldAbortRender())
+    {
+        if ( !request->isPreview() && !request->page()->isBoundingBoxKnown() )
+            updatePageBoundingBox( request->page()->number(), Okular::Utils::imageBoundingBox( img ) );
+
+        QPixmap *pix = new QPixmap(QPixmap::fromImage(*img));
+        request->page()->setPixmap( request->observer(), pix );
+    }
     delete img;
-    request->page()->setPixmap( request->observer(), pix );
     signalPixmapRequestDone( request );
 }
 
@@ -231,7 +235,7 @@ void GSGenerator::generatePixmap( Okular::PixmapRequest * req )
 
     SpectrePage *page = spectre_document_get_page(m_internalDocument, req->pageNumber());
 
-    GSRendererThread *renderer = GSRendererThread::getCreateRenderer();
+    GSRendererPool *renderer = GSRendererPool::self();
 
     GSRendererThreadRequest gsreq(this);
     gsreq.spectrePage = page;
@@ -256,13 +260,14 @@ void GSGenerator::generatePixmap( Okular::PixmapRequest * req )
                               (double)req->height() / req->page()->height() );
     }
     gsreq.request = req;
-    m_request = req;
+    m_requests.insert(req, page);
     renderer->addRequest(gsreq);
 }
 
 bool GSGenerator::canGeneratePixmap() const
 {
-    return !m_request;
+    // one request per render thread, they may all go to this document
+    return m_requests.count() < GSRendererPool::self()->threadCount();
 }
 
 const Okular::DocumentInfo * GSGenerator::generateDocumentInfo()
@@ -10,6 +10,8 @@
 #ifndef _OKULAR_GENERATOR_GHOSTVIEW_H_
 #define _OKULAR_GENERATOR_GHOSTVIEW_H_
 
+#include <qhash.h>
+
 #include <core/generator.h>
 #include <interfaces/configinterface.h>
 
@@ -48,7 +50,7 @@ class GSGenerator : public Okular::Generator, public Okular::ConfigInterface
         ~GSGenerator();
 
     public slots:
-        void slotImageGenerated(QImage *img, Okular::PixmapRequest *request);
+        void slotImageGenerated(GSGenerator *owner, QImage *img, Okular::PixmapRequest *request);
 
     protected:
         bool doCloseDocument();
@@ -61,7 +63,8 @@ class GSGenerator : public Okular::Generator, public Okular::ConfigInterface
         SpectreDocument *m_internalDocument;
         Okular::DocumentInfo *m_docInfo;
 
-        Okular::PixmapRequest *m_request;
+        // the requests being rendered, with their spectre page
+        QHash<Okular::PixmapRequest*, SpectrePage*> m_requests;
 
         bool cache_AAtext;
         bool cache_AAgfx;
@@ -16,16 +16,92 @@
 #include "core/generator.h"
 #include "core/page.h"
 #include "core/utils.h"
+#include "settings_core.h"
 
-GSRendererThread *GSRendererThread::theRenderer = 0;
+GSRendererPool *GSRendererPool::thePool = 0;
 
-GSRendererThread *GSRendererThread::getCreateRenderer()
+GSRendererPool *GSRendererPool::self()
 {
-    if (!theRenderer) theRenderer = new GSRendererThread();
-    return theRenderer;
+    if (!thePool) thePool = new GSRendererPool();
+    return thePool;
 }
 
-GSRendererThread::GSRendererThread()
+GSRendererPool::GSRendererPool()
+{
+    int threads = Okular::SettingsCore::renderThreads();
+    if (threads <= 0)
+        threads = QThread::idealThreadCount();
+    threads = qMax(1, threads);
+
+    for (int i = 0; i < threads; ++i)
+    {
+        GSRendererThread *thread = new GSRendererThread(this);
+        m_threads.append(thread);
+        thread->start();
+    }
+}
+
+int GSRendererPool::threadCount() const
+{
+    return m_threads.count();
+}
+
+void GSRendererPool::addRequest(const GSRendererThreadRequest &req)
+{
+    QMutexLocker locker(&m_queueMutex);
+    dropAbortedRequests(req.owner);
+    m_queues[req.owner].enqueue(req);
+    if (!m_owners.contains(req.owner))
+        m_owners.append(req.owner);
+    m_queueCondition.wakeOne();
+}
+
+void GSRendererPool::dropAbortedRequests(GSGenerator *owner)
+{
+    QHash<GSGenerator*, QQueue<GSRendererThreadRequest> >::iterator it = m_queues.find(owner);
+    if (it == m_queues.end())
+        return;
+
+    QQueue<GSRendererThreadRequest> &queue = it.value();
+    for (int i = 0; i < queue.count(); )
+    {
+        if (queue.at(i).request->shouldAbortRender())
+            emit imageDone(owner, 0, queue.takeAt(i).request);
+        else
+            ++i;
+    }
+}
+
+GSRendererThreadRequest GSRendererPool::takeRequest()
+{
+    QMutexLocker locker(&m_queueMutex);
+    while (1)
+    {
+        while (!m_owners.isEmpty())
+        {
+            // the documents take turns, the one served goes to the back
+            GSGenerator *owner = m_owners.takeFirst();
+            dropAbortedRequests(owner);
+            QQueue<GSRendererThreadRequest> &queue = m_queues[owner];
+            if (queue.isEmpty())
+            {
+                m_queues.remove(owner);
+                continue;
+            }
+
+            const GSRendererThreadRequest req = queue.dequeue();
+            if (queue.isEmpty())
+                m_queues.remove(owner);
+            else
+                m_owners.append(owner);
+            return req;
+        }
+        m_queueCondition.wait(&m_queueMutex);
+    }
+}
+
+GSRendererThread::GSRendererThread(GSRendererPool *pool)
+    : m_pool(pool)
 {
     m_renderContext = spectre_render_context_new();
 }
@@ -35,23 +111,26 @@ GSRendererThread::~GSRendererThread()
     spectre_render_context_free(m_renderContext);
 }
 
-void GSRendererThread::addRequest(const GSRendererThreadRequest &req)
+bool GSRendererThread::renderPage(const GSRendererThreadRequest &req, unsigned char **data, int *rowLength, bool exclusive)
 {
-    m_queueMutex.lock();
-    m_queue.enqueue(req);
-    m_queueMutex.unlock();
-    m_semaphore.release();
+    if (exclusive)
+        m_pool->m_ghostscriptLock.lockForWrite();
+    else
+        m_pool->m_ghostscriptLock.lockForRead();
+
+    spectre_page_render(req.spectrePage, m_renderContext, data, rowLength);
+    const bool ok = *data && spectre_page_status(req.spectrePage) == SPECTRE_STATUS_SUCCESS;
+
+    m_pool->m_ghostscriptLock.unlock();
+    return ok;
 }
 
 void GSRendererThread::run()
 {
     while(1)
     {
-        m_semaphore.acquire();
         {
-            m_queueMutex.lock();
-            GSRendererThreadRequest req = m_queue.dequeue();
-            m_queueMutex.unlock();
+            const GSRendererThreadRequest req = m_pool->takeRequest();
 
             spectre_render_context_set_scale(m_renderContext, req.magnify, req.magnify);
             spectre_render_context_set_use_platform_fonts(m_renderContext, req.platformFonts);
@@ -68,7 +147,15 @@ void GSRendererThread::run()
             if ( req.orientation % 2 )
                 qSwap( wantedWidth, wantedHeight );
 
-            spectre_page_render(req.spectrePage, m_renderContext, &data, &row_length);
+            // Ghostscript builds that are not thread safe run only one
+            // interpreter at a time, try again with the others waiting
+            if (!renderPage(req, &data, &row_length, false) && m_pool->threadCount() > 1)
+            {
+                free(data);
+                data = NULL;
+                row_length = 0;
+                renderPage(req, &data, &row_length, true);
+            }
 
             // Qt needs the missing alpha of QImage::Format_RGB32 to be 0xff
             if (data && data[3] != 0xff)
@@ -126,9 +213,7 @@ void GSRendererThread::run()
                 delete image;
                 image = new QImage(aux);
             }
-            emit imageDone(image, req.request);
-
-            spectre_page_free(req.spectrePage);
+            emit m_pool->imageDone(req.owner, image, req.request);
         }
     }
 }
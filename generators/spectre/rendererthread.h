@@ -10,16 +10,20 @@
 #ifndef _OKULAR_GSRENDERERTHREAD_H_
 #define _OKULAR_GSRENDERERTHREAD_H_
 
+#include <qhash.h>
+#include <qlist.h>
 #include <qmutex.h>
 #include <qqueue.h>
-#include <qsemaphore.h>
+#include <qreadwritelock.h>
 #include <qstring.h>
 #include <qthread.h>
+#include <qwaitcondition.h>
 
 #include <libspectre/spectre.h>
 
 class QImage;
 class GSGenerator;
+class GSRendererPool;
 
 namespace Okular
 {
@@ -41,6 +45,7 @@ struct GSRendererThreadRequest
 
     GSGenerator *owner;
     Okular::PixmapRequest *request;
+    // owned by the generator, it is not freed by the render threads
     SpectrePage *spectrePage;
     int textAAbits;
     int graphicsAAbits;
@@ -51,30 +56,68 @@ struct GSRendererThreadRequest
 Q_DECLARE_TYPEINFO(GSRendererThreadRequest, Q_MOVABLE_TYPE);
 
 class GSRendererThread : public QThread
+{
+    public:
+        GSRendererThread(GSRendererPool *pool);
+        ~GSRendererThread();
+
+    private:
+        void run();
+        bool renderPage(const GSRendererThreadRequest &req, unsigned char **data, int *rowLength, bool exclusive);
+
+        GSRendererPool *m_pool;
+        SpectreRenderContext *m_renderContext;
+};
+
+/**
+ * The Ghostscript renderers shared by all the PostScript documents.
+ *
+ * Each render thread has its own spectre render context. The requests are
+ * queued per document and the threads serve the documents in turn, so that
+ * a long document does not hold back the pages of the others.
+ */
+class GSRendererPool : public QObject
 {
 Q_OBJECT
     public:
-        static GSRendererThread *getCreateRenderer();
+        static GSRendererPool *self();
 
-        ~GSRendererThread();
+        /**
+         * The number of render threads, and so of the requests a document
+         * can usefully have in flight.
+         */
+        int threadCount() const;
 
         void addRequest(const GSRendererThreadRequest &req);
 
     signals:
-        void imageDone(QImage *image, Okular::PixmapRequest *request);
+        /**
+         * The @p image of @p request, a null one if the request was dropped
+         * without rendering it. The image belongs to @p owner.
+         */
+        void imageDone(GSGenerator *owner, QImage *image, Okular::PixmapRequest *request);
 
     private:
-        GSRendererThread();
+        GSRendererPool();
 
-        QSemaphore m_semaphore;
+        // waits for the next request to render
+        GSRendererThreadRequest takeRequest();
+        // drops the requests the document does not want any more from the
+        // queue of @p owner, m_queueMutex must be locked
+        void dropAbortedRequests(GSGenerator *owner);
 
-        static GSRendererThread *theRenderer;
+        friend class GSRendererThread;
 
-        void run();
+        static GSRendererPool *thePool;
 
-        SpectreRenderContext *m_renderContext;
-        QQueue<GSRendererThreadRequest> m_queue;
+        QList<GSRendererThread*> m_threads;
         QMutex m_queueMutex;
+        QWaitCondition m_queueCondition;
+        QHash<GSGenerator*, QQueue<GSRendererThreadRequest> > m_queues;
+        // the documents with queued requests, the next one to serve first
+        QList<GSGenerator*> m_owners;
+        // held for writing by the renders that need Ghostscript for themselves
+        QReadWriteLock m_ghostscriptLock;
 };
 
 #endif
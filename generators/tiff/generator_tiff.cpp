@@ -15,7 +15,9 @@
 #include <qfileinfo.h>
 #include <qimage.h>
 #include <qlist.h>
+#include <qmutex.h>
 #include <qpainter.h>
+#include <qvector.h>
 #include <QtGui/QPrinter>
 
 #include <kaboutdata.h>
@@ -24,6 +26,7 @@
 #include <klocale.h>
 
 #include <core/document.h>
+#include <core/area.h>
 #include <core/page.h>
 #include <core/fileprinter.h>
 #include <core/utils.h>
@@ -90,13 +93,71 @@ class TIFFGenerator::Private
 {
     public:
         Private()
-          : tiff( 0 ), dev( 0 ) {}
+          : tiff( 0 ), dev( 0 ), nextDirectory( 0 ), allDirectoriesRead( false ),
+            readingDirectories( false ) {}
+
+        // a reduced resolution version of a page: a directory of its own,
+        // or a SubIFD of the directory of the page; the size of a SubIFD is
+        // only read when needed
+        struct ResolutionLevel
+        {
+            tdir_t directory;
+            toff_t subDirectory;
+            uint32 width;
+            uint32 height;
+        };
+
+        bool setLevel( const ResolutionLevel &level );
+        const ResolutionLevel *selectLevel( int page, tdir_t pageDirectory, uint32 width, uint32 height );
 
         TIFF* tiff;
         QByteArray data;
         QIODevice* dev;
+        // the next directory to read pages from, see loadPages()
+        tdir_t nextDirectory;
+        bool allDirectoriesRead;
+        // whether the current directory is the last one read by loadPages()
+        bool readingDirectories;
+        QHash< int, QVector< ResolutionLevel > > levels;
 };
 
+bool TIFFGenerator::Private::setLevel( const ResolutionLevel &level )
+{
+    if ( !TIFFSetDirectory( tiff, level.directory ) )
+        return false;
+    return !level.subDirectory || TIFFSetSubDirectory( tiff, level.subDirectory );
+}
+
+// sets the smallest version of the page still as big as @p width x @p height
+// and returns it, or sets the directory of the page and returns 0
+const TIFFGenerator::Private::ResolutionLevel *TIFFGenerator::Private::selectLevel( int page, tdir_t pageDirectory, uint32 width, uint32 height )
+{
+    QHash< int, QVector< ResolutionLevel > >::iterator it = levels.find( page );
+    if ( it == levels.end() )
+        return 0;
+
+    const ResolutionLevel *best = 0;
+    QVector< ResolutionLevel > &pageLevels = it.value();
+    for ( int i = 0; i < pageLevels.count(); ++i )
+    {
+        ResolutionLevel &level = pageLevels[i];
+        if ( level.width == 0 && setLevel( level ) )
+        {
+            TIFFGetField( tiff, TIFFTAG_IMAGEWIDTH, &level.width );
+            TIFFGetField( tiff, TIFFTAG_IMAGELENGTH, &level.height );
+        }
+
+        if ( level.width >= width && level.height >= height && ( !best || level.width < best->width ) )
+            best = &level;
+    }
+
+    if ( best && setLevel( *best ) )
+        return best;
+
+    TIFFSetDirectory( tiff, pageDirectory );
+    return 0;
+}
+
 static QDateTime convertTIFFDateTime( const char* tiffdate )
 {
     if ( !tiffdate )
@@ -158,6 +219,33 @@ static Okular::Rotation readTiffRotation( TIFF *tiff )
     return ret;
 }
 
+// reads the part @p rect of the image of the current directory
+static bool readTiffImage( TIFF *tiff, const QRect &rect, uint32 orientation, QImage *image )
+{
+    char emsg[1024];
+    TIFFRGBAImage img;
+    if ( !TIFFRGBAImageOK( tiff, emsg ) || !TIFFRGBAImageBegin( &img, tiff, 0, emsg ) )
+    {
+        kWarning(TiffDebug) << "Cannot read the image:" << emsg;
+        return false;
+    }
+
+    // only the strips or tiles holding the part are decoded
+    img.req_orientation = orientation;
+    img.row_offset = rect.y();
+    img.col_offset = rect.x();
+
+    QImage result( rect.width(), rect.height(), QImage::Format_RGB32 );
+    const bool ok = TIFFRGBAImageGet( &img, (uint32 *)result.bits(), rect.width(), rect.height() ) != 0;
+    TIFFRGBAImageEnd( &img );
+    if ( !ok )
+        return false;
+
+    // an image read by TIFFRGBAImageGet is ABGR, we need ARGB, so swap red and blue
+    *image = result.rgbSwapped();
+    return true;
+}
+
 static KAboutData createAboutData()
 {
     KAboutData aboutData(
@@ -184,6 +272,9 @@ TIFFGenerator::TIFFGenerator( QObject *parent, const QVariantList &args )
     setFeature( PrintNative );
     setFeature( PrintToFile );
     setFeature( ReadRawData );
+    setFeature( IncrementalLoading );
+    setFeature( CachedRendering );
+    setFeature( TiledRendering );
 }
 
 TIFFGenerator::~TIFFGenerator()
@@ -230,11 +321,24 @@ bool TIFFGenerator::loadTiff( QVector< Okular::Page * > & pagesVector, const cha
         return false;
     }
 
-    loadPages( pagesVector );
+    // only read the first directories, loadMorePages() reads the others
+    pagesVector.clear();
+    loadPages( pagesVector, 20 );
 
     return true;
 }
 
+bool TIFFGenerator::loadMorePages( QVector<Okular::Page*> & pagesVector )
+{
+    // don't wait for the page being rendered, the document will ask again
+    if ( !userMutex()->tryLock() )
+        return true;
+
+    const bool morePages = loadPages( pagesVector, 10 );
+    userMutex()->unlock();
+    return morePages;
+}
+
 bool TIFFGenerator::doCloseDocument()
 {
     // closing the old document
@@ -248,6 +352,10 @@ bool TIFFGenerator::doCloseDocument()
         delete m_docInfo;
         m_docInfo = 0;
         m_pageMapping.clear();
+        d->levels.clear();
+        d->nextDirectory = 0;
+        d->allDirectoriesRead = false;
+        d->readingDirectories = false;
     }
 
     return true;
@@ -258,9 +366,28 @@ QImage TIFFGenerator::image( Okular::PixmapRequest * request )
     bool generated = false;
     QImage img;
 
-    if ( TIFFSetDirectory( d->tiff, mapPage( request->page()->number() ) ) )
+    // the size of the whole page, and the part of it to render
+    int pageWidth = request->width();
+    int pageHeight = request->height();
+    Okular::NormalizedRect rect( 0, 0, 1, 1 );
+    if ( request->isTile() )
+    {
+        rect = request->normalizedRect();
+    }
+    else if ( request->page()->rotation() % 2 == 1 )
+    {
+        qSwap( pageWidth, pageHeight );
+    }
+    const QSize destSize = rect.geometry( pageWidth, pageHeight ).size();
+
+    // the pages may still be loaded from the main thread
+    QMutexLocker locker( userMutex() );
+    d->readingDirectories = false;
+
+    const int pageNumber = request->page()->number();
+    const tdir_t directory = mapPage( pageNumber );
+    if ( TIFFSetDirectory( d->tiff, directory ) )
     {
-        int rotation = request->page()->rotation();
         uint32 width = 1;
         uint32 height = 1;
         uint32 orientation = 0;
@@ -270,26 +397,30 @@ QImage TIFFGenerator::image( Okular::PixmapRequest * request )
         if ( !TIFFGetField( d->tiff, TIFFTAG_ORIENTATION, &orientation ) )
             orientation = ORIENTATION_TOPLEFT;
 
-        QImage image( width, height, QImage::Format_RGB32 );
-        uint32 * data = (uint32 *)image.bits();
-
-        // read data
-        if ( TIFFReadRGBAImageOriented( d->tiff, width, height, data, orientation ) != 0 )
+        // decode the smallest version of the page still as big as requested,
+        // whose size does not take the orientation of the page into account
+        uint32 neededWidth = pageWidth;
+        uint32 neededHeight = pageHeight;
+        if ( request->page()->orientation() % 2 == 1 )
+            qSwap( neededWidth, neededHeight );
+        const Private::ResolutionLevel *level = d->selectLevel( pageNumber, directory, neededWidth, neededHeight );
+        if ( level )
         {
-            // an image read by ReadRGBAImage is ABGR, we need ARGB, so swap red and blue
-            uint32 size = width * height;
-            for ( uint32 i = 0; i < size; ++i )
-            {
-                uint32 red = ( data[i] & 0x00FF0000 ) >> 16;
-                uint32 blue = ( data[i] & 0x000000FF ) << 16;
-                data[i] = ( data[i] & 0xFF00FF00 ) + red + blue;
-            }
+            width = level->width;
+            height = level->height;
+        }
 
-            int reqwidth = request->width();
-            int reqheight = request->height();
-            if ( rotation % 2 == 1 )
-                qSwap( reqwidth, reqheight );
-            img = image.scaled( reqwidth, reqheight, Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
+        const QRect srcRect = rect.geometry( width, height ) & QRect( 0, 0, width, height );
+        // the row and column offsets select the part in the order the image
+        // is stored, which is the order it is shown in only for top-left
+        // images: decode the others whole, then cut the part out of them
+        const bool wholeImage = orientation != ORIENTATION_TOPLEFT && srcRect != QRect( 0, 0, width, height );
+        QImage image;
+        if ( !srcRect.isEmpty() && !destSize.isEmpty() && readTiffImage( d->tiff, wholeImage ? QRect( 0, 0, width, height ) : srcRect, orientation, &image ) )
+        {
+            if ( wholeImage )
+                image = image.copy( srcRect );
+            img = image.size() == destSize ? image : image.scaled( destSize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation );
 
             generated = true;
         }
@@ -297,7 +428,7 @@ QImage TIFFGenerator::image( Okular::PixmapRequest * request )
 
     if ( !generated )
     {
-        img = QImage( request->width(), request->height(), QImage::Format_RGB32 );
+        img = QImage( destSize, QImage::Format_RGB32 );
         img.fill( qRgb( 255, 255, 255 ) );
     }
 
@@ -340,14 +471,10 @@ const Okular::DocumentInfo * TIFFGenerator::generateDocumentInfo()
     return m_docInfo;
 }
 
-void TIFFGenerator::loadPages( QVector<Okular::Page*> & pagesVector )
+bool TIFFGenerator::loadPages( QVector<Okular::Page*> & pagesVector, int maxPages )
 {
-    if ( !d->tiff )
-        return;
-
-    tdir_t dirs = TIFFNumberOfDirectories( d->tiff );
-    pagesVector.resize( dirs );
-    tdir_t realdirs = 0;
+    if ( !d->tiff || d->allDirectoriesRead )
+        return false;
 
     uint32 width = 0;
     uint32 height = 0;
@@ -355,27 +482,66 @@ void TIFFGenerator::loadPages( QVector<Okular::Page*> & pagesVector )
     const double dpiX = Okular::Utils::dpiX();
     const double dpiY = Okular::Utils::dpiY();
 
-    for ( tdir_t i = 0; i < dirs; ++i )
+    const int lastPage = pagesVector.count() + maxPages;
+    while ( pagesVector.count() < lastPage )
     {
-        if ( !TIFFSetDirectory( d->tiff, i ) )
-            continue;
-
-        if ( TIFFGetField( d->tiff, TIFFTAG_IMAGEWIDTH, &width ) != 1 ||
-             TIFFGetField( d->tiff, TIFFTAG_IMAGELENGTH, &height ) != 1 )
-            continue;
-
-        adaptSizeToResolution( d->tiff, TIFFTAG_XRESOLUTION, dpiX, &width );
-        adaptSizeToResolution( d->tiff, TIFFTAG_YRESOLUTION, dpiY, &height );
+        const tdir_t i = d->nextDirectory++;
+        // reading the directories one after the other is much faster than
+        // setting each of them, as that walks the directories from the first one
+        const bool ok = i > 0 && d->readingDirectories && TIFFCurrentDirectory( d->tiff ) == i - 1
+                        ? TIFFReadDirectory( d->tiff ) : TIFFSetDirectory( d->tiff, i );
+        d->readingDirectories = ok;
+        if ( !ok )
+        {
+            d->allDirectoriesRead = true;
+            break;
+        }
 
-        Okular::Page * page = new Okular::Page( realdirs, width, height, readTiffRotation( d->tiff ) );
-        pagesVector[ realdirs ] = page;
+        uint32 subFileType = 0;
+        TIFFGetFieldDefaulted( d->tiff, TIFFTAG_SUBFILETYPE, &subFileType );
 
-        m_pageMapping[ realdirs ] = i;
+        if ( TIFFGetField( d->tiff, TIFFTAG_IMAGEWIDTH, &width ) == 1 &&
+             TIFFGetField( d->tiff, TIFFTAG_IMAGELENGTH, &height ) == 1 )
+        {
+            if ( ( subFileType & FILETYPE_REDUCEDIMAGE ) && !pagesVector.isEmpty() )
+            {
+                // not a page, but a smaller version of the previous one
+                const Private::ResolutionLevel level = { i, 0, width, height };
+                d->levels[ pagesVector.count() - 1 ].append( level );
+            }
+            else
+            {
+                adaptSizeToResolution( d->tiff, TIFFTAG_XRESOLUTION, dpiX, &width );
+                adaptSizeToResolution( d->tiff, TIFFTAG_YRESOLUTION, dpiY, &height );
+
+                const int realdirs = pagesVector.count();
+                Okular::Page * page = new Okular::Page( realdirs, width, height, readTiffRotation( d->tiff ) );
+                pagesVector.append( page );
+
+                m_pageMapping[ realdirs ] = i;
+
+                // smaller versions of the page may be in SubIFDs too
+                uint16 subDirectoryCount = 0;
+                toff_t *subDirectories = 0;
+                if ( TIFFGetField( d->tiff, TIFFTAG_SUBIFD, &subDirectoryCount, &subDirectories ) )
+                {
+                    for ( uint16 j = 0; j < subDirectoryCount; ++j )
+                    {
+                        const Private::ResolutionLevel level = { i, subDirectories[j], 0, 0 };
+                        d->levels[ realdirs ].append( level );
+                    }
+                }
+            }
+        }
 
-        ++realdirs;
+        if ( TIFFLastDirectory( d->tiff ) )
+        {
+            d->allDirectoriesRead = true;
+            break;
+        }
     }
 
-    pagesVector.resize( realdirs );
+    return !d->allDirectoriesRead;
 }
 
 bool TIFFGenerator::print( QPrinter& printer )
@@ -385,6 +551,9 @@ bool TIFFGenerator::print( QPrinter& printer )
 
     QPainter p( &printer );
 
+    QMutexLocker locker( userMutex() );
+    d->readingDirectories = false;
+
     QList<int> pageList = Okular::FilePrinter::pageList( printer, document()->pages(),
                                                          document()->currentPage() + 1,
                                                          document()->bookmarkedPageList() );
@@ -398,20 +567,11 @@ bool TIFFGenerator::print( QPrinter& printer )
              TIFFGetField( d->tiff, TIFFTAG_IMAGELENGTH, &height ) != 1 )
             continue;
 
-        QImage image( width, height, QImage::Format_RGB32 );
-        uint32 * data = (uint32 *)image.bits();
-
-        // read data
-        if ( TIFFReadRGBAImageOriented( d->tiff, width, height, data, ORIENTATION_TOPLEFT ) != 0 )
+        QImage image;
+        if ( !readTiffImage( d->tiff, QRect( 0, 0, width, height ), ORIENTATION_TOPLEFT, &image ) )
         {
-            // an image read by ReadRGBAImage is ABGR, we need ARGB, so swap red and blue
-            uint32 size = width * height;
-            for ( uint32 i = 0; i < size; ++i )
-            {
-                uint32 red = ( data[i] & 0x00FF0000 ) >> 16;
-                uint32 blue = ( data[i] & 0x000000FF ) << 16;
-                data[i] = ( data[i] & 0xFF00FF00 ) + red + blue;
-            }
+            image = QImage( width, height, QImage::Format_RGB32 );
+            image.fill( qRgb( 255, 255, 255 ) );
         }
 
         if ( i != 0 )
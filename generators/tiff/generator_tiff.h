@@ -23,6 +23,7 @@ class TIFFGenerator : public Okular::Generator
 
         bool loadDocument( const QString & fileName, QVector<Okular::Page*> & pagesVector );
         bool loadDocumentFromData( const QByteArray & fileData, QVector< Okular::Page * > & pagesVector );
+        bool loadMorePages( QVector<Okular::Page*> & pagesVector );
 
         const Okular::DocumentInfo * generateDocumentInfo();
 
@@ -37,7 +38,7 @@ class TIFFGenerator : public Okular::Generator
         Private * const d;
 
         bool loadTiff( QVector< Okular::Page * > & pagesVector, const char *name );
-        void loadPages( QVector<Okular::Page*> & pagesVector );
+        bool loadPages( QVector<Okular::Page*> & pagesVector, int maxPages );
         int mapPage( int page ) const;
 
         Okular::DocumentInfo * m_docInfo;
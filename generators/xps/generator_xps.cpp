@@ -31,6 +31,7 @@
 #include <QBuffer>
 #include <QImageReader>
 #include <QMutex>
+#include <QScopedPointer>
 
 #include <core/document.h>
 #include <core/page.h>
@@ -744,9 +745,176 @@ static QString unicodeString( const QString &raw )
 }
 
 
+// the bytes of a page read at a time while looking for its size
+static const int PageHeaderChunkSize = 4096;
+
+// the display lists kept for the pages rendered last, in bytes
+static const int DisplayListCacheMaxCost = 32 * 1024 * 1024;
+// the replay checks whether the request is obsolete every this many commands
+static const int DisplayListAbortCheckInterval = 64;
+
+XpsDisplayList::XpsDisplayList()
+    : m_opacity( 1.0 ), m_cost( 0 )
+{
+}
+
+void XpsDisplayList::append( CommandType type, int index, int cost )
+{
+    Command command;
+    command.type = type;
+    command.index = index;
+    m_commands.append( command );
+    m_cost += sizeof( Command ) + cost;
+}
+
+void XpsDisplayList::save()
+{
+    m_savedOpacities.push( m_opacity );
+    append( Save, -1, 0 );
+}
+
+void XpsDisplayList::restore()
+{
+    if ( !m_savedOpacities.isEmpty() )
+        m_opacity = m_savedOpacities.pop();
+    append( Restore, -1, 0 );
+}
+
+void XpsDisplayList::transform( const QTransform &matrix )
+{
+    m_transforms.append( matrix );
+    append( Transform, m_transforms.count() - 1, sizeof( QTransform ) );
+}
+
+void XpsDisplayList::setOpacity( qreal opacity )
+{
+    m_opacity = opacity;
+    m_numbers.append( opacity );
+    append( Opacity, m_numbers.count() - 1, sizeof( qreal ) );
+}
+
+qreal XpsDisplayList::opacity() const
+{
+    return m_opacity;
+}
+
+void XpsDisplayList::setFont( const QFont &font )
+{
+    // the glyphs of a run mostly share their font
+    if ( m_fonts.isEmpty() || m_fonts.last() != font )
+        m_fonts.append( font );
+    append( Font, m_fonts.count() - 1, sizeof( QFont ) );
+}
+
+void XpsDisplayList::setBrush( const QBrush &brush )
+{
+    m_brushes.append( brush );
+    // an image brush holds the decoded image
+    append( Brush, m_brushes.count() - 1, sizeof( QBrush ) + brush.textureImage().byteCount() );
+}
+
+void XpsDisplayList::setPen( const QPen &pen )
+{
+    m_pens.append( pen );
+    append( Pen, m_pens.count() - 1, sizeof( QPen ) + pen.brush().textureImage().byteCount() );
+}
+
+void XpsDisplayList::setClipPath( const QPainterPath &path )
+{
+    m_paths.append( path );
+    append( ClipPath, m_paths.count() - 1, path.elementCount() * sizeof( QPainterPath::Element ) );
+}
+
+void XpsDisplayList::setLayoutDirection( Qt::LayoutDirection direction )
+{
+    m_numbers.append( direction );
+    append( LayoutDirection, m_numbers.count() - 1, sizeof( qreal ) );
+}
+
+void XpsDisplayList::drawPath( const QPainterPath &path )
+{
+    m_paths.append( path );
+    append( DrawPath, m_paths.count() - 1, path.elementCount() * sizeof( QPainterPath::Element ) );
+}
+
+void XpsDisplayList::drawGlyphs( const QString &text, const QVector<QPointF> &positions )
+{
+    GlyphRun run;
+    run.text = text;
+    run.positions = positions;
+    m_glyphRuns.append( run );
+    append( DrawGlyphs, m_glyphRuns.count() - 1, text.size() * ( sizeof( QChar ) + sizeof( QPointF ) ) );
+}
+
+bool XpsDisplayList::replay( QPainter *painter, const Okular::PixmapRequest *request ) const
+{
+    int saved = 0;
+    for ( int i = 0; i < m_commands.count(); ++i ) {
+        // stop the drawing, the page will not be shown
+        if ( request && i % DisplayListAbortCheckInterval == 0 && request->shouldAbortRender() ) {
+            for ( ; saved > 0; --saved )
+                painter->restore();
+            return false;
+        }
+
+        const Command &command = m_commands.at( i );
+        switch ( command.type ) {
+            case Save:
+                painter->save();
+                ++saved;
+                break;
+            case Restore:
+                painter->restore();
+                --saved;
+                break;
+            case Transform:
+                painter->setWorldTransform( m_transforms.at( command.index ), true );
+                break;
+            case Opacity:
+                painter->setOpacity( m_numbers.at( command.index ) );
+                break;
+            case Font:
+                painter->setFont( m_fonts.at( command.index ) );
+                break;
+            case Brush:
+                painter->setBrush( m_brushes.at( command.index ) );
+                break;
+            case Pen:
+                painter->setPen( m_pens.at( command.index ) );
+                break;
+            case ClipPath:
+                painter->setClipPath( m_paths.at( command.index ) );
+                break;
+            case LayoutDirection:
+                painter->setLayoutDirection( (Qt::LayoutDirection)(int)m_numbers.at( command.index ) );
+                break;
+            case DrawPath:
+                painter->drawPath( m_paths.at( command.index ) );
+                break;
+            case DrawGlyphs: {
+                const GlyphRun &run = m_glyphRuns.at( command.index );
+                for ( int j = 0; j < run.text.size(); ++j )
+                    painter->drawText( run.positions.at( j ), QString( run.text.at( j ) ) );
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+int XpsDisplayList::cost() const
+{
+    return m_cost;
+}
+
 XpsHandler::XpsHandler(XpsPage *page): m_page(page)
 {
-    m_painter = NULL;
+    m_displayList = NULL;
+    m_request = NULL;
+
+    m_fontDevice = QImage( 1, 1, QImage::Format_RGB32 );
+    m_fontDevice.setDotsPerMeterX( 2835 );
+    m_fontDevice.setDotsPerMeterY( 2835 );
 }
 
 XpsHandler::~XpsHandler()
@@ -772,6 +940,10 @@ bool XpsHandler::startElement( const QString &nameSpace,
     Q_UNUSED( nameSpace )
     Q_UNUSED( qname )
 
+    // stop the parsing, the page will not be shown
+    if ( m_request && m_request->shouldAbortRender() )
+        return false;
+
     XpsRenderNode node;
     node.name = localName;
     node.attributes = atts;
@@ -810,7 +982,7 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
 
     QString att;
 
-    m_painter->save();
+    m_displayList->save();
 
     // Get font (doesn't work well because qt doesn't allow to load font from file)
     // This works despite the fact that font size isn't specified in points as required by qt. It's because I set point size to be equal to drawing unit.
@@ -818,7 +990,7 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
     // kDebug(XpsDebug) << "Font Rendering EmSize:" << fontSize;
     // a value of 0.0 means the text is not visible (see XPS specs, chapter 12, "Glyphs")
     if ( fontSize < 0.1 ) {
-        m_painter->restore();
+        m_displayList->restore();
         return;
     }
     QFont font = m_page->m_file->getFontByName( node.attributes.value("FontUri"), fontSize );
@@ -833,7 +1005,7 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
             font.setBold( true );
         }
     }
-    m_painter->setFont(font);
+    m_displayList->setFont(font);
 
     //Origin
     QPointF origin( node.attributes.value("OriginX").toDouble(), node.attributes.value("OriginY").toDouble() );
@@ -848,19 +1020,19 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
         } else {
             // no "Fill" attribute and no "Glyphs.Fill" child, so show nothing
             // (see XPS specs, 5.10)
-            m_painter->restore();
+            m_displayList->restore();
             return;
         }
     } else {
         brush = parseRscRefColorForBrush( att );
         if ( brush.style() > Qt::NoBrush && brush.style() < Qt::LinearGradientPattern
              && brush.color().alpha() == 0 ) {
-            m_painter->restore();
+            m_displayList->restore();
             return;
         }
     }
-    m_painter->setBrush( brush );
-    m_painter->setPen( QPen( brush, 0 ) );
+    m_displayList->setBrush( brush );
+    m_displayList->setPen( QPen( brush, 0 ) );
 
     // Opacity
     att = node.attributes.value("Opacity");
@@ -868,9 +1040,9 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
         bool ok = true;
         double value = att.toDouble( &ok );
         if ( ok && value >= 0.1 ) {
-            m_painter->setOpacity( value );
+            m_displayList->setOpacity( value );
         } else {
-            m_painter->restore();
+            m_displayList->restore();
             return;
         }
     }
@@ -878,7 +1050,7 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
     //RenderTransform
     att = node.attributes.value("RenderTransform");
     if (!att.isEmpty()) {
-        m_painter->setWorldTransform( parseRscRefMatrix( att ), true);
+        m_displayList->transform( parseRscRefMatrix( att ) );
     }
 
     // Clip
@@ -886,17 +1058,17 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
     if ( !att.isEmpty() ) {
         QPainterPath clipPath = parseRscRefPath( att );
         if ( !clipPath.isEmpty() ) {
-            m_painter->setClipPath( clipPath );
+            m_displayList->setClipPath( clipPath );
         }
     }
 
     // BiDiLevel - default Left-to-Right
-    m_painter->setLayoutDirection( Qt::LeftToRight );
+    m_displayList->setLayoutDirection( Qt::LeftToRight );
     att = node.attributes.value( "BiDiLevel" );
     if ( !att.isEmpty() ) {
         if ( (att.toInt() % 2) == 1 ) {
             // odd BiDiLevel, so Right-to-Left
-            m_painter->setLayoutDirection( Qt::RightToLeft );
+            m_displayList->setLayoutDirection( Qt::RightToLeft );
         }
     }
 
@@ -931,10 +1103,11 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
     // UnicodeString
     QString stringToDraw( unicodeString( node.attributes.value( "UnicodeString" ) ) );
     QPointF originAdvance(0, 0);
-    QFontMetrics metrics = m_painter->fontMetrics();
+    QFontMetrics metrics( font, &m_fontDevice );
+    QVector<QPointF> positions( stringToDraw.size() );
     for ( int i = 0; i < stringToDraw.size(); ++i ) {
         QChar thisChar = stringToDraw.at( i );
-        m_painter->drawText( origin + originAdvance, QString( thisChar ) );
+        positions[i] = origin + originAdvance;
 	const qreal advanceWidth = advanceWidths.value( i, qreal(-1.0) );
         if ( advanceWidth > 0.0 ) {
             originAdvance.rx() += advanceWidth;
@@ -942,11 +1115,12 @@ void XpsHandler::processGlyph( XpsRenderNode &node )
             originAdvance.rx() += metrics.width( thisChar );
         }
     }
+    m_displayList->drawGlyphs( stringToDraw, positions );
     // kDebug(XpsDebug) << "Glyphs: " << atts.value("Fill") << ", " << atts.value("FontUri");
     // kDebug(XpsDebug) << "    Origin: " << atts.value("OriginX") << "," << atts.value("OriginY");
     // kDebug(XpsDebug) << "    Unicode: " << atts.value("UnicodeString");
 
-    m_painter->restore();
+    m_displayList->restore();
 }
 
 void XpsHandler::processFill( XpsRenderNode &node )
@@ -1014,7 +1188,7 @@ void XpsHandler::processPath( XpsRenderNode &node )
     //TODO Ignored attributes: Clip, OpacityMask, StrokeEndLineCap, StorkeStartLineCap, Name, FixedPage.NavigateURI, xml:lang, x:key, AutomationProperties.Name, AutomationProperties.HelpText, SnapsToDevicePixels
     //TODO Ignored child elements: RenderTransform, Clip, OpacityMask
     // Handled separately: RenderTransform
-    m_painter->save();
+    m_displayList->save();
 
     QString att;
     QVariant data;
@@ -1030,7 +1204,7 @@ void XpsHandler::processPath( XpsRenderNode &node )
     }
     if ( !pathdata ) {
         // nothing to draw
-        m_painter->restore();
+        m_displayList->restore();
         return;
     }
 
@@ -1045,7 +1219,7 @@ void XpsHandler::processPath( XpsRenderNode &node )
             brush = data.value<QBrush>();
         }
     }
-    m_painter->setBrush( brush );
+    m_displayList->setBrush( brush );
 
     // Stroke (pen)
     att = node.attributes.value( "Stroke" );
@@ -1124,31 +1298,31 @@ void XpsHandler::processPath( XpsRenderNode &node )
             pen.setMiterLimit( limit / 2 );
         }
     }
-    m_painter->setPen( pen );
+    m_displayList->setPen( pen );
 
     // Opacity
     att = node.attributes.value("Opacity");
     if (! att.isEmpty()) {
-        m_painter->setOpacity(att.toDouble());
+        m_displayList->setOpacity(att.toDouble());
     }
 
     // RenderTransform
     att = node.attributes.value( "RenderTransform" );
     if (! att.isEmpty() ) {
-        m_painter->setWorldTransform( parseRscRefMatrix( att ), true );
+        m_displayList->transform( parseRscRefMatrix( att ) );
     }
     if ( !pathdata->transform.isIdentity() ) {
-        m_painter->setWorldTransform( pathdata->transform, true );
+        m_displayList->transform( pathdata->transform );
     }
 
     Q_FOREACH ( XpsPathFigure *figure, pathdata->paths ) {
-        m_painter->setBrush( figure->isFilled ? brush : QBrush() );
-        m_painter->drawPath( figure->path );
+        m_displayList->setBrush( figure->isFilled ? brush : QBrush() );
+        m_displayList->drawPath( figure->path );
     }
 
     delete pathdata;
 
-    m_painter->restore();
+    m_displayList->restore();
 }
 
 void XpsHandler::processPathData( XpsRenderNode &node )
@@ -1289,20 +1463,20 @@ void XpsHandler::processPathFigure( XpsRenderNode &node )
 void XpsHandler::processStartElement( XpsRenderNode &node )
 {
     if (node.name == "Canvas") {
-        m_painter->save();
+        m_displayList->save();
         QString att = node.attributes.value( "RenderTransform" );
         if ( !att.isEmpty() ) {
-            m_painter->setWorldTransform( parseRscRefMatrix( att ), true );
+            m_displayList->transform( parseRscRefMatrix( att ) );
         }
         att = node.attributes.value( "Opacity" );
         if ( !att.isEmpty() ) {
             double value = att.toDouble();
             if ( value > 0.0 && value <= 1.0 ) {
-                m_painter->setOpacity( m_painter->opacity() * value );
+                m_displayList->setOpacity( m_displayList->opacity() * value );
             } else {
                 // setting manually to 0 is necessary to "disable"
                 // all the stuff inside
-                m_painter->setOpacity( 0.0 );
+                m_displayList->setOpacity( 0.0 );
             }
         }
     }
@@ -1320,10 +1494,10 @@ void XpsHandler::processEndElement( XpsRenderNode &node )
     } else if ((node.name == "Canvas.RenderTransform") || (node.name == "Glyphs.RenderTransform") || (node.name == "Path.RenderTransform"))  {
         QVariant data = node.getRequiredChildData( "MatrixTransform" );
         if (data.canConvert<QTransform>()) {
-            m_painter->setWorldTransform( data.value<QTransform>(), true );
+            m_displayList->transform( data.value<QTransform>() );
         }
     } else if (node.name == "Canvas") {
-        m_painter->restore();
+        m_displayList->restore();
     } else if ((node.name == "Path.Fill") || (node.name == "Glyphs.Fill")) {
         processFill( node );
     } else if (node.name == "Path.Stroke") {
@@ -1401,67 +1575,54 @@ void XpsHandler::processEndElement( XpsRenderNode &node )
 }
 
 XpsPage::XpsPage(XpsFile *file, const QString &fileName): m_file( file ),
-    m_fileName( fileName ), m_pageIsRendered(false)
+    m_fileName( fileName ), m_pageSizeKnown( false )
 {
-    m_pageImage = NULL;
-
     // kDebug(XpsDebug) << "page file name: " << fileName;
-
-    const KZipFileEntry* pageFile = static_cast<const KZipFileEntry *>(m_file->xpsArchive()->directory()->entry( fileName ));
-
-    QXmlStreamReader xml;
-    xml.addData( readFileOrDirectoryParts( pageFile ) );
-    while ( !xml.atEnd() )
-    {
-        xml.readNext();
-        if ( xml.isStartElement() && ( xml.name() == "FixedPage" ) )
-        {
-            QXmlStreamAttributes attributes = xml.attributes();
-            m_pageSize.setWidth( attributes.value( "Width" ).toString().toDouble() );
-            m_pageSize.setHeight( attributes.value( "Height" ).toString().toDouble() );
-            break;
-        }
-    }
-    if ( xml.error() )
-    {
-        kDebug(XpsDebug) << "Could not parse XPS page:" << xml.errorString();
-    }
 }
 
 XpsPage::~XpsPage()
 {
-    delete m_pageImage;
 }
 
-bool XpsPage::renderToImage( QImage *p )
+bool XpsPage::renderToImage( QImage *p, const Okular::PixmapRequest *request )
 {
+    // Set one point = one drawing unit. Useful for fonts, because xps specifies font size using drawing units, not points as usual
+    p->setDotsPerMeterX( 2835 );
+    p->setDotsPerMeterY( 2835 );
+    p->fill( qRgba( 255, 255, 255, 255 ) );
 
-    if ((m_pageImage == NULL) || (m_pageImage->size() != p->size())) {
-        delete m_pageImage;
-        m_pageImage = new QImage( p->size(), QImage::Format_ARGB32 );
-        // Set one point = one drawing unit. Useful for fonts, because xps specifies font size using drawing units, not points as usual
-        m_pageImage->setDotsPerMeterX( 2835 );
-        m_pageImage->setDotsPerMeterY( 2835 );
+    QPainter painter( p );
+    return renderToPainter( &painter, request );
+}
 
-        m_pageIsRendered = false;
-    }
-    if (! m_pageIsRendered) {
-        m_pageImage->fill( qRgba( 255, 255, 255, 255 ) );
-        QPainter painter( m_pageImage );
-        renderToPainter( &painter );
-        m_pageIsRendered = true;
+bool XpsPage::renderToPainter( QPainter *painter, const Okular::PixmapRequest *request )
+{
+    QCache< const XpsPage*, XpsDisplayList > &displayLists = m_file->displayLists();
+    XpsDisplayList *displayList = displayLists.object( this );
+    QScopedPointer< XpsDisplayList > parsedList;
+    if ( !displayList ) {
+        parsedList.reset( new XpsDisplayList );
+        // a page stopped midway is not complete
+        if ( !parseDisplayList( parsedList.data(), request ) )
+            return false;
+        displayList = parsedList.data();
     }
 
-    *p = *m_pageImage;
+    painter->setWorldTransform(QTransform().scale((qreal)painter->device()->width() / size().width(), (qreal)painter->device()->height() / size().height()));
+    const bool rendered = displayList->replay( painter, request );
 
-    return true;
+    if ( parsedList && parsedList->cost() <= displayLists.maxCost() ) {
+        const int cost = parsedList->cost();
+        displayLists.insert( this, parsedList.take(), cost );
+    }
+    return rendered;
 }
 
-bool XpsPage::renderToPainter( QPainter *painter )
+bool XpsPage::parseDisplayList( XpsDisplayList *displayList, const Okular::PixmapRequest *request )
 {
     XpsHandler handler( this );
-    handler.m_painter = painter;
-    handler.m_painter->setWorldTransform(QTransform().scale((qreal)painter->device()->width() / size().width(), (qreal)painter->device()->height() / size().height()));
+    handler.m_displayList = displayList;
+    handler.m_request = request;
     QXmlSimpleReader parser;
     parser.setContentHandler( &handler );
     parser.setErrorHandler( &handler );
@@ -1472,14 +1633,62 @@ bool XpsPage::renderToPainter( QPainter *painter )
     bool ok = parser.parse( source );
     kDebug(XpsDebug) << "Parse result: " << ok;
 
-    return true;
+    return !request || !request->shouldAbortRender();
 }
 
 QSizeF XpsPage::size() const
 {
+    if ( !m_pageSizeKnown ) {
+        m_pageSize = readPageSize();
+        m_pageSizeKnown = true;
+    }
     return m_pageSize;
 }
 
+QSizeF XpsPage::readPageSize() const
+{
+    const KArchiveEntry* pageEntry = m_file->xpsArchive()->directory()->entry( m_fileName );
+    if ( !pageEntry ) {
+        kDebug(XpsDebug) << "Could not find XPS page:" << m_fileName;
+        return QSizeF();
+    }
+
+    // the size is in the first element, so only the beginning of a page
+    // file is decompressed; the pieces of an interleaved page are joined
+    QScopedPointer< QIODevice > device;
+    QXmlStreamReader xml;
+    if ( pageEntry->isFile() ) {
+        device.reset( static_cast<const KArchiveFile *>( pageEntry )->createDevice() );
+    }
+    if ( !device ) {
+        xml.addData( readFileOrDirectoryParts( pageEntry ) );
+    }
+
+    QSizeF pageSize;
+    while ( true )
+    {
+        if ( xml.atEnd() ) {
+            if ( !device || device->atEnd() || ( xml.hasError() && xml.error() != QXmlStreamReader::PrematureEndOfDocumentError ) ) {
+                break;
+            }
+            xml.addData( device->read( PageHeaderChunkSize ) );
+        }
+        xml.readNext();
+        if ( xml.isStartElement() && ( xml.name() == "FixedPage" ) )
+        {
+            QXmlStreamAttributes attributes = xml.attributes();
+            pageSize.setWidth( attributes.value( "Width" ).toString().toDouble() );
+            pageSize.setHeight( attributes.value( "Height" ).toString().toDouble() );
+            return pageSize;
+        }
+    }
+    if ( xml.hasError() )
+    {
+        kDebug(XpsDebug) << "Could not parse XPS page:" << xml.errorString();
+    }
+    return pageSize;
+}
+
 QFont XpsFile::getFontByName( const QString &fileName, float size )
 {
     // kDebug(XpsDebug) << "trying to get font: " << fileName << ", size: " << size;
@@ -1560,6 +1769,11 @@ KZip * XpsFile::xpsArchive() {
     return m_xpsArchive;
 }
 
+QCache< const XpsPage*, XpsDisplayList > &XpsFile::displayLists()
+{
+    return m_displayLists;
+}
+
 QImage XpsPage::loadImageFromFile( const QString &fileName )
 {
     // kDebug(XpsDebug) << "image file name: " << fileName;
@@ -1612,6 +1826,7 @@ Okular::TextPage* XpsPage::textPage()
     // kDebug(XpsDebug) << "Parsing XpsPage, text extraction";
 
     Okular::TextPage* textPage = new Okular::TextPage();
+    const QSizeF pageSize = size();
 
     const KZipFileEntry* pageFile = static_cast<const KZipFileEntry *>(m_file->xpsArchive()->directory()->entry( m_fileName ));
     QXmlStreamReader xml;
@@ -1680,10 +1895,10 @@ Okular::TextPage* XpsPage::textPage()
                 for (int i = 0; i < text.length(); i++) {
                     int width = metrics.width( text, i + 1 );
 
-                    Okular::NormalizedRect * rect = new Okular::NormalizedRect( (origin.x() + lastWidth) / m_pageSize.width(),
-                                                                                (origin.y() - metrics.height()) / m_pageSize.height(),
-                                                                                (origin.x() + width) / m_pageSize.width(),
-                                                                                origin.y() / m_pageSize.height() );
+                    Okular::NormalizedRect * rect = new Okular::NormalizedRect( (origin.x() + lastWidth) / pageSize.width(),
+                                                                                (origin.y() - metrics.height()) / pageSize.height(),
+                                                                                (origin.x() + width) / pageSize.width(),
+                                                                                origin.y() / pageSize.height() );
                     rect->transform( matrix );
                     textPage->append( text.mid(i, 1), rect );
 
@@ -1892,7 +2107,7 @@ XpsPage* XpsDocument::page(int pageNum) const
     return m_pages.at(pageNum);
 }
 
-XpsFile::XpsFile() : m_docInfo( 0 )
+XpsFile::XpsFile() : m_docInfo( 0 ), m_displayLists( DisplayListCacheMaxCost )
 {
 }
 
@@ -2055,6 +2270,8 @@ const Okular::DocumentInfo * XpsFile::generateDocumentInfo()
 
 bool XpsFile::closeDocument()
 {
+    // before the pages they belong to
+    m_displayLists.clear();
 
     if ( m_docInfo )
         delete m_docInfo;
@@ -2093,8 +2310,10 @@ XpsGenerator::XpsGenerator( QObject *parent, const QVariantList &args )
   : Okular::Generator( parent, args ), m_xpsFile( 0 )
 {
     setFeature( TextExtraction );
+    setFeature( ParallelTextExtraction );
     setFeature( PrintNative );
     setFeature( PrintToFile );
+    setFeature( IncrementalLoading );
     // activate the threaded rendering iif:
     // 1) QFontDatabase says so
     // 2) Qt >= 4.4.0 (see Trolltech task ID: 169502)
@@ -2115,22 +2334,32 @@ bool XpsGenerator::loadDocument( const QString & fileName, QVector<Okular::Page*
     m_xpsFile = new XpsFile();
 
     m_xpsFile->loadDocument( fileName );
-    pagesVector.resize( m_xpsFile->numPages() );
 
-    int pagesVectorOffset = 0;
+    // only read the size of the first pages, loadMorePages() reads the others
+    appendPages( pagesVector, 20 );
+    return true;
+}
+
+bool XpsGenerator::loadMorePages( QVector<Okular::Page*> & pagesVector )
+{
+    // don't wait for the page being rendered, the document will ask again
+    if ( !userMutex()->tryLock() )
+        return true;
+
+    const bool morePages = appendPages( pagesVector, 10 );
+    userMutex()->unlock();
+    return morePages;
+}
 
-    for (int docNum = 0; docNum < m_xpsFile->numDocuments(); ++docNum )
+bool XpsGenerator::appendPages( QVector<Okular::Page*> & pagesVector, int maxPages )
+{
+    const int lastPage = qMin( m_xpsFile->numPages(), pagesVector.count() + maxPages );
+    for ( int i = pagesVector.count(); i < lastPage; ++i )
     {
-        XpsDocument *doc = m_xpsFile->document( docNum );
-        for (int pageNum = 0; pageNum < doc->numPages(); ++pageNum )
-        {
-            QSizeF pageSize = doc->page( pageNum )->size();
-            pagesVector[pagesVectorOffset] = new Okular::Page( pagesVectorOffset, pageSize.width(), pageSize.height(), Okular::Rotation0 );
-            ++pagesVectorOffset;
-        }
+        const QSizeF pageSize = m_xpsFile->page( i )->size();
+        pagesVector.append( new Okular::Page( i, pageSize.width(), pageSize.height(), Okular::Rotation0 ) );
     }
-
-    return true;
+    return pagesVector.count() < m_xpsFile->numPages();
 }
 
 bool XpsGenerator::doCloseDocument()
@@ -2148,7 +2377,7 @@ QImage XpsGenerator::image( Okular::PixmapRequest * request )
     QSize size( (int)request->width(), (int)request->height() );
     QImage image( size, QImage::Format_RGB32 );
     XpsPage *pageToRender = m_xpsFile->page( request->page()->number() );
-    pageToRender->renderToImage( &image );
+    pageToRender->renderToImage( &image, request );
     return image;
 }
 
@@ -2216,6 +2445,7 @@ bool XpsGenerator::exportTo( const QString &fileName, const Okular::ExportFormat
 
 bool XpsGenerator::print( QPrinter &printer )
 {
+    QMutexLocker lock( userMutex() );
     QList<int> pageList = Okular::FilePrinter::pageList( printer, document()->pages(),
                                                          document()->currentPage() + 1,
                                                          document()->bookmarkedPageList() );
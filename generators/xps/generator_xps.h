@@ -23,10 +23,13 @@
 #include <core/generator.h>
 #include <core/textpage.h>
 
+#include <QCache>
 #include <QColor>
 #include <QDomDocument>
 #include <QFontDatabase>
 #include <QImage>
+#include <QPainterPath>
+#include <QPen>
 #include <QXmlStreamReader>
 #include <QXmlDefaultHandler>
 #include <QStack>
@@ -103,6 +106,75 @@ struct XpsPathGeometry
     XpsMatrixTransform transform;
 };
 
+/**
+    The drawing of a page, recorded once while parsing its XML and replayed
+    at any scale. The resources (fonts, images, brushes) are resolved.
+
+    The calls mirror the ones of QPainter they are replayed with.
+*/
+class XpsDisplayList
+{
+public:
+    XpsDisplayList();
+
+    void save();
+    void restore();
+    void transform( const QTransform &matrix );
+    void setOpacity( qreal opacity );
+    qreal opacity() const;
+    void setFont( const QFont &font );
+    void setBrush( const QBrush &brush );
+    void setPen( const QPen &pen );
+    void setClipPath( const QPainterPath &path );
+    void setLayoutDirection( Qt::LayoutDirection direction );
+    void drawPath( const QPainterPath &path );
+    // each character of @p text is drawn at its own position
+    void drawGlyphs( const QString &text, const QVector<QPointF> &positions );
+
+    /**
+       Replays the drawing on @p painter, returns false if it was stopped
+       because @p request is obsolete
+    */
+    bool replay( QPainter *painter, const Okular::PixmapRequest *request = 0 ) const;
+
+    /**
+       An estimate of the memory used, in bytes
+    */
+    int cost() const;
+
+private:
+    enum CommandType { Save, Restore, Transform, Opacity, Font, Brush, Pen, ClipPath, LayoutDirection, DrawPath, DrawGlyphs };
+
+    struct Command
+    {
+        CommandType type;
+        // the position of the argument in the vector of its type
+        int index;
+    };
+
+    struct GlyphRun
+    {
+        QString text;
+        QVector<QPointF> positions;
+    };
+
+    void append( CommandType type, int index, int cost );
+
+    QVector<Command> m_commands;
+    QVector<QTransform> m_transforms;
+    QVector<qreal> m_numbers;
+    QVector<QFont> m_fonts;
+    QVector<QBrush> m_brushes;
+    QVector<QPen> m_pens;
+    QVector<QPainterPath> m_paths;
+    QVector<GlyphRun> m_glyphRuns;
+
+    // the opacity while recording, the handler combines it with its own
+    qreal m_opacity;
+    QStack<qreal> m_savedOpacities;
+    int m_cost;
+};
+
 class XpsPage;
 class XpsFile;
 
@@ -137,9 +209,12 @@ protected:
     void processPathGeometry( XpsRenderNode &node );
     void processPathFigure( XpsRenderNode &node );
 
-    QPainter *m_painter;
+    XpsDisplayList *m_displayList;
+    // the request being rendered, to stop when it is obsolete
+    const Okular::PixmapRequest *m_request;
 
-    QImage m_image;
+    // a device of 72 dpi, to measure the fonts like the rendering does
+    QImage m_fontDevice;
 
     QStack<XpsRenderNode> m_nodes;
 
@@ -153,27 +228,28 @@ public:
     ~XpsPage();
 
     QSizeF size() const;
-    bool renderToImage( QImage *p );
-    bool renderToPainter( QPainter *painter );
+    bool renderToImage( QImage *p, const Okular::PixmapRequest *request = 0 );
+    bool renderToPainter( QPainter *painter, const Okular::PixmapRequest *request = 0 );
     Okular::TextPage* textPage();
 
     QImage loadImageFromFile( const QString &filename );
 
 private:
+    bool parseDisplayList( XpsDisplayList *displayList, const Okular::PixmapRequest *request );
+    QSizeF readPageSize() const;
+
     XpsFile *m_file;
     const QString m_fileName;
 
-    QSizeF m_pageSize;
-
+    // read on first use, opening a document does not read all of its pages
+    mutable QSizeF m_pageSize;
+    mutable bool m_pageSizeKnown;
 
     QString m_thumbnailFileName;
     bool m_thumbnailMightBeAvailable;
     QImage m_thumbnail;
     bool m_thumbnailIsLoaded;
 
-    QImage *m_pageImage;
-    bool m_pageIsRendered;
-
     friend class XpsHandler;
     friend class XpsTextExtractionHandler;
 };
@@ -274,6 +350,10 @@ public:
 
     KZip* xpsArchive();
 
+    /**
+       the display lists of the pages recently rendered
+    */
+    QCache< const XpsPage*, XpsDisplayList > &displayLists();
 
 private:
     int loadFontByName( const QString &fontName );
@@ -295,6 +375,8 @@ private:
 
     QMap<QString, int> m_fontCache;
     QFontDatabase m_fontDatabase;
+
+    QCache< const XpsPage*, XpsDisplayList > m_displayLists;
 };
 
 
@@ -306,6 +388,7 @@ class XpsGenerator : public Okular::Generator
         virtual ~XpsGenerator();
 
         bool loadDocument( const QString & fileName, QVector<Okular::Page*> & pagesVector );
+        bool loadMorePages( QVector<Okular::Page*> & pagesVector );
 
         const Okular::DocumentInfo * generateDocumentInfo();
         const Okular::DocumentSynopsis * generateDocumentSynopsis();
@@ -321,6 +404,9 @@ class XpsGenerator : public Okular::Generator
         Okular::TextPage* textPage( Okular::Page * page );
 
     private:
+        // appends the next maxPages pages to pagesVector, returns whether there are more
+        bool appendPages( QVector<Okular::Page*> & pagesVector, int maxPages );
+
         XpsFile *m_xpsFile;
 };
 
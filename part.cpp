@@ -1063,6 +1063,10 @@ KConfigDialog * Part::slotGeneratorPreferences( )
 
 void Part::notifySetup( const QVector< Okular::Page * > & /*pages*/, int setupFlags )
 {
+    // the next/last page actions depend on the number of pages
+    if ( setupFlags & Okular::DocumentObserver::PagesAppended )
+        updateViewActions();
+
     if ( !( setupFlags & Okular::DocumentObserver::DocumentChanged ) )
         return;
 
@@ -1082,6 +1086,14 @@ void Part::notifyPageChanged( int page, int flags )
     if ( flags & Okular::DocumentObserver::NeedSaveAs )
         setModified();
 
+    // the forms of the pages loaded after the document was opened
+    if ( ( flags & Okular::DocumentObserver::Metadata ) && m_formsMessage->isHidden() &&
+         m_pageView->toggleFormsAction() && !m_document->page( page )->formFields().isEmpty() )
+    {
+        m_formsMessage->setup( i18n( "This document has forms. Click on the button to interact with them, or use View -> Show Forms." ) );
+        m_formsMessage->setVisible( true );
+    }
+
     if ( !(flags & Okular::DocumentObserver::Bookmark ) )
         return;
 
@@ -1348,6 +1360,9 @@ bool Part::openUrl(const KUrl &_url)
     if ( !closeUrl() )
         return false;
 
+    // a new document replaces the hibernated one
+    m_hibernatedUrl = KUrl();
+
     KUrl url( _url );
     if ( url.hasHTMLRef() )
     {
@@ -1461,7 +1476,8 @@ bool Part::closeUrl(bool promptToSave)
         if ( fi.isSymLink() ) m_watcher->removeFile( fi.readLink() );
     }
     m_fileWasRemoved = false;
-    if ( m_generatorGuiClient )
+    // the part of a background tab is not in the factory
+    if ( m_generatorGuiClient && factory() )
         factory()->removeClient( m_generatorGuiClient );
     m_generatorGuiClient = 0;
     m_document->closeDocument();
@@ -1606,9 +1622,12 @@ void Part::slotDoFileDirty()
         m_pageView->displayMessage( i18n("Reloading the document...") );
     }
 
-    // close and (try to) reopen the document
+    // close and (try to) reopen the document, keeping what was rendered
+    // for the pages that will not change
+    m_document->setKeepPagesOnClose( true );
     if ( !closeUrl() )
     {
+        m_document->setKeepPagesOnClose( false );
         m_viewportDirty.pageNumber = -1;
 
         if ( tocReloadPrepared ) 
@@ -1657,6 +1676,57 @@ void Part::slotDoFileDirty()
     }
 }
 
+void Part::hibernate()
+{
+    if ( !m_document->isOpened() || m_viewportDirty.pageNumber != -1 )
+        return;
+
+    const bool closeDocument = Okular::Settings::hibernateClosesDocument();
+
+    // closing a modified document would lose its changes, so only the
+    // memory it uses is freed in that case
+    if ( closeDocument && !isModified() && !url().isEmpty() )
+    {
+        const KUrl hibernatedUrl = url();
+        m_hibernatedViewport = m_document->viewport();
+        m_hibernatedRotation = m_document->rotation();
+        if ( closeUrl( false ) )
+        {
+            m_hibernatedUrl = hibernatedUrl;
+            return;
+        }
+    }
+
+    m_document->hibernate();
+}
+
+
+int Part::hibernateTabsAfter() const
+{
+    return Okular::Settings::hibernateTabsAfter();
+}
+
+
+void Part::wakeUp()
+{
+    if ( m_hibernatedUrl.isEmpty() )
+    {
+        m_document->wakeUp();
+        return;
+    }
+
+    const KUrl hibernatedUrl = m_hibernatedUrl;
+    m_hibernatedUrl = KUrl();
+    if ( KParts::ReadWritePart::openUrl( hibernatedUrl ) )
+    {
+        // restore the viewport the document had when it was closed
+        if ( m_hibernatedViewport.pageNumber >= (int) m_document->pages() )
+            m_hibernatedViewport.pageNumber = (int) m_document->pages() - 1;
+        m_document->setViewport( m_hibernatedViewport );
+        m_document->setRotation( m_hibernatedRotation );
+    }
+}
+
 
 void Part::updateViewActions()
 {
@@ -2501,6 +2571,9 @@ void Part::slotPrint()
 {
     if (m_document->pages() == 0) return;
 
+    // the print range covers all the pages
+    m_document->loadAllPages();
+
 #ifdef Q_WS_WIN
     QPrinter printer(QPrinter::HighResolution);
 #else
@@ -224,6 +224,11 @@ class OKULAR_PART_EXPORT Part : public KParts::ReadWritePart, public Okular::Doc
         void slotDoFileDirty();
         void psTransformEnded(int, QProcess::ExitStatus);
         KConfigDialog * slotGeneratorPreferences();
+        // connected to Shell tabs, free the memory of the documents not shown
+        // for hibernateTabsAfter() minutes (0 = never)
+        void hibernate();
+        void wakeUp();
+        int hibernateTabsAfter() const;
 
     private:
         void setupViewerActions();
@@ -279,6 +284,11 @@ class OKULAR_PART_EXPORT Part : public KParts::ReadWritePart, public Okular::Doc
         bool m_fileWasRemoved;
         Rotation m_dirtyPageRotation;
 
+        // hibernated document variables
+        KUrl m_hibernatedUrl;
+        Okular::DocumentViewport m_hibernatedViewport;
+        Rotation m_hibernatedRotation;
+
         // Remember the search history
         QStringList m_searchHistory;
 
@@ -103,6 +103,10 @@ void Shell::init()
     connect( m_tabWidget, SIGNAL(currentChanged(int)), SLOT(setActiveTab(int)) );
     connect( m_tabWidget, SIGNAL(tabCloseRequested(int)), SLOT(closeTab(int)) );
 
+    m_hibernateTimer = new QTimer( this );
+    connect( m_hibernateTimer, SIGNAL(timeout()), SLOT(hibernateIdleTabs()) );
+    m_hibernateTimer->start( 60 * 1000 );
+
     setCentralWidget( m_tabWidget );
 
     // then, setup our actions
@@ -470,6 +474,13 @@ void Shell::setActiveTab( int tab )
     createGUI( m_tabs[tab].part );
     m_printAction->setEnabled( m_tabs[tab].printEnabled );
     m_closeAction->setEnabled( m_tabs[tab].closeEnabled );
+
+    m_tabs[tab].lastActive.restart();
+    if( m_tabs[tab].hibernated )
+    {
+        m_tabs[tab].hibernated = false;
+        QMetaObject::invokeMethod( m_tabs[tab].part, "wakeUp" );
+    }
 }
 
 void Shell::closeTab( int tab )
@@ -576,6 +587,34 @@ void Shell::activatePrevTab()
     setActiveTab( prevTab );
 }
 
+void Shell::hibernateIdleTabs()
+{
+    if( m_tabs.isEmpty() )
+        return;
+
+    // the delay is a setting of the part, the same for all the tabs
+    int hibernateTabsAfter = 0;
+    QMetaObject::invokeMethod( m_tabs[0].part, "hibernateTabsAfter", Q_RETURN_ARG( int, hibernateTabsAfter ) );
+
+    const int activeTab = m_tabWidget->currentIndex();
+    const qint64 idleTime = qint64( hibernateTabsAfter ) * 60 * 1000;
+    for( int i = 0; i < m_tabs.size(); ++i )
+    {
+        // the active tab is never idle
+        if( i == activeTab )
+        {
+            m_tabs[i].lastActive.restart();
+            continue;
+        }
+
+        if( hibernateTabsAfter > 0 && !m_tabs[i].hibernated && m_tabs[i].lastActive.elapsed() > idleTime )
+        {
+            m_tabs[i].hibernated = true;
+            QMetaObject::invokeMethod( m_tabs[i].part, "hibernate" );
+        }
+    }
+}
+
 void Shell::setTabIcon( KMimeType::Ptr mimeType )
 {
     int i = findTabIndex( sender() );
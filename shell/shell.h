@@ -19,6 +19,7 @@
 #include <kparts/mainwindow.h>
 #include <kmimetype.h>
 
+#include <QtCore/QElapsedTimer>
 #include <QtDBus/QtDBus>
 
 class KCmdLineArgs;
@@ -26,6 +27,7 @@ class KRecentFilesAction;
 class KToggleAction;
 class KTabWidget;
 class KPluginFactory;
+class QTimer;
 
 class KDocumentViewer;
 class Part;
@@ -104,6 +106,7 @@ private slots:
   void closeTab( int tab );
   void activateNextTab();
   void activatePrevTab();
+  void hibernateIdleTabs();
 
 signals:
   void restoreDocument(const KConfigGroup &group);
@@ -139,16 +142,25 @@ private:
     TabState( KParts::ReadWritePart* p )
       : part(p),
         printEnabled(false),
-        closeEnabled(false)
-    {}
+        closeEnabled(false),
+        hibernated(false)
+    {
+      lastActive.start();
+    }
     KParts::ReadWritePart* part;
     bool printEnabled;
     bool closeEnabled;
+    bool hibernated;
+    QElapsedTimer lastActive;
   };
   QList<TabState> m_tabs;
   KAction* m_nextTabAction;
   KAction* m_prevTabAction;
 
+  // background tabs idle for longer than the HibernateTabsAfter minutes of
+  // the part settings (0 = never) release their memory
+  QTimer* m_hibernateTimer;
+
 #ifdef KActivities_FOUND
   KActivities::ResourceInstance* m_activityResource;
 #endif
@@ -0,0 +1,111 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include <qtest_kde.h>
+
+#include <QtCore/QFile>
+#include <QtXml/QDomDocument>
+
+#include <ktempdir.h>
+
+#include "../core/documentinfojournal_p.h"
+
+class DocumentInfoJournalTest
+: public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void testReplay();
+        void testTruncatedRecord();
+
+    private:
+        static QByteArray pageRecord( int number, const QString &note );
+        static QString note( const QDomDocument &doc, int number );
+};
+
+QByteArray DocumentInfoJournalTest::pageRecord( int number, const QString &note )
+{
+    QDomDocument doc;
+    QDomElement page = doc.createElement( "page" );
+    page.setAttribute( "number", number );
+    if ( !note.isEmpty() )
+    {
+        QDomElement annotation = doc.createElement( "annotation" );
+        annotation.setAttribute( "note", note );
+        page.appendChild( annotation );
+    }
+    return Okular::DocumentInfoJournal::record( page );
+}
+
+QString DocumentInfoJournalTest::note( const QDomDocument &doc, int number )
+{
+    const QDomElement pageList = doc.documentElement().firstChildElement( "pageList" );
+    for ( QDomElement page = pageList.firstChildElement( "page" ); !page.isNull(); page = page.nextSiblingElement( "page" ) )
+    {
+        if ( page.attribute( "number" ).toInt() == number )
+            return page.firstChildElement( "annotation" ).attribute( "note", QString::fromLatin1( "<empty>" ) );
+    }
+    return QString();
+}
+
+void DocumentInfoJournalTest::testReplay()
+{
+    KTempDir dir;
+    const QString fileName = dir.name() + QLatin1String( "docdata.journal" );
+
+    QDomDocument doc( "documentInfo" );
+    QVERIFY( doc.setContent( QString::fromLatin1( "<documentInfo url=\"doc.pdf\"><pageList><page number=\"1\"><annotation note=\"saved\"/></page>"
+                                                  "<page number=\"2\"><annotation note=\"kept\"/></page></pageList>"
+                                                  "<generalInfo><rotation>1</rotation></generalInfo></documentInfo>" ) ) );
+
+    QVERIFY( !Okular::DocumentInfoJournal::replay( fileName, doc ) );
+
+    QDomDocument general;
+    QDomElement generalInfo = general.createElement( "generalInfo" );
+    generalInfo.appendChild( general.createElement( "history" ) );
+
+    QVERIFY( Okular::DocumentInfoJournal::append( fileName, pageRecord( 1, QString::fromLatin1( "first" ) ) + pageRecord( 4, QString::fromLatin1( "new" ) ) ) );
+    QVERIFY( Okular::DocumentInfoJournal::append( fileName, pageRecord( 1, QString() ) + Okular::DocumentInfoJournal::record( generalInfo ) ) );
+    QVERIFY( Okular::DocumentInfoJournal::replay( fileName, doc ) );
+
+    // the last record of a page wins, the other pages are left alone
+    QCOMPARE( note( doc, 1 ), QString::fromLatin1( "<empty>" ) );
+    QCOMPARE( note( doc, 2 ), QString::fromLatin1( "kept" ) );
+    QCOMPARE( note( doc, 4 ), QString::fromLatin1( "new" ) );
+    QCOMPARE( doc.documentElement().elementsByTagName( "page" ).count(), 3 );
+
+    const QDomElement replayedInfo = doc.documentElement().firstChildElement( "generalInfo" );
+    QVERIFY( replayedInfo.firstChildElement( "rotation" ).isNull() );
+    QVERIFY( !replayedInfo.firstChildElement( "history" ).isNull() );
+    QVERIFY( replayedInfo.nextSiblingElement( "generalInfo" ).isNull() );
+
+    // a journal without a document info file
+    QDomDocument empty( "documentInfo" );
+    QVERIFY( Okular::DocumentInfoJournal::replay( fileName, empty ) );
+    QCOMPARE( empty.documentElement().tagName(), QString::fromLatin1( "documentInfo" ) );
+    QCOMPARE( note( empty, 4 ), QString::fromLatin1( "new" ) );
+}
+
+void DocumentInfoJournalTest::testTruncatedRecord()
+{
+    KTempDir dir;
+    const QString fileName = dir.name() + QLatin1String( "docdata.journal" );
+
+    QVERIFY( Okular::DocumentInfoJournal::append( fileName, pageRecord( 0, QString::fromLatin1( "whole" ) ) ) );
+    const QByteArray cut = pageRecord( 0, QString::fromLatin1( "cut" ) );
+    QVERIFY( Okular::DocumentInfoJournal::append( fileName, cut.left( cut.size() - 5 ) ) );
+
+    QDomDocument doc( "documentInfo" );
+    QVERIFY( Okular::DocumentInfoJournal::replay( fileName, doc ) );
+    QCOMPARE( note( doc, 0 ), QString::fromLatin1( "whole" ) );
+}
+
+QTEST_KDEMAIN( DocumentInfoJournalTest, NoGUI )
+#include "documentinfojournaltest.moc"
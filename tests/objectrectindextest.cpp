@@ -0,0 +1,132 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include <qtest_kde.h>
+
+#include <limits>
+
+#include "../core/area.h"
+#include "../core/objectrectindex_p.h"
+
+class ObjectRectIndexTest
+: public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void init();
+        void cleanup();
+        void testCandidates();
+        void testNearest();
+        void testSourceReferences();
+
+    private:
+        const Okular::ObjectRect *addRect( Okular::ObjectRect *rect );
+
+        QLinkedList< Okular::ObjectRect * > m_rects;
+        // the same, to look them up by position
+        QList< const Okular::ObjectRect * > m_list;
+};
+
+const Okular::ObjectRect *ObjectRectIndexTest::addRect( Okular::ObjectRect *rect )
+{
+    m_rects.append( rect );
+    m_list.append( rect );
+    return rect;
+}
+
+void ObjectRectIndexTest::init()
+{
+    // a grid of small links, with a big one over all of them at the end
+    for ( int row = 0; row < 40; ++row )
+    {
+        for ( int column = 0; column < 20; ++column )
+        {
+            const double left = column * 0.05, top = row * 0.025;
+            addRect( new Okular::ObjectRect( left, top, left + 0.04, top + 0.02, false, Okular::ObjectRect::Action, 0 ) );
+        }
+    }
+    addRect( new Okular::ObjectRect( 0.0, 0.0, 1.0, 0.5, false, Okular::ObjectRect::Action, 0 ) );
+    addRect( new Okular::ObjectRect( 0.5, 0.5, 0.6, 0.6, false, Okular::ObjectRect::Image, 0 ) );
+}
+
+void ObjectRectIndexTest::cleanup()
+{
+    qDeleteAll( m_rects );
+    m_rects.clear();
+    m_list.clear();
+}
+
+void ObjectRectIndexTest::testCandidates()
+{
+    const Okular::ObjectRectIndex index( m_rects );
+
+    // the big link comes first, as it is the last of the list
+    QVector< const Okular::ObjectRect * > candidates = index.candidates( Okular::ObjectRect::Action, 0.12, 0.01, 0.001, 0.001 );
+    QVERIFY( candidates.count() >= 2 );
+    QCOMPARE( candidates.first(), m_list.at( m_list.count() - 2 ) );
+    QVERIFY( candidates.contains( m_list.at( 2 ) ) );
+    QVERIFY( !candidates.contains( m_list.at( 200 ) ) );
+
+    candidates = index.candidates( Okular::ObjectRect::Image, 0.55, 0.55, 0.001, 0.001 );
+    QCOMPARE( candidates.count(), 1 );
+    QCOMPARE( candidates.first(), m_list.last() );
+
+    QVERIFY( index.candidates( Okular::ObjectRect::SourceRef, 0.5, 0.5, 1.0, 1.0 ).isEmpty() );
+}
+
+void ObjectRectIndexTest::testNearest()
+{
+    const Okular::ObjectRectIndex index( m_rects );
+
+    const double points[][2] = { { 0.12, 0.73 }, { 0.5, 0.95 }, { 0.999, 0.51 }, { -0.5, 1.5 }, { 0.3, 0.3 } };
+    for ( uint i = 0; i < sizeof( points ) / sizeof( points[0] ); ++i )
+    {
+        const double x = points[i][0], y = points[i][1];
+
+        // the first of the nearest rects of the list
+        const Okular::ObjectRect *expected = 0;
+        double expectedDistance = std::numeric_limits<double>::max();
+        foreach ( const Okular::ObjectRect *rect, m_list )
+        {
+            if ( rect->objectType() != Okular::ObjectRect::Action )
+                continue;
+            const double d = rect->distanceSqr( x, y, 800, 1000 );
+            if ( d < expectedDistance )
+            {
+                expected = rect;
+                expectedDistance = d;
+            }
+        }
+
+        double distance;
+        QCOMPARE( index.nearest( Okular::ObjectRect::Action, x, y, 800, 1000, &distance ), expected );
+        QCOMPARE( distance, expectedDistance );
+    }
+}
+
+void ObjectRectIndexTest::testSourceReferences()
+{
+    for ( int i = 0; i < 100; ++i )
+        addRect( new Okular::SourceRefObjectRect( Okular::NormalizedPoint( 0.2 + i * 0.005, 0.3 ), 0 ) );
+    const Okular::ObjectRect *point = addRect( new Okular::SourceRefObjectRect( Okular::NormalizedPoint( 0.2, 0.2 ), 0 ) );
+    const Okular::ObjectRect *line = addRect( new Okular::SourceRefObjectRect( Okular::NormalizedPoint( -1.0, 0.8 ), 0 ) );
+    const Okular::ObjectRectIndex index( m_rects );
+
+    // the references without a coordinate span the whole width of the page
+    QVector< const Okular::ObjectRect * > candidates = index.candidates( Okular::ObjectRect::SourceRef, 0.9, 0.8, 0.01, 0.01 );
+    QCOMPARE( candidates.count(), 1 );
+    QCOMPARE( candidates.first(), line );
+
+    QCOMPARE( index.nearest( Okular::ObjectRect::SourceRef, 0.2, 0.21, 100, 100, 0 ), point );
+    QCOMPARE( index.nearest( Okular::ObjectRect::SourceRef, 0.05, 0.7, 100, 100, 0 ), line );
+}
+
+QTEST_KDEMAIN( ObjectRectIndexTest, NoGUI )
+#include "objectrectindextest.moc"
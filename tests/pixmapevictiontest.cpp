@@ -0,0 +1,132 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include <qtest_kde.h>
+
+#include "../core/observer.h"
+#include "../core/pixmapeviction_p.h"
+
+class PinningObserver : public Okular::DocumentObserver
+{
+    public:
+        PinningObserver() : pinnedPage( -1 ) {}
+
+        bool canUnloadPixmap( int page ) const
+        {
+            return page != pinnedPage;
+        }
+
+        int pinnedPage;
+};
+
+class PixmapEvictionTest
+: public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void testDistance();
+        void testLeastRecentlyUsed();
+        void testAdaptiveKeepsFrequent();
+        void testTakeAndClear();
+};
+
+static void fill( Okular::PixmapEvictionIndex &index, Okular::DocumentObserver *observer, int pages )
+{
+    for ( int i = 0; i < pages; ++i )
+        index.insert( new AllocatedPixmap( observer, i, 100 ) );
+}
+
+void PixmapEvictionTest::testDistance()
+{
+    PinningObserver observer;
+    Okular::PixmapEvictionIndex index;
+    fill( index, &observer, 10 );
+
+    AllocatedPixmap *p = index.takeVictim( 2, false );
+    QCOMPARE( p->page, 9 );
+    delete p;
+
+    p = index.takeVictim( 8, false );
+    QCOMPARE( p->page, 0 );
+    delete p;
+
+    // pinned pixmaps are skipped only when asked to
+    observer.pinnedPage = 1;
+    QCOMPARE( index.victim( 8, false )->page, 1 );
+    QCOMPARE( index.victim( 8, true )->page, 2 );
+    QCOMPARE( index.count(), 8 );
+}
+
+void PixmapEvictionTest::testLeastRecentlyUsed()
+{
+    Okular::DocumentObserver observer1, observer2;
+    Okular::PixmapEvictionIndex index;
+    index.setPolicy( Okular::PixmapEvictionIndex::LeastRecentlyUsed );
+    fill( index, &observer1, 3 );
+    fill( index, &observer2, 3 );
+
+    index.touch( &observer1, 0 );
+    QCOMPARE( index.victim( 0, false )->observer, &observer1 );
+    QCOMPARE( index.victim( 0, false )->page, 1 );
+
+    index.touch( &observer1, 1 );
+    index.touch( &observer1, 2 );
+    QCOMPARE( index.victim( 0, false )->observer, &observer2 );
+    QCOMPARE( index.victim( 0, false )->page, 0 );
+
+    // filtered by observer
+    QCOMPARE( index.victim( 0, false, &observer1 )->page, 0 );
+}
+
+void PixmapEvictionTest::testAdaptiveKeepsFrequent()
+{
+    Okular::DocumentObserver observer;
+    Okular::PixmapEvictionIndex index;
+    index.setPolicy( Okular::PixmapEvictionIndex::Adaptive );
+    fill( index, &observer, 4 );
+
+    // page 0 is used again and again, then a scan goes through other pages
+    index.touch( &observer, 0 );
+    for ( int i = 4; i < 12; ++i )
+    {
+        index.insert( new AllocatedPixmap( &observer, i, 100 ) );
+        AllocatedPixmap *p = index.takeVictim( i, false );
+        QVERIFY( p->page != 0 );
+        delete p;
+    }
+    QCOMPARE( index.count(), 4 );
+}
+
+void PixmapEvictionTest::testTakeAndClear()
+{
+    Okular::DocumentObserver observer1, observer2;
+    Okular::PixmapEvictionIndex index;
+    fill( index, &observer1, 5 );
+    fill( index, &observer2, 5 );
+
+    AllocatedPixmap *p = index.take( &observer1, 3 );
+    QVERIFY( p );
+    QCOMPARE( p->page, 3 );
+    QVERIFY( !index.take( &observer1, 3 ) );
+    delete p;
+
+    const QList< AllocatedPixmap * > pixmaps = index.takeAll( &observer2 );
+    QCOMPARE( pixmaps.count(), 5 );
+    qDeleteAll( pixmaps );
+    QCOMPARE( index.count(), 4 );
+    QVERIFY( !index.victim( 0, false, &observer2 ) );
+
+    index.clear();
+    QVERIFY( index.isEmpty() );
+    QVERIFY( !index.victim( 0, false ) );
+}
+
+QTEST_KDEMAIN( PixmapEvictionTest, NoGUI )
+#include "pixmapevictiontest.moc"
@@ -0,0 +1,184 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include <qtest_kde.h>
+
+#include "../core/generator.h"
+#include "../core/observer.h"
+#include "../core/pixmaprequestqueue_p.h"
+
+class PixmapRequestQueueTest
+: public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void testPriorityOrder();
+        void testReplaceSamePage();
+        void testTakeAllOfObserver();
+        void testRemoveKeepsOrder();
+        void testTopSkipping();
+};
+
+static Okular::PixmapRequest *makeRequest( Okular::DocumentObserver *observer, int page, int priority )
+{
+    return new Okular::PixmapRequest( observer, page, 100, 100, priority, Okular::PixmapRequest::Asynchronous );
+}
+
+void PixmapRequestQueueTest::testPriorityOrder()
+{
+    Okular::DocumentObserver observer;
+    Okular::PixmapRequestQueue queue;
+
+    Okular::PixmapRequest *low1 = makeRequest( &observer, 1, 3 );
+    Okular::PixmapRequest *high = makeRequest( &observer, 2, 1 );
+    Okular::PixmapRequest *low2 = makeRequest( &observer, 3, 3 );
+    Okular::PixmapRequest *urgent1 = makeRequest( &observer, 4, 0 );
+    Okular::PixmapRequest *urgent2 = makeRequest( &observer, 5, 0 );
+    QVERIFY( !queue.enqueue( low1 ) );
+    QVERIFY( !queue.enqueue( high ) );
+    QVERIFY( !queue.enqueue( low2 ) );
+    QVERIFY( !queue.enqueue( urgent1 ) );
+    QVERIFY( !queue.enqueue( urgent2 ) );
+    QCOMPARE( queue.count(), 5 );
+
+    // priority zero: newest first; other priorities: oldest first
+    QCOMPARE( queue.takeTop(), urgent2 );
+    QCOMPARE( queue.takeTop(), urgent1 );
+    QCOMPARE( queue.takeTop(), high );
+    QCOMPARE( queue.takeTop(), low1 );
+    QCOMPARE( queue.takeTop(), low2 );
+    QVERIFY( queue.isEmpty() );
+    QVERIFY( !queue.takeTop() );
+
+    qDeleteAll( QList< Okular::PixmapRequest * >() << low1 << high << low2 << urgent1 << urgent2 );
+}
+
+void PixmapRequestQueueTest::testReplaceSamePage()
+{
+    Okular::DocumentObserver observer1;
+    Okular::DocumentObserver observer2;
+    Okular::PixmapRequestQueue queue;
+
+    Okular::PixmapRequest *first = makeRequest( &observer1, 7, 2 );
+    Okular::PixmapRequest *other = makeRequest( &observer2, 7, 2 );
+    Okular::PixmapRequest *second = makeRequest( &observer1, 7, 1 );
+    QVERIFY( !queue.enqueue( first ) );
+    QVERIFY( !queue.enqueue( other ) );
+    QCOMPARE( queue.enqueue( second ), first );
+    QCOMPARE( queue.count(), 2 );
+    QCOMPARE( queue.take( &observer1, 7 ), second );
+    QCOMPARE( queue.take( &observer2, 7 ), other );
+    QVERIFY( queue.isEmpty() );
+
+    delete first;
+    delete second;
+    delete other;
+}
+
+void PixmapRequestQueueTest::testTakeAllOfObserver()
+{
+    Okular::DocumentObserver observer1;
+    Okular::DocumentObserver observer2;
+    Okular::PixmapRequestQueue queue;
+
+    for ( int i = 0; i < 10; ++i )
+    {
+        queue.enqueue( makeRequest( &observer1, i, i % 3 + 1 ) );
+        queue.enqueue( makeRequest( &observer2, i, i % 4 + 1 ) );
+    }
+
+    QList< Okular::PixmapRequest * > taken = queue.takeAll( &observer1 );
+    QCOMPARE( taken.count(), 10 );
+    foreach ( Okular::PixmapRequest *request, taken )
+        QCOMPARE( request->observer(), &observer1 );
+    qDeleteAll( taken );
+
+    QCOMPARE( queue.count(), 10 );
+    int lastPriority = 0;
+    while ( !queue.isEmpty() )
+    {
+        Okular::PixmapRequest *request = queue.takeTop();
+        QCOMPARE( request->observer(), &observer2 );
+        QVERIFY( request->priority() >= lastPriority );
+        lastPriority = request->priority();
+        delete request;
+    }
+}
+
+void PixmapRequestQueueTest::testRemoveKeepsOrder()
+{
+    Okular::DocumentObserver observer;
+    Okular::PixmapRequestQueue queue;
+
+    QList< Okular::PixmapRequest * > requests;
+    for ( int i = 0; i < 100; ++i )
+    {
+        Okular::PixmapRequest *request = makeRequest( &observer, i, ( i * 37 ) % 11 + 1 );
+        requests.append( request );
+        queue.enqueue( request );
+    }
+
+    // remove every third request from the middle of the heap
+    for ( int i = 0; i < requests.count(); i += 3 )
+        QVERIFY( queue.dispatch( requests.at( i ) ) );
+    QVERIFY( !queue.remove( requests.at( 0 ) ) );
+    QCOMPARE( queue.dispatchedCount(), 34 );
+    QCOMPARE( queue.count(), 66 );
+
+    int lastPriority = 0;
+    int lastPage = -1;
+    while ( !queue.isEmpty() )
+    {
+        Okular::PixmapRequest *request = queue.takeTop();
+        QVERIFY( request->pageNumber() % 3 != 0 );
+        QVERIFY( request->priority() >= lastPriority );
+        if ( request->priority() == lastPriority )
+            QVERIFY( request->pageNumber() > lastPage );
+        lastPriority = request->priority();
+        lastPage = request->pageNumber();
+    }
+
+    qDeleteAll( requests );
+}
+
+void PixmapRequestQueueTest::testTopSkipping()
+{
+    Okular::DocumentObserver observer;
+    Okular::PixmapRequestQueue queue;
+
+    QList< Okular::PixmapRequest * > requests;
+    for ( int i = 0; i < 50; ++i )
+    {
+        Okular::PixmapRequest *request = makeRequest( &observer, i, ( i * 7 ) % 5 + 1 );
+        requests.append( request );
+        queue.enqueue( request );
+    }
+
+    // skipping the requests one after the other gives the queue order
+    QSet< Okular::PixmapRequest * > skipped;
+    QList< Okular::PixmapRequest * > order;
+    while ( Okular::PixmapRequest *request = queue.top( skipped ) )
+    {
+        order.append( request );
+        skipped.insert( request );
+    }
+    QCOMPARE( order.count(), 50 );
+    QCOMPARE( queue.count(), 50 );
+    QCOMPARE( queue.top( QSet< Okular::PixmapRequest * >() ), queue.top() );
+
+    foreach ( Okular::PixmapRequest *request, order )
+        QCOMPARE( queue.takeTop(), request );
+    QVERIFY( queue.isEmpty() );
+
+    qDeleteAll( requests );
+}
+
+QTEST_KDEMAIN( PixmapRequestQueueTest, NoGUI )
+#include "pixmaprequestqueuetest.moc"
@@ -0,0 +1,102 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include <qtest_kde.h>
+
+#include <QtCore/QDateTime>
+
+#include <ktempdir.h>
+
+#include "../core/textsearchindex_p.h"
+
+typedef QVector< int > Pages;
+
+class TextSearchIndexTest
+: public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void testWords();
+        void testPhrases();
+        void testHyphens();
+        void testSaveLoad();
+
+    private:
+        static Okular::TextSearchIndex createIndex();
+};
+
+Okular::TextSearchIndex TextSearchIndexTest::createIndex()
+{
+    Okular::TextSearchIndex index( 3 );
+    index.addPage( 0, QString::fromLatin1( "The quick brown fox\n" ) );
+    index.addPage( 1, QString::fromLatin1( "jumps over the lazy dog\n" ) );
+    index.addPage( 2, QString::fromLatin1( "Quickly, the fox left\n" ) );
+    return index;
+}
+
+void TextSearchIndexTest::testWords()
+{
+    const Okular::TextSearchIndex index = createIndex();
+
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "fox" ) ), Pages() << 0 << 2 );
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "THE" ) ), Pages() << 0 << 1 << 2 );
+    // parts of words match too
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "uick" ) ), Pages() << 0 << 2 );
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "cat" ) ), Pages() );
+    // nothing to look for
+    QCOMPARE( index.candidatePages( QString::fromLatin1( " " ) ), Pages() << 0 << 1 << 2 );
+}
+
+void TextSearchIndexTest::testPhrases()
+{
+    const Okular::TextSearchIndex index = createIndex();
+
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "quick brown" ) ), Pages() << 0 );
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "lazy dog" ) ), Pages() << 1 );
+    // only the words are looked at, not their order
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "the fox" ) ), Pages() << 0 << 2 );
+    // the piece before a space has to end a word, the one after to start one
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "ick bro" ) ), Pages() << 0 );
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "quic brown" ) ), Pages() );
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "quick rown" ) ), Pages() );
+}
+
+void TextSearchIndexTest::testHyphens()
+{
+    Okular::TextSearchIndex index( 2 );
+    index.addPage( 0, QString::fromLatin1( "a hyphen-\nated word\n" ) );
+    index.addPage( 1, QString::fromLatin1( "a well-known fact\n" ) );
+
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "hyphenated" ) ), Pages() << 0 );
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "hyphen" ) ), Pages() << 0 );
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "ated word" ) ), Pages() << 0 );
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "well-known" ) ), Pages() << 1 );
+    QCOMPARE( index.candidatePages( QString::fromLatin1( "wellknown" ) ), Pages() << 1 );
+}
+
+void TextSearchIndexTest::testSaveLoad()
+{
+    KTempDir dir;
+    const QString fileName = dir.name() + QLatin1String( "test.index" );
+    const QDateTime stamp( QDate( 2014, 1, 1 ), QTime( 12, 0 ) );
+
+    const Okular::TextSearchIndex index = createIndex();
+    QVERIFY( index.save( fileName, stamp ) );
+
+    Okular::TextSearchIndex loaded;
+    QVERIFY( !loaded.load( fileName, 4, stamp ) );
+    QVERIFY( !loaded.load( fileName, 3, stamp.addSecs( 1 ) ) );
+    QVERIFY( loaded.load( fileName, 3, stamp ) );
+    QCOMPARE( loaded.pageCount(), 3 );
+    QCOMPARE( loaded.candidatePages( QString::fromLatin1( "lazy dog" ) ), Pages() << 1 );
+}
+
+QTEST_KDEMAIN( TextSearchIndexTest, NoGUI )
+#include "textsearchindextest.moc"
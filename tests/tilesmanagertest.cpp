@@ -0,0 +1,71 @@
+/***************************************************************************
+ *   Copyright (C) 2014 by agent <agent@local>                             *
+ *                                                                         *
+ *   This program is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU General Public License as published by  *
+ *   the Free Software Foundation; either version 2 of the License, or     *
+ *   (at your option) any later version.                                   *
+ ***************************************************************************/
+
+#include <qtest_kde.h>
+
+#include <QPixmap>
+
+#include "../core/tilesmanager_p.h"
+
+class TilesManagerTest
+: public QObject
+{
+    Q_OBJECT
+
+    private slots:
+        void testLatePixmap();
+        void testAbortedRequest();
+};
+
+// A pixmap which is not the one of the current request is dropped
+void TilesManagerTest::testLatePixmap()
+{
+    Okular::TilesManager tm( 0, 4000, 4000 );
+    const Okular::NormalizedRect rect( 0, 0, 0.25, 0.25 );
+    const Okular::NormalizedRect otherRect( 0.25, 0, 0.5, 0.25 );
+
+    tm.setRequest( rect, 4000, 4000 );
+    QVERIFY( tm.isRequesting( rect, 4000, 4000 ) );
+
+    QPixmap pixmap( rect.geometry( 4000, 4000 ).size() );
+    tm.setPixmap( &pixmap, otherRect );
+    QVERIFY( !tm.hasPixmap( otherRect ) );
+    QVERIFY( tm.isRequesting( rect, 4000, 4000 ) );
+
+    tm.setPixmap( &pixmap, rect );
+    QVERIFY( tm.hasPixmap( rect ) );
+    QVERIFY( !tm.isRequesting( rect, 4000, 4000 ) );
+}
+
+// An aborted request never sets its pixmap: the document resets the request
+// of the tiles manager, so that asking for the same tiles again is not
+// ignored as "already being generated"
+void TilesManagerTest::testAbortedRequest()
+{
+    Okular::TilesManager tm( 0, 4000, 4000 );
+    const Okular::NormalizedRect rect( 0, 0, 0.25, 0.25 );
+
+    // the request is sent to the generator, and aborted
+    tm.setRequest( rect, 4000, 4000 );
+    tm.setRequest( Okular::NormalizedRect(), 0, 0 );
+    QVERIFY( !tm.isRequesting( rect, 4000, 4000 ) );
+    QVERIFY( !tm.hasPixmap( rect ) );
+
+    // the same tiles are requested again, and rendered this time
+    tm.setRequest( rect, 4000, 4000 );
+    QVERIFY( tm.isRequesting( rect, 4000, 4000 ) );
+
+    QPixmap pixmap( rect.geometry( 4000, 4000 ).size() );
+    tm.setPixmap( &pixmap, rect );
+    QVERIFY( tm.hasPixmap( rect ) );
+    QVERIFY( !tm.isRequesting( rect, 4000, 4000 ) );
+}
+
+QTEST_KDEMAIN( TilesManagerTest, GUI )
+#include "tilesmanagertest.moc"
@@ -239,6 +239,10 @@ void AnnotationModelPrivate::rebuildTree( const QVector< Okular::Page * > &pages
     emit q->layoutAboutToBeChanged();
     for ( int i = 0; i < pages.count(); ++i )
     {
+        // pages not loaded yet are added when they are
+        if ( !pages.at( i )->isMetadataLoaded() )
+            continue;
+
         const QLinkedList< Okular::Annotation* > annots = filterOutWidgetAnnotations( pages.at( i )->annotations() );
         if ( annots.isEmpty() )
             continue;
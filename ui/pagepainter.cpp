@@ -234,6 +234,31 @@ void PagePainter::paintCroppedPageOnPainter( QPainter * destPainter, const Okula
 
     /** 3 - ENABLE BACKBUFFERING IF DIRECT IMAGE MANIPULATION IS NEEDED **/
     bool bufferAccessibility = (flags & Accessibility) && Okular::SettingsCore::changeColors() && (Okular::SettingsCore::renderMode() != Okular::SettingsCore::EnumRenderMode::Paper);
+    const bool pixmapHasAlpha = pixmap ? pixmap->hasAlpha() : true;
+    // the pixmap of another observer is not kept transformed, only the
+    // painted part of it is changed
+    if ( bufferAccessibility && pixmap && page->hasPixmap( observer ) )
+    {
+        // change the colors of the whole pixmap once, and keep the result
+        // with the page for the next paints
+        const QByteArray transform = colorsTransform();
+        const QPixmap *transformed = page->_o_transformedPixmap( observer, pixmap, transform );
+        if ( !transformed )
+        {
+            QImage image = pixmap->toImage().convertToFormat( QImage::Format_ARGB32_Premultiplied );
+            changeImageColors( image );
+            // the painters get the pages read-only, the transformed pixmap
+            // is a cache of the page for its own pixmap
+            Okular::Page *cachePage = const_cast< Okular::Page * >( page );
+            if ( cachePage->_o_setTransformedPixmap( observer, pixmap, transform, QPixmap::fromImage( image ) ) )
+                transformed = page->_o_transformedPixmap( observer, pixmap, transform );
+        }
+        if ( transformed )
+        {
+            pixmap = transformed;
+            bufferAccessibility = false;
+        }
+    }
     bool useBackBuffer = bufferAccessibility || bufferedHighlights || bufferedAnnotations || viewPortPoint;
     QPixmap * backPixmap = 0;
     QPainter * mixedPainter = 0;
@@ -289,11 +314,7 @@ void PagePainter::paintCroppedPageOnPainter( QPainter * destPainter, const Okula
         // the image over which we are going to draw
         QImage backImage;
 
-        bool has_alpha;
-        if ( pixmap )
-            has_alpha = pixmap->hasAlpha();
-        else
-            has_alpha = true;
+        bool has_alpha = pixmapHasAlpha;
 
         if ( hasTilesManager )
         {
@@ -342,42 +363,7 @@ void PagePainter::paintCroppedPageOnPainter( QPainter * destPainter, const Okula
 
         // 4B.2. modify pixmap following accessibility settings
         if ( bufferAccessibility )
-        {
-            switch ( Okular::SettingsCore::renderMode() )
-            {
-                case Okular::SettingsCore::EnumRenderMode::Inverted:
-                    // Invert image pixels using QImage internal function
-                    backImage.invertPixels(QImage::InvertRgb);
-                    break;
-                case Okular::SettingsCore::EnumRenderMode::Recolor:
-                    // Recolor image using Blitz::flatten with dither:0
-                    Blitz::flatten( backImage, Okular::Settings::recolorForeground(), Okular::Settings::recolorBackground() );
-                    break;
-                case Okular::SettingsCore::EnumRenderMode::BlackWhite:
-                    // Manual Gray and Contrast
-                    unsigned int * data = (unsigned int *)backImage.bits();
-                    int val, pixels = backImage.width() * backImage.height(),
-                        con = Okular::Settings::bWContrast(), thr = 255 - Okular::Settings::bWThreshold();
-                    for( int i = 0; i < pixels; ++i )
-                    {
-                        val = qGray( data[i] );
-                        if ( val > thr )
-                            val = 128 + (127 * (val - thr)) / (255 - thr);
-                        else if ( val < thr )
-                            val = (128 * val) / thr;
-                        if ( con > 2 )
-                        {
-                            val = con * ( val - thr ) / 2 + thr;
-                            if ( val > 255 )
-                                val = 255;
-                            else if ( val < 0 )
-                                val = 0;
-                        }
-                        data[i] = qRgba( val, val, val, 255 );
-                    }
-                    break;
-            }
-        }
+            changeImageColors( backImage );
         // 4B.3. highlight rects in page
         if ( bufferedHighlights )
         {
@@ -910,6 +896,66 @@ void PagePainter::scalePixmapOnImage ( QImage & dest, const QPixmap * src,
 
 /** Private Helpers :: Image Drawing **/
 // from Arthur - qt4
+QByteArray PagePainter::colorsTransform()
+{
+    switch ( Okular::SettingsCore::renderMode() )
+    {
+        case Okular::SettingsCore::EnumRenderMode::Inverted:
+            return "inverted";
+        case Okular::SettingsCore::EnumRenderMode::Recolor:
+            return "recolor:" + Okular::Settings::recolorForeground().name().toLatin1()
+                   + ':' + Okular::Settings::recolorBackground().name().toLatin1();
+        case Okular::SettingsCore::EnumRenderMode::BlackWhite:
+            return "blackwhite:" + QByteArray::number( Okular::Settings::bWContrast() )
+                   + ':' + QByteArray::number( Okular::Settings::bWThreshold() );
+    }
+    return QByteArray();
+}
+
+void PagePainter::changeImageColors( QImage & image )
+{
+    switch ( Okular::SettingsCore::renderMode() )
+    {
+        case Okular::SettingsCore::EnumRenderMode::Inverted:
+            // Invert image pixels using QImage internal function
+            image.invertPixels(QImage::InvertRgb);
+            break;
+        case Okular::SettingsCore::EnumRenderMode::Recolor:
+            // Recolor image using Blitz::flatten with dither:0
+            Blitz::flatten( image, Okular::Settings::recolorForeground(), Okular::Settings::recolorBackground() );
+            break;
+        case Okular::SettingsCore::EnumRenderMode::BlackWhite:
+        {
+            // Manual Gray and Contrast, computed once for each gray level
+            unsigned int table[ 256 ];
+            const int con = Okular::Settings::bWContrast(), thr = 255 - Okular::Settings::bWThreshold();
+            for ( int gray = 0; gray < 256; ++gray )
+            {
+                int val = gray;
+                if ( val > thr )
+                    val = 128 + (127 * (val - thr)) / (255 - thr);
+                else if ( val < thr )
+                    val = (128 * val) / thr;
+                if ( con > 2 )
+                {
+                    val = con * ( val - thr ) / 2 + thr;
+                    if ( val > 255 )
+                        val = 255;
+                    else if ( val < 0 )
+                        val = 0;
+                }
+                table[ gray ] = qRgba( val, val, val, 255 );
+            }
+
+            unsigned int * data = (unsigned int *)image.bits();
+            const int pixels = image.width() * image.height();
+            for ( int i = 0; i < pixels; ++i )
+                data[i] = table[ qGray( data[i] ) ];
+            break;
+        }
+    }
+}
+
 static inline int qt_div_255(int x) { return (x + (x>>8) + 0x80) >> 8; }
 
 void PagePainter::changeImageAlpha( QImage & image, unsigned int destAlpha )
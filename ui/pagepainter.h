@@ -61,6 +61,11 @@ class PagePainter
         static void scalePixmapOnImage( QImage & dest, const QPixmap *src,
             int scaledWidth, int scaledHeight, const QRect & cropRect, QImage::Format format = QImage::Format_ARGB32_Premultiplied );
 
+        // the key of the accessibility colors transform in use, and the
+        // transform itself, applied to 'image' in place
+        static QByteArray colorsTransform();
+        static void changeImageColors( QImage & image );
+
         // set the alpha component of the image to a given value
         static void changeImageAlpha( QImage & image, unsigned int alpha );
 
@@ -116,12 +116,29 @@ public:
     OkularTTS* tts();
     QString selectedText() const;
 
+    // the items laid out in the rows crossing the range from top to bottom
+    QVector< PageViewItem * > itemsInRows( int top, int bottom ) const;
+    // places the form and video widgets of the item on the viewport
+    void moveItemWidgets( PageViewItem * item, const QRect & viewportRect );
+
     // the document, pageviewItems and the 'visible cache'
     PageView *q;
     Okular::Document * document;
     QVector< PageViewItem * > items;
     QLinkedList< PageViewItem * > visibleItems;
 
+    // the rows of items placed by slotRelayoutPages, from top to bottom
+    struct LayoutRow
+    {
+        int top;
+        int bottom;
+        int firstItem;
+        int lastItem;
+    };
+    QVector< LayoutRow > layoutRows;
+    // the widgets of all the items have to be placed on the viewport again
+    bool dirtyItemWidgets;
+
     // view layout (columns and continuous in Settings), zoom and mouse
     PageView::ZoomMode zoomMode;
     float zoomFactor;
@@ -252,6 +269,47 @@ OkularTTS* PageViewPrivate::tts()
     return m_tts;
 }
 
+static bool rowEndsBefore( const PageViewPrivate::LayoutRow & row, int y )
+{
+    return row.bottom < y;
+}
+
+QVector< PageViewItem * > PageViewPrivate::itemsInRows( int top, int bottom ) const
+{
+    QVector< PageViewItem * > result;
+    QVector< LayoutRow >::const_iterator it = qLowerBound( layoutRows.constBegin(), layoutRows.constEnd(), top, rowEndsBefore );
+    for ( ; it != layoutRows.constEnd() && it->top <= bottom; ++it )
+    {
+        for ( int i = it->firstItem; i <= it->lastItem; ++i )
+            result.append( items[ i ] );
+    }
+    return result;
+}
+
+void PageViewPrivate::moveItemWidgets( PageViewItem * item, const QRect & viewportRect )
+{
+    const QRect viewportRectAtZeroZero( 0, 0, viewportRect.width(), viewportRect.height() );
+    foreach( FormWidgetIface *fwi, item->formWidgets() )
+    {
+        Okular::NormalizedRect r = fwi->rect();
+        fwi->moveTo(
+            qRound( item->uncroppedGeometry().left() + item->uncroppedWidth() * r.left ) + 1 - viewportRect.left(),
+            qRound( item->uncroppedGeometry().top() + item->uncroppedHeight() * r.top ) + 1 - viewportRect.top() );
+    }
+    Q_FOREACH ( VideoWidget *vw, item->videoWidgets() )
+    {
+        const Okular::NormalizedRect r = vw->normGeometry();
+        vw->move(
+            qRound( item->uncroppedGeometry().left() + item->uncroppedWidth() * r.left ) + 1 - viewportRect.left(),
+            qRound( item->uncroppedGeometry().top() + item->uncroppedHeight() * r.top ) + 1 - viewportRect.top() );
+
+        if ( vw->isPlaying() && viewportRectAtZeroZero.intersect( vw->geometry() ).isEmpty() ) {
+            vw->stop();
+            vw->pageLeft();
+        }
+    }
+}
+
 
 /* PageView. What's in this file? -> quick overview.
  * Code weight (in rows) and meaning:
@@ -290,6 +348,7 @@ PageView::PageView( QWidget *parent, Okular::Document *document )
     d->autoScrollTimer = 0;
     d->annotator = 0;
     d->dirtyLayout = false;
+    d->dirtyItemWidgets = false;
     d->blockViewport = false;
     d->blockPixmapsRequest = false;
     d->messageWindow = new PageViewMessage(this);
@@ -860,6 +919,28 @@ void PageView::selectAll()
 void PageView::notifySetup( const QVector< Okular::Page * > & pageSet, int setupFlags )
 {
     bool documentChanged = setupFlags & Okular::DocumentObserver::DocumentChanged;
+    // pages appended while loading the document: keep the current ones
+    if ( ( setupFlags & Okular::DocumentObserver::PagesAppended ) && !documentChanged && pageSet.count() > d->items.count() )
+    {
+        bool hasformwidgets = false;
+        for ( int i = d->items.count(); i < pageSet.count(); ++i )
+        {
+            PageViewItem * item = new PageViewItem( pageSet[i] );
+            d->items.push_back( item );
+            if ( pageSet[i]->isMetadataLoaded() && createItemWidgets( item ) )
+            {
+                item->setFormWidgetsVisible( d->m_formsVisible );
+                hasformwidgets = true;
+            }
+        }
+        if ( hasformwidgets && d->aToggleForms )
+            d->aToggleForms->setEnabled( true );
+
+        d->dirtyLayout = true;
+        QMetaObject::invokeMethod(this, "slotRelayoutPages", Qt::QueuedConnection);
+        return;
+    }
+
     // reuse current pages if nothing new
     if ( ( pageSet.count() == d->items.count() ) && !documentChanged && !( setupFlags & Okular::DocumentObserver::NewLayoutForPages ) )
     {
@@ -877,6 +958,7 @@ void PageView::notifySetup( const QVector< Okular::Page * > & pageSet, int setup
         delete *dIt;
     d->items.clear();
     d->visibleItems.clear();
+    d->layoutRows.clear();
     d->pagesWithTextSelection.clear();
     toggleFormWidgets( false );
     if ( d->formsWidgetController )
@@ -893,46 +975,10 @@ void PageView::notifySetup( const QVector< Okular::Page * > & pageSet, int setup
 #ifdef PAGEVIEW_DEBUG
         kDebug().nospace() << "cropped geom for " << d->items.last()->pageNumber() << " is " << d->items.last()->croppedGeometry();
 #endif
-        const QLinkedList< Okular::FormField * > pageFields = (*setIt)->formFields();
-        QLinkedList< Okular::FormField * >::const_iterator ffIt = pageFields.constBegin(), ffEnd = pageFields.constEnd();
-        for ( ; ffIt != ffEnd; ++ffIt )
-        {
-            Okular::FormField * ff = *ffIt;
-            FormWidgetIface * w = FormWidgetFactory::createWidget( ff, viewport() );
-            if ( w )
-            {
-                w->setPageItem( item );
-                w->setFormWidgetsController( d->formWidgetsController() );
-                w->setVisibility( false );
-                w->setCanBeFilled( d->document->isAllowed( Okular::AllowFillForms ) );
-                item->formWidgets().insert( ff->id(), w );
-                hasformwidgets = true;
-            }
-        }
-        const QLinkedList< Okular::Annotation * > annotations = (*setIt)->annotations();
-        QLinkedList< Okular::Annotation * >::const_iterator aIt = annotations.constBegin(), aEnd = annotations.constEnd();
-        for ( ; aIt != aEnd; ++aIt )
-        {
-            Okular::Annotation * a = *aIt;
-            if ( a->subType() == Okular::Annotation::AMovie )
-            {
-                Okular::MovieAnnotation * movieAnn = static_cast< Okular::MovieAnnotation * >( a );
-                VideoWidget * vw = new VideoWidget( movieAnn, movieAnn->movie(), d->document, viewport() );
-                item->videoWidgets().insert( movieAnn->movie(), vw );
-                vw->pageInitialized();
-            }
-            else if ( a->subType() == Okular::Annotation::AScreen )
-            {
-                const Okular::ScreenAnnotation * screenAnn = static_cast< Okular::ScreenAnnotation * >( a );
-                Okular::Movie *movie = GuiUtils::renditionMovieFromScreenAnnotation( screenAnn );
-                if ( movie )
-                {
-                    VideoWidget * vw = new VideoWidget( screenAnn, movie, d->document, viewport() );
-                    item->videoWidgets().insert( movie, vw );
-                    vw->pageInitialized();
-                }
-            }
-        }
+        // the widgets of the pages whose metadata is not loaded yet are
+        // created when it is (see notifyPageChanged)
+        if ( (*setIt)->isMetadataLoaded() && createItemWidgets( item ) )
+            hasformwidgets = true;
     }
 
     // invalidate layout so relayout/repaint will happen on next viewport change
@@ -976,6 +1022,58 @@ void PageView::notifySetup( const QVector< Okular::Page * > & pageSet, int setup
     selectionClear();
 }
 
+bool PageView::createItemWidgets( PageViewItem * item )
+{
+    // the metadata of the page may be notified after its item was created
+    // with the widgets already
+    if ( !item->formWidgets().isEmpty() || !item->videoWidgets().isEmpty() )
+        return false;
+
+    bool hasFormWidgets = false;
+    const QLinkedList< Okular::FormField * > pageFields = item->page()->formFields();
+    QLinkedList< Okular::FormField * >::const_iterator ffIt = pageFields.constBegin(), ffEnd = pageFields.constEnd();
+    for ( ; ffIt != ffEnd; ++ffIt )
+    {
+        Okular::FormField * ff = *ffIt;
+        FormWidgetIface * w = FormWidgetFactory::createWidget( ff, viewport() );
+        if ( w )
+        {
+            w->setPageItem( item );
+            w->setFormWidgetsController( d->formWidgetsController() );
+            w->setVisibility( false );
+            w->setCanBeFilled( d->document->isAllowed( Okular::AllowFillForms ) );
+            item->formWidgets().insert( ff->id(), w );
+            hasFormWidgets = true;
+        }
+    }
+    const QLinkedList< Okular::Annotation * > annotations = item->page()->annotations();
+    QLinkedList< Okular::Annotation * >::const_iterator aIt = annotations.constBegin(), aEnd = annotations.constEnd();
+    for ( ; aIt != aEnd; ++aIt )
+    {
+        Okular::Annotation * a = *aIt;
+        if ( a->subType() == Okular::Annotation::AMovie )
+        {
+            Okular::MovieAnnotation * movieAnn = static_cast< Okular::MovieAnnotation * >( a );
+            VideoWidget * vw = new VideoWidget( movieAnn, movieAnn->movie(), d->document, viewport() );
+            item->videoWidgets().insert( movieAnn->movie(), vw );
+            vw->pageInitialized();
+        }
+        else if ( a->subType() == Okular::Annotation::AScreen )
+        {
+            const Okular::ScreenAnnotation * screenAnn = static_cast< Okular::ScreenAnnotation * >( a );
+            Okular::Movie *movie = GuiUtils::renditionMovieFromScreenAnnotation( screenAnn );
+            if ( movie )
+            {
+                VideoWidget * vw = new VideoWidget( screenAnn, movie, d->document, viewport() );
+                item->videoWidgets().insert( movie, vw );
+                vw->pageInitialized();
+            }
+        }
+    }
+
+    return hasFormWidgets;
+}
+
 void PageView::updateActionState( bool haspages, bool documentChanged, bool hasformwidgets )
 {
     if ( d->aPageSizes )
@@ -1029,7 +1127,9 @@ void PageView::updateActionState( bool haspages, bool documentChanged, bool hasf
         d->aRotateOriginal->setEnabled( haspages );
     if ( d->aToggleForms )
     { // may be null if dummy mode is on
-        d->aToggleForms->setEnabled( haspages && hasformwidgets );
+        // the form widgets of the pages whose metadata is not loaded yet are
+        // created later, ask the generator whether there are forms
+        d->aToggleForms->setEnabled( haspages && ( hasformwidgets || d->document->metaData( "HasForms" ).toBool() ) );
     }
     bool allowAnnotations = d->document->isAllowed( Okular::AllowNotes );
     if ( d->annotator )
@@ -1201,6 +1301,22 @@ void PageView::notifyPageChanged( int pageNumber, int changedFlags )
     if ( changedFlags & DocumentObserver::Bookmark )
         return;
 
+    if ( changedFlags & DocumentObserver::Metadata )
+    {
+        PageViewItem * item = d->items.value( pageNumber );
+        if ( item && createItemWidgets( item ) )
+        {
+            // place the new widgets like the ones of the other items
+            item->setWHZC( item->croppedWidth(), item->croppedHeight(), item->zoomFactor(), item->crop() );
+            item->moveTo( item->croppedGeometry().left(), item->croppedGeometry().top() );
+            d->moveItemWidgets( item, QRect( horizontalScrollBar()->value(), verticalScrollBar()->value(),
+                                             viewport()->width(), viewport()->height() ) );
+            item->setFormWidgetsVisible( d->m_formsVisible );
+            if ( d->aToggleForms )
+                d->aToggleForms->setEnabled( true );
+        }
+    }
+
     if ( changedFlags & DocumentObserver::Annotations )
     {
         const QLinkedList< Okular::Annotation * > annots = d->document->page( pageNumber )->annotations();
@@ -1644,6 +1760,9 @@ void PageView::resizeEvent( QResizeEvent *e )
         return;
     }
 
+    // the widgets left out of the viewport may be in the resized one
+    d->dirtyItemWidgets = true;
+
     // start a timer that will refresh the pixmap after 0.2s
     d->delayResizeEventTimer->start( 200 );
     d->verticalScrollBarVisible = verticalScrollBar()->isVisible();
@@ -3136,7 +3255,7 @@ QList< Okular::RegularAreaRect * > PageView::textSelections( const QPoint& start
     QList< Okular::RegularAreaRect * > ret;
     QSet< int > affectedItemsSet;
     QRect selectionRect = QRect( start, end ).normalized();
-    foreach( PageViewItem * item, d->items )
+    foreach( PageViewItem * item, d->itemsInRows( selectionRect.top(), selectionRect.bottom() ) )
     {
         if ( item->isVisible() && selectionRect.intersects( item->croppedGeometry() ) )
             affectedItemsSet.insert( item->pageNumber() );
@@ -3221,8 +3340,10 @@ void PageView::drawDocumentOnPainter( const QRect & contentsRect, QPainter * p )
     // create a region from which we'll subtract painted rects
     QRegion remainingArea( contentsRect );
 
-    // iterate over all items painting the ones intersecting contentsRect
-    QVector< PageViewItem * >::const_iterator iIt = d->items.constBegin(), iEnd = d->items.constEnd();
+    // iterate over the items of the rows crossing contentsRect, painting the
+    // ones intersecting it
+    const QVector< PageViewItem * > rowItems = d->itemsInRows( checkRect.top(), checkRect.bottom() );
+    QVector< PageViewItem * >::const_iterator iIt = rowItems.constBegin(), iEnd = rowItems.constEnd();
     for ( ; iIt != iEnd; ++iIt )
     {
         // check if a piece of the page intersects the contents rect
@@ -3408,20 +3529,14 @@ void PageView::updateItemSize( PageViewItem * item, int colWidth, int rowHeight
 
 PageViewItem * PageView::pickItemOnPoint( int x, int y )
 {
-    PageViewItem * item = 0;
-    QLinkedList< PageViewItem * >::const_iterator iIt = d->visibleItems.constBegin(), iEnd = d->visibleItems.constEnd();
-    for ( ; iIt != iEnd; ++iIt )
+    // only the items of the row under the point may be there
+    foreach ( PageViewItem * i, d->itemsInRows( y, y ) )
     {
-        PageViewItem * i = *iIt;
         const QRect & r = i->croppedGeometry();
-        if ( x < r.right() && x > r.left() && y < r.bottom() )
-        {
-            if ( y > r.top() )
-                item = i;
-            break;
-        }
+        if ( i->isVisible() && x < r.right() && x > r.left() && y < r.bottom() && y > r.top() )
+            return i;
     }
-    return item;
+    return 0;
 }
 
 void PageView::textSelectionClear()
@@ -4030,6 +4145,8 @@ void PageView::slotRelayoutPages()
             for ( int i = 0; i < cIdx; ++i )
                 insertX += colWidth[ i ];
         }
+        d->layoutRows.clear();
+        int rowFirstItem = 0;
         for ( iIt = d->items.constBegin(); iIt != iEnd; ++iIt )
         {
             PageViewItem * item = *iIt;
@@ -4067,6 +4184,21 @@ void PageView::slotRelayoutPages()
                 item->setVisible( false );
             }
             item->setFormWidgetsVisible( d->m_formsVisible );
+            // remember the rows laid out, to find the items by position
+            const int itemIndex = iIt - d->items.constBegin();
+            if ( cIdx == nCols - 1 || itemIndex == pageCount - 1 )
+            {
+                if ( continuousView || rIdx == pageRowIdx )
+                {
+                    PageViewPrivate::LayoutRow row;
+                    row.top = continuousView ? insertY : origInsertY;
+                    row.bottom = row.top + rHeight - 1;
+                    row.firstItem = rowFirstItem;
+                    row.lastItem = itemIndex;
+                    d->layoutRows.append( row );
+                }
+                rowFirstItem = itemIndex + 1;
+            }
             // advance col/row index
             insertX += cWidth;
             if ( ++cIdx == nCols )
@@ -4086,6 +4218,7 @@ void PageView::slotRelayoutPages()
 
     // 3) reset dirty state
     d->dirtyLayout = false;
+    d->dirtyItemWidgets = true;
 
     // 4) update scrollview's contents size and recenter view
     bool wasUpdatesEnabled = viewport()->updatesEnabled();
@@ -4175,7 +4308,6 @@ void PageView::slotRequestVisiblePixmaps( int newValue )
     const QRect viewportRect( horizontalScrollBar()->value(),
                               verticalScrollBar()->value(),
                               viewport()->width(), viewport()->height() );
-    const QRect viewportRectAtZeroZero( 0, 0, viewport()->width(), viewport()->height() );
 
     // some variables used to determine the viewport
     int nearPageNumber = -1;
@@ -4187,34 +4319,16 @@ void PageView::slotRequestVisiblePixmaps( int newValue )
     // Margin (in pixels) around the viewport to preload
     const int pixelsToExpand = 512;
 
-    // iterate over all items
+    // iterate over the items of the rows crossing the viewport
+    const QLinkedList< PageViewItem * > previousVisibleItems = d->visibleItems;
     d->visibleItems.clear();
     QLinkedList< Okular::PixmapRequest * > requestedPixmaps;
     QVector< Okular::VisiblePageRect * > visibleRects;
-    QVector< PageViewItem * >::const_iterator iIt = d->items.constBegin(), iEnd = d->items.constEnd();
+    const QVector< PageViewItem * > rowItems = d->itemsInRows( viewportRect.top(), viewportRect.bottom() );
+    QVector< PageViewItem * >::const_iterator iIt = rowItems.constBegin(), iEnd = rowItems.constEnd();
     for ( ; iIt != iEnd; ++iIt )
     {
         PageViewItem * i = *iIt;
-        foreach( FormWidgetIface *fwi, i->formWidgets() )
-        {
-            Okular::NormalizedRect r = fwi->rect();
-            fwi->moveTo(
-                qRound( i->uncroppedGeometry().left() + i->uncroppedWidth() * r.left ) + 1 - viewportRect.left(),
-                qRound( i->uncroppedGeometry().top() + i->uncroppedHeight() * r.top ) + 1 - viewportRect.top() );
-        }
-        Q_FOREACH ( VideoWidget *vw, i->videoWidgets() )
-        {
-            const Okular::NormalizedRect r = vw->normGeometry();
-            vw->move(
-                qRound( i->uncroppedGeometry().left() + i->uncroppedWidth() * r.left ) + 1 - viewportRect.left(),
-                qRound( i->uncroppedGeometry().top() + i->uncroppedHeight() * r.top ) + 1 - viewportRect.top() );
-
-            if ( vw->isPlaying() && viewportRectAtZeroZero.intersect( vw->geometry() ).isEmpty() ) {
-                vw->stop();
-                vw->pageLeft();
-            }
-        }
-
         if ( !i->isVisible() )
             continue;
 #ifdef PAGEVIEW_DEBUG
@@ -4253,7 +4367,10 @@ void PageView::slotRequestVisiblePixmaps( int newValue )
 #ifdef PAGEVIEW_DEBUG
             kWarning() << "rerequesting visible pixmaps for page" << i->pageNumber() << "!";
 #endif
-            Okular::PixmapRequest * p = new Okular::PixmapRequest( this, i->pageNumber(), i->uncroppedWidth(), i->uncroppedHeight(), PAGEVIEW_PRIO, Okular::PixmapRequest::Asynchronous );
+            // show a quick preview of the pages with nothing to show yet
+            Okular::PixmapRequest::PixmapRequestFeatures requestFeatures = Okular::PixmapRequest::Asynchronous;
+            requestFeatures |= Okular::PixmapRequest::Progressive;
+            Okular::PixmapRequest * p = new Okular::PixmapRequest( this, i->pageNumber(), i->uncroppedWidth(), i->uncroppedHeight(), PAGEVIEW_PRIO, requestFeatures );
             requestedPixmaps.push_back( p );
 
             if ( i->page()->hasTilesManager() )
@@ -4285,6 +4402,25 @@ void PageView::slotRequestVisiblePixmaps( int newValue )
         }
     }
 
+    // place the widgets of the items on the viewport: the ones of the items
+    // staying out of it were moved out of it already
+    if ( d->dirtyItemWidgets )
+    {
+        foreach ( PageViewItem * i, d->items )
+            d->moveItemWidgets( i, viewportRect );
+        d->dirtyItemWidgets = false;
+    }
+    else
+    {
+        foreach ( PageViewItem * i, d->visibleItems )
+            d->moveItemWidgets( i, viewportRect );
+        foreach ( PageViewItem * i, previousVisibleItems )
+        {
+            if ( !d->visibleItems.contains( i ) )
+                d->moveItemWidgets( i, viewportRect );
+        }
+    }
+
     // if preloading is enabled, add the pages before and after in preloading
     if ( !d->visibleItems.isEmpty() &&
          Okular::SettingsCore::memoryLevel() != Okular::SettingsCore::EnumMemoryLevel::Low )
@@ -193,6 +193,8 @@ Q_OBJECT
         void scrollTo( int x, int y );
 
         void toggleFormWidgets( bool on );
+        // create the form and video widgets of the item, returns whether it has form widgets
+        bool createItemWidgets( PageViewItem * item );
 
         void resizeContentArea( const QSize & newSize );
         void updatePageStep();
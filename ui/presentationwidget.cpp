@@ -29,6 +29,7 @@
 #include <qapplication.h>
 #include <qdesktopwidget.h>
 #include <kcursor.h>
+#include <kdebug.h>
 #include <krandom.h>
 #include <qtoolbar.h>
 #include <kaction.h>
@@ -57,6 +58,7 @@
 #include "core/action.h"
 #include "core/annotations.h"
 #include "core/audioplayer.h"
+#include "core/debug_p.h"
 #include "core/document.h"
 #include "core/generator.h"
 #include "core/movie.h"
@@ -67,6 +69,9 @@
 // comment this to disable the top-right progress indicator
 #define ENABLE_PROGRESS_OVERLAY
 
+// a slide rendered slower than this (in ms) is reported in the debug output
+#define SLOW_SLIDE_MS 250
+
 
 // a frame contains a pointer to the page object, its geometry and the
 // transition effect to the next frame
@@ -134,8 +139,8 @@ PresentationWidget::PresentationWidget( QWidget * parent, Okular::Document * doc
     : QWidget( 0 /* must be null, to have an independent widget */, Qt::FramelessWindowHint ),
     m_pressedLink( 0 ), m_handCursor( false ), m_drawingEngine( 0 ),
     m_parentWidget( parent ),
-    m_document( doc ), m_frameIndex( -1 ), m_topBar( 0 ), m_pagesEdit( 0 ), m_searchBar( 0 ),
-    m_screenSelect( 0 ), m_isSetup( false ), m_blockNotifications( false ), m_inBlackScreenMode( false ),
+    m_document( doc ), m_frameIndex( -1 ), m_frameShown( false ), m_waitingForFrame( false ), m_topBar( 0 ), m_pagesEdit( 0 ), m_searchBar( 0 ),
+    m_screenSelect( 0 ), m_isSetup( false ), m_inBlackScreenMode( false ),
     m_showSummaryView( Okular::Settings::slidesShowSummary() )
 {
     Q_UNUSED( parent )
@@ -367,13 +372,24 @@ void PresentationWidget::notifyViewportChanged( bool /*smoothMove*/ )
 
 void PresentationWidget::notifyPageChanged( int pageNumber, int changedFlags )
 {
-    // if we are blocking the notifications, do nothing
-    if ( m_blockNotifications )
-        return;
-
     // check if it's the last requested pixmap. if so update the widget.
     if ( (changedFlags & ( DocumentObserver::Pixmap | DocumentObserver::Annotations | DocumentObserver::Highlights ) ) && pageNumber == m_frameIndex )
-        generatePage( changedFlags & ( DocumentObserver::Annotations | DocumentObserver::Highlights ) );
+    {
+        if ( m_waitingForFrame && ( changedFlags & DocumentObserver::Pixmap ) )
+        {
+            const PresentationFrame * frame = m_frames[ m_frameIndex ];
+            if ( frame->page->hasPixmap( this, frame->geometry.width(), frame->geometry.height() ) )
+            {
+                m_waitingForFrame = false;
+                if ( m_frameRequestTime.elapsed() > SLOW_SLIDE_MS )
+                    kDebug(OkularDebug) << "Slow presentation slide" << pageNumber << m_frameRequestTime.elapsed() << "ms";
+            }
+        }
+
+        // the transition was already shown with the frame scaled from its old pixmap
+        generatePage( m_frameShown || ( changedFlags & ( DocumentObserver::Annotations | DocumentObserver::Highlights ) ) );
+        m_frameShown = true;
+    }
 }
 
 void PresentationWidget::notifyCurrentPageChanged( int previousPage, int currentPage )
@@ -425,15 +441,30 @@ void PresentationWidget::notifyCurrentPageChanged( int previousPage, int current
 
         // if pixmap not inside the Okular::Page we request it and wait for
         // notifyPixmapChanged call or else we can proceed to pixmap generation
+        m_frameShown = false;
+        m_waitingForFrame = false;
         if ( !frame->page->hasPixmap( this, pixW, pixH ) )
         {
+            // until it is rendered show the pixmap of another size, if any,
+            // scaled, otherwise the previous slide stays on screen
+            if ( frame->page->hasPixmap( this ) )
+            {
+                generatePage();
+                m_frameShown = true;
+            }
+            m_waitingForFrame = true;
+            m_frameRequestTime.start();
             requestPixmaps();
         }
         else
         {
             // make the background pixmap
             generatePage();
+            m_frameShown = true;
         }
+        // the pixmaps of the next slides may be missing even if this one is there
+        if ( !m_waitingForFrame )
+            requestPixmaps();
 
         // perform the page opening action, if any
         if ( m_document->page( m_frameIndex )->pageAction( Okular::Page::Opening ) )
@@ -461,17 +492,12 @@ void PresentationWidget::notifyCurrentPageChanged( int previousPage, int current
 
 bool PresentationWidget::canUnloadPixmap( int pageNumber ) const
 {
-    if ( Okular::SettingsCore::memoryLevel() == Okular::SettingsCore::EnumMemoryLevel::Low ||
-         Okular::SettingsCore::memoryLevel() == Okular::SettingsCore::EnumMemoryLevel::Normal )
-    {
-        // can unload all pixmaps except for the currently visible one
-        return pageNumber != m_frameIndex;
-    }
-    else
-    {
-        // can unload all pixmaps except for the currently visible one, previous and next
-        return qAbs(pageNumber - m_frameIndex) <= 1;
-    }
+    // can unload all pixmaps except for the currently visible one and the
+    // ones rendered in advance around it: the next ones and the previous
+    // one, or all of them if the whole document is preloaded
+    const int preloaded = slidesToPreload();
+    const int preloadedBehind = preloaded >= (int)m_document->pages() ? preloaded : qMin( preloaded, 1 );
+    return pageNumber < m_frameIndex - preloadedBehind || pageNumber > m_frameIndex + preloaded;
 }
 
 void PresentationWidget::setupActions( KActionCollection * collection )
@@ -1236,59 +1262,66 @@ void PresentationWidget::repositionContent()
     m_topBar->setGeometry( 0, 0, ourGeom.width(), 32 + 10 );
 }
 
+int PresentationWidget::slidesToPreload() const
+{
+    switch ( Okular::SettingsCore::memoryLevel() )
+    {
+        case Okular::SettingsCore::EnumMemoryLevel::Low:
+            return 0;
+        // If greedy, preload everything
+        case Okular::SettingsCore::EnumMemoryLevel::Greedy:
+            return (int)m_document->pages();
+        default:
+            return Okular::Settings::slidesLookAhead();
+    }
+}
+
 void PresentationWidget::requestPixmaps()
 {
     PresentationFrame * frame = m_frames[ m_frameIndex ];
     int pixW = frame->geometry.width();
     int pixH = frame->geometry.height();
 
-    // operation will take long: set busy cursor
-    QApplication::setOverrideCursor( QCursor( Qt::BusyCursor ) );
-    // request the pixmap
-    QLinkedList< Okular::PixmapRequest * > requests;
-    requests.push_back( new Okular::PixmapRequest( this, m_frameIndex, pixW, pixH, PRESENTATION_PRIO, Okular::PixmapRequest::NoFeature ) );
-    // restore cursor
-    QApplication::restoreOverrideCursor();
-    // ask for next and previous page if not in low memory usage setting
-    if ( Okular::SettingsCore::memoryLevel() != Okular::SettingsCore::EnumMemoryLevel::Low )
-    {
-        int pagesToPreload = 1;
+    // all the slides are rendered in the background, the current one first
+    Okular::PixmapRequest::PixmapRequestFeatures currentFeatures = Okular::PixmapRequest::Asynchronous;
+    Okular::PixmapRequest::PixmapRequestFeatures requestFeatures = Okular::PixmapRequest::Preload;
+    requestFeatures |= Okular::PixmapRequest::Asynchronous;
 
-        // If greedy, preload everything
-        if (Okular::SettingsCore::memoryLevel() == Okular::SettingsCore::EnumMemoryLevel::Greedy)
-            pagesToPreload = (int)m_document->pages();
-
-        Okular::PixmapRequest::PixmapRequestFeatures requestFeatures = Okular::PixmapRequest::Preload;
-        requestFeatures |= Okular::PixmapRequest::Asynchronous;
+    QLinkedList< Okular::PixmapRequest * > requests;
+    if ( !frame->page->hasPixmap( this, pixW, pixH ) )
+        requests.push_back( new Okular::PixmapRequest( this, m_frameIndex, pixW, pixH, PRESENTATION_PRIO, currentFeatures ) );
 
-        for( int j = 1; j <= pagesToPreload; j++ )
+    // the next slides at screen resolution, so that changing slide and its
+    // transition don't wait; only the previous one backwards
+    const int pagesToPreload = slidesToPreload();
+    for( int j = 1; j <= pagesToPreload; j++ )
+    {
+        int tailRequest = m_frameIndex + j;
+        if ( tailRequest < (int)m_document->pages() )
         {
-            int tailRequest = m_frameIndex + j;
-            if ( tailRequest < (int)m_document->pages() )
-            {
-                PresentationFrame *nextFrame = m_frames[ tailRequest ];
-                pixW = nextFrame->geometry.width();
-                pixH = nextFrame->geometry.height();
-                if ( !nextFrame->page->hasPixmap( this, pixW, pixH ) )
-                    requests.push_back( new Okular::PixmapRequest( this, tailRequest, pixW, pixH, PRESENTATION_PRELOAD_PRIO, requestFeatures ) );
-            }
-
-            int headRequest = m_frameIndex - j;
-            if ( headRequest >= 0 )
-            {
-                PresentationFrame *prevFrame = m_frames[ headRequest ];
-                pixW = prevFrame->geometry.width();
-                pixH = prevFrame->geometry.height();
-                if ( !prevFrame->page->hasPixmap( this, pixW, pixH ) )
-                    requests.push_back( new Okular::PixmapRequest( this, headRequest, pixW, pixH, PRESENTATION_PRELOAD_PRIO, requestFeatures ) );
-            }
+            PresentationFrame *nextFrame = m_frames[ tailRequest ];
+            pixW = nextFrame->geometry.width();
+            pixH = nextFrame->geometry.height();
+            if ( !nextFrame->page->hasPixmap( this, pixW, pixH ) )
+                requests.push_back( new Okular::PixmapRequest( this, tailRequest, pixW, pixH, PRESENTATION_PRELOAD_PRIO + j - 1, requestFeatures ) );
+        }
 
-            // stop if we've already reached both ends of the document
-            if ( headRequest < 0 && tailRequest >= (int)m_document->pages() )
-                break;
+        int headRequest = m_frameIndex - j;
+        if ( headRequest >= 0 && ( j == 1 || pagesToPreload == (int)m_document->pages() ) )
+        {
+            PresentationFrame *prevFrame = m_frames[ headRequest ];
+            pixW = prevFrame->geometry.width();
+            pixH = prevFrame->geometry.height();
+            if ( !prevFrame->page->hasPixmap( this, pixW, pixH ) )
+                requests.push_back( new Okular::PixmapRequest( this, headRequest, pixW, pixH, PRESENTATION_PRELOAD_PRIO + j, requestFeatures ) );
         }
+
+        // stop if we've already reached both ends of the document
+        if ( headRequest < 0 && tailRequest >= (int)m_document->pages() )
+            break;
     }
-    m_document->requestPixmaps( requests );
+    if ( !requests.isEmpty() )
+        m_document->requestPixmaps( requests );
 }
 
 
@@ -1508,13 +1541,12 @@ void PresentationWidget::applyNewScreenSize( const QSize & oldSize )
 
     if ( m_frameIndex != -1 )
     {
-    // ugliness alarm!
-    const_cast< Okular::Page * >( m_frames[ m_frameIndex ]->page )->deletePixmap( this );
-    // force the regeneration of the pixmap
+    // force the regeneration of the pixmap, the old one is shown scaled meanwhile
     m_lastRenderedPixmap = QPixmap();
-    m_blockNotifications = true;
+    m_frameShown = true;
+    m_waitingForFrame = true;
+    m_frameRequestTime.start();
     requestPixmaps();
-    m_blockNotifications = false;
     }
     generatePage( true /* no transitions */ );
 }
@@ -10,6 +10,7 @@
 #ifndef _OKULAR_PRESENTATIONWIDGET_H_
 #define _OKULAR_PRESENTATIONWIDGET_H_
 
+#include <qelapsedtimer.h>
 #include <qlist.h>
 #include <qpixmap.h>
 #include <qstringlist.h>
@@ -89,6 +90,7 @@ class PresentationWidget : public QWidget, public Okular::DocumentObserver
         void recalcGeometry();
         void repositionContent();
         void requestPixmaps();
+        int slidesToPreload() const;
         void setScreen( int );
         void applyNewScreenSize( const QSize & oldSize );
         void inhibitPowerManagement();
@@ -124,6 +126,10 @@ class PresentationWidget : public QWidget, public Okular::DocumentObserver
         Okular::Document * m_document;
         QVector< PresentationFrame * > m_frames;
         int m_frameIndex;
+        // the current frame was shown (scaled) while its pixmap is rendered
+        bool m_frameShown;
+        bool m_waitingForFrame;
+        QElapsedTimer m_frameRequestTime;
         QStringList m_metaStrings;
         QToolBar * m_topBar;
         QLineEdit *m_pagesEdit;
@@ -131,7 +137,6 @@ class PresentationWidget : public QWidget, public Okular::DocumentObserver
         KActionCollection * m_ac;
         KSelectAction * m_screenSelect;
         bool m_isSetup;
-        bool m_blockNotifications;
         bool m_inBlackScreenMode;
         bool m_showSummaryView;
 
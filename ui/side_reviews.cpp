@@ -48,7 +48,7 @@ class TreeView : public QTreeView
     {
       bool hasAnnotations = false;
       for ( uint i = 0; i < m_document->pages(); ++i )
-        if ( m_document->page( i )->hasAnnotations() ) {
+        if ( m_document->page( i )->isMetadataLoaded() && m_document->page( i )->hasAnnotations() ) {
           hasAnnotations = true;
           break;
         }
@@ -158,6 +158,15 @@ Reviews::~Reviews()
 }
 
 //BEGIN DocumentObserver Notifies 
+void Reviews::notifySetup( const QVector< Okular::Page * > & pages, int setupFlags )
+{
+    Q_UNUSED( pages )
+
+    // the list needs the annotations of all the pages
+    if ( ( setupFlags & Okular::DocumentObserver::DocumentChanged ) && isVisible() )
+        m_document->loadPagesMetadata();
+}
+
 void Reviews::notifyCurrentPageChanged( int previousPage, int currentPage )
 {
     Q_UNUSED( previousPage )
@@ -166,6 +175,14 @@ void Reviews::notifyCurrentPageChanged( int previousPage, int currentPage )
 }
 //END DocumentObserver Notifies 
 
+void Reviews::showEvent( QShowEvent * event )
+{
+    QWidget::showEvent( event );
+
+    // the annotations of the pages not shown yet are only loaded for the list
+    m_document->loadPagesMetadata();
+}
+
 void Reviews::reparseConfig()
 {
     m_searchLine->setCaseSensitivity( Okular::Settings::reviewsSearchCaseSensitive() ? Qt::CaseSensitive : Qt::CaseInsensitive );
@@ -41,6 +41,7 @@ class Reviews : public QWidget, public Okular::DocumentObserver
         ~Reviews();
 
         // [INHERITED] from DocumentObserver
+        void notifySetup( const QVector< Okular::Page * > & pages, int setupFlags );
         void notifyCurrentPageChanged( int previous, int current );
 
         void reparseConfig();
@@ -58,6 +59,9 @@ class Reviews : public QWidget, public Okular::DocumentObserver
         void contextMenuRequested( const QPoint& );
         void saveSearchOptions();
 
+    protected:
+        void showEvent( QShowEvent * event );
+
     private:
         QModelIndexList retrieveAnnotations(const QModelIndex& idx) const;
         
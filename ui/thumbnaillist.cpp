@@ -230,6 +230,30 @@ ThumbnailList::~ThumbnailList()
 //BEGIN DocumentObserver inherited methods
 void ThumbnailList::notifySetup( const QVector< Okular::Page * > & pages, int setupFlags )
 {
+    // pages appended while loading the document: add their thumbnails below
+    // the others, unless only some pages are shown
+    if ( ( setupFlags & Okular::DocumentObserver::PagesAppended ) && !( setupFlags & Okular::DocumentObserver::DocumentChanged ) &&
+         !d->m_thumbnails.isEmpty() && d->m_thumbnails.last()->pageNumber() + 1 == d->m_thumbnails.count() )
+    {
+        const int width = viewport()->width();
+        const ThumbnailWidget * last = d->m_thumbnails.last();
+        int height = last->pos().y() + last->height() + KDialog::spacingHint();
+        for ( int i = d->m_thumbnails.count(); i < pages.count(); ++i )
+        {
+            ThumbnailWidget * t = new ThumbnailWidget( d, pages[i] );
+            t->move(0, height);
+            d->m_thumbnails.push_back( t );
+            t->resizeFitWidth( width );
+            height += t->height() + KDialog::spacingHint();
+        }
+
+        height -= KDialog::spacingHint();
+        widget()->resize( width, height );
+        verticalScrollBar()->setEnabled( viewport()->height() < height );
+        d->delayedRequestVisiblePixmaps( 200 );
+        return;
+    }
+
     // if there was a widget selected, save its pagenumber to restore
     // its selection (if available in the new set of pages)
     int prevPage = -1;